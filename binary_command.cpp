@@ -0,0 +1,193 @@
+//////////////////////////////////////////////////////////////////////////////
+// binary_command.cpp
+//
+// See header for description
+//
+// Fields are copied with memcpy, which assumes a little endian host, as
+// every platform the driver runs on is.
+//
+#include <string.h>
+#include "binary_command.h"
+
+namespace soft_knuckles
+{
+
+// consistent overhead byte stuffing: each run of non-zero bytes is preceded
+// by its length + 1 and the zero that followed it is dropped.  a code of
+// 0xff means a run of 254 bytes with no zero after it.
+static size_t cobs_encode(const uint8_t *in, size_t size, uint8_t *out)
+{
+    size_t code_at = 0;
+    size_t o = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < size; i++)
+    {
+        if (in[i] != 0)
+        {
+            out[o++] = in[i];
+            code++;
+        }
+        if (in[i] == 0 || code == 0xff)
+        {
+            out[code_at] = code;
+            code_at = o++;
+            code = 1;
+        }
+    }
+    out[code_at] = code;
+    return o;
+}
+
+// returns the decoded size, or SIZE_MAX if out would overflow
+static size_t cobs_decode(const uint8_t *in, size_t size, uint8_t *out, size_t out_capacity)
+{
+    size_t i = 0;
+    size_t o = 0;
+    while (i < size)
+    {
+        uint8_t code = in[i++];
+        if (i + code - 1 > size || o + code - 1 > out_capacity)
+            return SIZE_MAX;
+        memcpy(out + o, in + i, code - 1);
+        i += code - 1;
+        o += code - 1;
+        if (code != 0xff && i < size)
+        {
+            if (o == out_capacity)
+                return SIZE_MAX;
+            out[o++] = 0;
+        }
+    }
+    return o;
+}
+
+bool decode_binary_request(const char *request, BinaryCommand *commands, uint32_t max_commands, uint32_t *count)
+{
+    *count = 0;
+    if (!is_binary_request(request))
+        return false;
+    const uint8_t *encoded = (const uint8_t *)request + 1;
+    size_t encoded_size = strlen((const char *)encoded);
+
+    uint8_t payload[kMaxBinaryPayload];
+    size_t size = cobs_decode(encoded, encoded_size, payload, sizeof(payload));
+    if (size == SIZE_MAX || size < 1 || payload[0] != kBinaryCommandVersion)
+        return false;
+
+    size_t offset = 1;
+    uint32_t n = 0;
+    while (offset < size)
+    {
+        if (n == max_commands)
+            return false;
+        BinaryCommand &command = commands[n];
+        uint8_t op = payload[offset++];
+        command.op = (BinaryOp)(op & ~kBinaryOpDelayed);
+        command.delay_us = 0;
+        if (op & kBinaryOpDelayed)
+        {
+            if (command.op != BINARY_OP_COMPONENT || offset + 4 > size)
+                return false;
+            memcpy(&command.delay_us, payload + offset, 4);
+            offset += 4;
+        }
+        switch (command.op)
+        {
+        case BINARY_OP_COMPONENT:
+            if (offset + 5 > size)
+                return false;
+            command.component_index = payload[offset];
+            memcpy(&command.value, payload + offset + 1, 4);
+            offset += 5;
+            break;
+        case BINARY_OP_POSITION:
+            if (offset + 24 > size)
+                return false;
+            memcpy(command.v, payload + offset, 24);
+            offset += 24;
+            break;
+        case BINARY_OP_ROTATION:
+            if (offset + 32 > size)
+                return false;
+            memcpy(command.v, payload + offset, 32);
+            offset += 32;
+            break;
+        default:
+            return false;
+        }
+        n++;
+    }
+    *count = n;
+    return true;
+}
+
+BinaryCommandEncoder::BinaryCommandEncoder()
+{
+    Reset();
+}
+
+void BinaryCommandEncoder::Reset()
+{
+    m_payload[0] = kBinaryCommandVersion;
+    m_size = 1;
+    m_count = 0;
+}
+
+bool BinaryCommandEncoder::Reserve(size_t size)
+{
+    return m_count < kMaxBinaryCommands && m_size + size <= sizeof(m_payload);
+}
+
+void BinaryCommandEncoder::Put(const void *data, size_t size)
+{
+    memcpy(m_payload + m_size, data, size);
+    m_size += size;
+}
+
+bool BinaryCommandEncoder::Component(uint8_t component_index, float value, uint32_t delay_us)
+{
+    if (!Reserve(delay_us ? 10 : 6))
+        return false;
+    uint8_t op = BINARY_OP_COMPONENT | (delay_us ? kBinaryOpDelayed : 0);
+    Put(&op, 1);
+    if (delay_us)
+        Put(&delay_us, 4);
+    Put(&component_index, 1);
+    Put(&value, 4);
+    m_count++;
+    return true;
+}
+
+bool BinaryCommandEncoder::Position(double x, double y, double z)
+{
+    if (!Reserve(25))
+        return false;
+    uint8_t op = BINARY_OP_POSITION;
+    double v[3] = { x, y, z };
+    Put(&op, 1);
+    Put(v, sizeof(v));
+    m_count++;
+    return true;
+}
+
+bool BinaryCommandEncoder::Rotation(double w, double x, double y, double z)
+{
+    if (!Reserve(33))
+        return false;
+    uint8_t op = BINARY_OP_ROTATION;
+    double v[4] = { w, x, y, z };
+    Put(&op, 1);
+    Put(v, sizeof(v));
+    m_count++;
+    return true;
+}
+
+const char *BinaryCommandEncoder::Request()
+{
+    m_request[0] = (char)kBinaryCommandMagic;
+    size_t size = cobs_encode(m_payload, m_size, (uint8_t *)m_request + 1);
+    m_request[1 + size] = '\0';
+    return m_request;
+}
+
+};
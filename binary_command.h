@@ -0,0 +1,98 @@
+//////////////////////////////////////////////////////////////////////////////
+// binary_command.h
+//
+// Compact binary alternative to the text debug requests, for clients that
+// send a lot of them.  A text request like "/input/trigger/value 0.25" is
+// tokenized, looked up by path and parsed with atof.  The binary form
+// names the component by its device-local index (see the "component <path>"
+// debug request) and carries the value as a float, so decoding it is a
+// handful of loads.
+//
+// DriverDebugRequest carries a NUL terminated string, so the payload is
+// COBS encoded (no zero bytes) and prefixed with a magic byte no text
+// request can start with:
+//
+//   request = kBinaryCommandMagic, cobs(payload), '\0'
+//   payload = version, command...
+//   command = op, fields
+//
+//   BINARY_OP_COMPONENT  u8 component index, f32 value
+//   BINARY_OP_POSITION   f64 x, y, z
+//   BINARY_OP_ROTATION   f64 w, x, y, z
+//
+// A component command with kBinaryOpDelayed set in its op carries a u32
+// delay in microseconds before its fields.  It is queued on the device's
+// input event queue to be applied that long after it arrives.  Multi-byte
+// fields are little endian.  A request holds up to kMaxBinaryCommands
+// commands.  The whole request is checked (decoding, component indices and
+// types) before any of it is applied, so a bad one changes nothing.  The
+// commands then run in order; an update the host rejects, or a delayed one
+// the queue has no room for, fails the request there and nothing after it
+// runs.
+//
+// Nothing here depends on OpenVR, so the debug client builds it too.
+//
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+namespace soft_knuckles
+{
+    static const uint8_t kBinaryCommandMagic = 0xfe;
+    static const uint8_t kBinaryCommandVersion = 1;
+    static const uint32_t kMaxBinaryCommands = 32;
+    static const size_t kMaxBinaryPayload = 768;
+    // magic, the payload plus COBS overhead, terminator
+    static const size_t kMaxBinaryRequest = 1 + kMaxBinaryPayload + kMaxBinaryPayload / 254 + 1 + 1;
+
+    enum BinaryOp : uint8_t
+    {
+        BINARY_OP_COMPONENT = 1,
+        BINARY_OP_POSITION = 2,
+        BINARY_OP_ROTATION = 3,
+    };
+    static const uint8_t kBinaryOpDelayed = 0x80;
+
+    struct BinaryCommand
+    {
+        BinaryOp op;
+        uint8_t component_index;
+        uint32_t delay_us;
+        float value;
+        double v[4];            // x y z for position, w x y z for rotation
+    };
+
+    inline bool is_binary_request(const char *request)
+    {
+        return (uint8_t)request[0] == kBinaryCommandMagic;
+    }
+
+    // false if the request is malformed, of another version, or holds more than max_commands
+    bool decode_binary_request(const char *request, BinaryCommand *commands, uint32_t max_commands, uint32_t *count);
+
+    // builds a request one command at a time.  each Add fails once the request is full.
+    class BinaryCommandEncoder
+    {
+    public:
+        BinaryCommandEncoder();
+
+        void Reset();
+        bool Component(uint8_t component_index, float value, uint32_t delay_us = 0);
+        bool Position(double x, double y, double z);
+        bool Rotation(double w, double x, double y, double z);
+
+        uint32_t Count() const { return m_count; }
+
+        // the request to send.  valid until the next call on this encoder.
+        const char *Request();
+
+    private:
+        bool Reserve(size_t size);
+        void Put(const void *data, size_t size);
+
+        uint8_t m_payload[kMaxBinaryPayload];
+        size_t m_size;
+        uint32_t m_count;
+        char m_request[kMaxBinaryRequest];
+    };
+};
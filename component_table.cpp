@@ -0,0 +1,391 @@
+//////////////////////////////////////////////////////////////////////////////
+// component_table.cpp
+//
+// See header for description
+//
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <openvr_driver.h>
+#include "dprintf.h"
+#include "component_table.h"
+
+using namespace std;
+
+namespace soft_knuckles
+{
+
+namespace
+{
+    // the parts of an input_source entry that decide its components
+    struct ProfileSource
+    {
+        string path;
+        string type;
+        string skeleton;
+        string side;
+    };
+
+    // just enough JSON for input profiles: every key other than
+    // "controller_type" and "input_source" is skipped, as is every field of
+    // a source that isn't a string.
+    class ProfileParser
+    {
+    public:
+        ProfileParser(const string &text) : m_text(text), m_pos(0)
+        {
+            if (m_text.compare(0, 3, "\xef\xbb\xbf") == 0)
+                m_pos = 3;
+        }
+
+        bool Parse(string *controller_type, vector<ProfileSource> *sources)
+        {
+            if (!Expect('{'))
+                return false;
+            if (Peek() == '}')
+                return true;
+            for (;;)
+            {
+                string key;
+                if (!ParseString(&key) || !Expect(':'))
+                    return false;
+                if (key == "input_source")
+                {
+                    if (!ParseSources(sources))
+                        return false;
+                }
+                else if (key == "controller_type" && Peek() == '"')
+                {
+                    if (!ParseString(controller_type))
+                        return false;
+                }
+                else if (!SkipValue(0))
+                {
+                    return false;
+                }
+                if (Peek() != ',')
+                    break;
+                m_pos++;
+            }
+            return Expect('}');
+        }
+
+        size_t Position() const { return m_pos; }
+
+    private:
+        static const int kMaxDepth = 32;
+
+        bool ParseSources(vector<ProfileSource> *sources)
+        {
+            if (!Expect('{'))
+                return false;
+            if (Peek() == '}')
+                return Expect('}');
+            for (;;)
+            {
+                ProfileSource source;
+                if (!ParseString(&source.path) || !Expect(':') || !Expect('{'))
+                    return false;
+                if (Peek() != '}')
+                {
+                    for (;;)
+                    {
+                        string field;
+                        if (!ParseString(&field) || !Expect(':'))
+                            return false;
+                        string *out = field == "type" ? &source.type :
+                                      field == "skeleton" ? &source.skeleton :
+                                      field == "side" ? &source.side : nullptr;
+                        if (out && Peek() == '"')
+                        {
+                            if (!ParseString(out))
+                                return false;
+                        }
+                        else if (!SkipValue(0))
+                        {
+                            return false;
+                        }
+                        if (Peek() != ',')
+                            break;
+                        m_pos++;
+                    }
+                }
+                if (!Expect('}'))
+                    return false;
+                sources->push_back(source);
+                if (Peek() != ',')
+                    break;
+                m_pos++;
+            }
+            return Expect('}');
+        }
+
+        char Peek()
+        {
+            while (m_pos < m_text.size() && isspace((unsigned char)m_text[m_pos]))
+                m_pos++;
+            return m_pos < m_text.size() ? m_text[m_pos] : 0;
+        }
+
+        bool Expect(char c)
+        {
+            if (Peek() != c)
+                return false;
+            m_pos++;
+            return true;
+        }
+
+        bool ParseString(string *out)
+        {
+            if (!Expect('"'))
+                return false;
+            while (m_pos < m_text.size() && m_text[m_pos] != '"')
+            {
+                char c = m_text[m_pos++];
+                if (c == '\\' && m_pos < m_text.size())
+                {
+                    c = m_text[m_pos++];
+                    if (c == 'n')
+                        c = '\n';
+                    else if (c == 't')
+                        c = '\t';
+                }
+                out->push_back(c);
+            }
+            return Expect('"');
+        }
+
+        bool SkipValue(int depth)
+        {
+            if (depth > kMaxDepth)
+                return false;
+            char c = Peek();
+            if (c == '"')
+            {
+                string ignored;
+                return ParseString(&ignored);
+            }
+            if (c == '{' || c == '[')
+            {
+                char close = c == '{' ? '}' : ']';
+                m_pos++;
+                if (Peek() == close)
+                    return Expect(close);
+                for (;;)
+                {
+                    if (c == '{')
+                    {
+                        string key;
+                        if (!ParseString(&key) || !Expect(':'))
+                            return false;
+                    }
+                    if (!SkipValue(depth + 1))
+                        return false;
+                    if (Peek() != ',')
+                        break;
+                    m_pos++;
+                }
+                return Expect(close);
+            }
+            // numbers, true, false and null
+            size_t start = m_pos;
+            while (m_pos < m_text.size() && !strchr(",}] \t\r\n", m_text[m_pos]))
+                m_pos++;
+            return m_pos > start;
+        }
+
+        const string &m_text;
+        size_t m_pos;
+    };
+
+    bool read_file(const char *path, string *text)
+    {
+        FILE *f = fopen(path, "rb");
+        if (!f)
+            return false;
+        char buf[4096];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        {
+            text->append(buf, n);
+        }
+        fclose(f);
+        return true;
+    }
+}
+
+// the compiled definitions are soft_knuckles' own, so they go with its profile
+ComponentTable::ComponentTable(const KnuckleComponentDefinition *definitions, uint32_t count)
+    : m_definitions(definitions, definitions + count),
+      m_source("compiled"),
+      m_profile_name("{soft_knuckles}/input/soft_knuckles_profile.json"),
+      m_controller_type("soft_knuckles")
+{
+    BuildIndexes();
+}
+
+void ComponentTable::Add(const string &path, ComponentType type, EVRScalarType scalar_type,
+    EVRScalarUnits scalar_units, const string &skeleton_path)
+{
+    KnuckleComponentDefinition definition;
+    memset(&definition, 0, sizeof(definition));
+    m_strings.push_back(path);
+    definition.full_path = m_strings.back().c_str();
+    definition.component_type = type;
+    definition.scalar_type = scalar_type;
+    definition.scalar_units = scalar_units;
+    if (type == CT_SKELETON)
+    {
+        m_strings.push_back(skeleton_path);
+        definition.skeleton_path = m_strings.back().c_str();
+        definition.base_pose_path = "/pose/raw";
+    }
+    m_definitions.push_back(definition);
+}
+
+void ComponentTable::BuildIndexes()
+{
+    m_index.reserve(m_definitions.size());
+    for (uint32_t i = 0; i < m_definitions.size(); i++)
+    {
+        const KnuckleComponentDefinition &definition = m_definitions[i];
+        m_index[definition.full_path] = i;
+        if (definition.component_type == CT_SKELETON)
+        {
+            SkeletonComponent skeleton;
+            skeleton.index = i;
+            skeleton.hand = strcmp(definition.skeleton_path, "/skeleton/hand/left") == 0 ? SKELETON_HAND_LEFT :
+                            strcmp(definition.skeleton_path, "/skeleton/hand/right") == 0 ? SKELETON_HAND_RIGHT :
+                            SKELETON_HAND_OTHER;
+            m_skeletons.push_back(skeleton);
+        }
+    }
+}
+
+bool ComponentTable::Lookup(const string &path, uint32_t *index) const
+{
+    auto iter = m_index.find(path);
+    if (iter == m_index.end())
+        return false;
+    *index = iter->second;
+    return true;
+}
+
+shared_ptr<const ComponentTable> ComponentTable::FromProfile(const char *profile_path, const char *profile_name,
+    const char *hand, string *error)
+{
+    string text;
+    if (!read_file(profile_path, &text))
+    {
+        *error = string("could not read ") + profile_path;
+        return nullptr;
+    }
+    string controller_type;
+    vector<ProfileSource> sources;
+    ProfileParser parser(text);
+    if (!parser.Parse(&controller_type, &sources))
+    {
+        *error = string(profile_path) + ": parse error near offset " + to_string(parser.Position());
+        return nullptr;
+    }
+    if (controller_type.empty())
+    {
+        *error = string(profile_path) + ": no controller_type";
+        return nullptr;
+    }
+
+    shared_ptr<ComponentTable> table(new ComponentTable);
+    table->m_source = profile_path;
+    table->m_profile_name = profile_name;
+    table->m_controller_type = controller_type;
+    for (const ProfileSource &source : sources)
+    {
+        const string &path = source.path;
+        if (source.type == "button")
+        {
+            table->Add(path + "/click", CT_BOOLEAN);
+            table->Add(path + "/touch", CT_BOOLEAN);
+        }
+        else if (source.type == "trigger")
+        {
+            table->Add(path + "/value", CT_SCALAR, VRScalarType_Absolute, VRScalarUnits_NormalizedOneSided);
+            table->Add(path + "/click", CT_BOOLEAN);
+            table->Add(path + "/touch", CT_BOOLEAN);
+        }
+        else if (source.type == "trackpad" || source.type == "joystick")
+        {
+            table->Add(path + "/x", CT_SCALAR, VRScalarType_Absolute, VRScalarUnits_NormalizedTwoSided);
+            table->Add(path + "/y", CT_SCALAR, VRScalarType_Absolute, VRScalarUnits_NormalizedTwoSided);
+            table->Add(path + "/click", CT_BOOLEAN);
+            table->Add(path + "/touch", CT_BOOLEAN);
+        }
+        else if (source.type == "skeleton")
+        {
+            if (source.side.empty() || source.side == hand)
+            {
+                table->Add(path, CT_SKELETON, EVRScalarType(0), EVRScalarUnits(0), source.skeleton);
+            }
+        }
+        else if (source.type == "vibration")
+        {
+            table->Add(path, CT_HAPTIC);
+        }
+        else if (source.type != "pose" && source.type != "pinch")
+        {
+            DLOG_WARN("%s: skipping %s of unknown type \"%s\"\n", profile_path, path.c_str(), source.type.c_str());
+        }
+    }
+    if (table->m_definitions.empty())
+    {
+        *error = string(profile_path) + ": no input sources";
+        return nullptr;
+    }
+    table->BuildIndexes();
+    return table;
+}
+
+shared_ptr<const ComponentTable> load_component_table(ETrackedControllerRole role)
+{
+    const char *hand = role == TrackedControllerRole_LeftHand ? "left" : "right";
+    const KnuckleComponentDefinition *compiled = role == TrackedControllerRole_LeftHand ?
+        component_definitions_left : component_definitions_right;
+
+    char profile[1024];
+    profile[0] = 0;
+    vr::VRSettings()->GetString(kSettingsSection, "inputProfile", profile, sizeof(profile));
+    char full_path[1024];
+    strcpy(full_path, profile);
+    if (profile[0] == '{')
+    {
+        // a resource name, e.g. {soft_knuckles}/input/soft_knuckles_profile.json
+        full_path[0] = 0;
+        if (vr::VRResources())
+        {
+            vr::VRResources()->GetResourceFullPath(profile, "", full_path, sizeof(full_path));
+        }
+        if (full_path[0] == 0)
+        {
+            DLOG_ERROR("could not resolve input profile %s; using the compiled components\n", profile);
+        }
+    }
+
+    shared_ptr<const ComponentTable> table;
+    if (full_path[0])
+    {
+        string error;
+        table = ComponentTable::FromProfile(full_path, profile, hand, &error);
+        if (!table)
+        {
+            DLOG_ERROR("%s; using the compiled components\n", error.c_str());
+        }
+    }
+    if (!table)
+    {
+        table = make_shared<ComponentTable>(compiled, (uint32_t)NUM_INPUT_COMPONENT_DEFINITIONS);
+    }
+    DLOG_INFO("soft_knuckles %s components: %u from %s, controller type %s\n", hand, table->Count(),
+        table->Source().c_str(), table->ControllerType().c_str());
+    return table;
+}
+
+};
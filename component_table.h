@@ -0,0 +1,105 @@
+//////////////////////////////////////////////////////////////////////////////
+// component_table.h
+//
+// The input components a device registers, with an index from input source
+// path to component index, built once and then shared read-only by every
+// device of the same kind.  Debug requests, macros and the binary protocol
+// all resolve paths through the index.
+//
+// Normally the table comes from the device's input profile, the file named
+// by the "inputProfile" setting ({soft_knuckles}/... names are resolved
+// through IVRResources), so the components registered always match what
+// the vrsystem binds, and another controller can be simulated by pointing
+// the setting at its profile.  Each "input_source" becomes components by
+// its type:
+//
+//   button                 <path>/click, <path>/touch
+//   trigger                <path>/value, <path>/click, <path>/touch
+//   trackpad, joystick     <path>/x, <path>/y, <path>/click, <path>/touch
+//   skeleton               <path>, if its "side" is this hand or missing
+//   vibration              <path> (haptic)
+//
+// pose and pinch sources are skipped: the pose is submitted directly and
+// pinch is derived from other sources by the vrsystem.
+//
+// The table also carries what the device publishes about its profile: the
+// name from the setting, as the vrsystem resolves it, for
+// Prop_InputProfilePath_String, and the profile's "controller_type" for
+// Prop_ControllerType_String and Prop_LegacyInputProfile_String.
+//
+// If the setting is empty, or the profile can't be read or has no
+// controller_type, the compiled definitions in soft_knuckles_config.cpp are
+// used instead, published as soft_knuckles' own profile.
+//
+// The table also lists its skeleton components with their hand already
+// worked out, so the pose thread can submit skeletons every tick without
+// scanning the components or comparing skeleton paths.
+//
+#pragma once
+#include <stdint.h>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "soft_knuckles_config.h"
+
+namespace soft_knuckles
+{
+    enum SkeletonHand
+    {
+        SKELETON_HAND_LEFT,
+        SKELETON_HAND_RIGHT,
+        SKELETON_HAND_OTHER,
+        NUM_SKELETON_HANDS
+    };
+
+    struct SkeletonComponent
+    {
+        uint32_t index;
+        SkeletonHand hand;
+    };
+
+    class ComponentTable
+    {
+    public:
+        typedef std::unordered_map<std::string, uint32_t> PathIndex;
+
+        // copies definitions
+        ComponentTable(const KnuckleComponentDefinition *definitions, uint32_t count);
+
+        // parses the input profile at profile_path for one hand ("left" or "right").  profile_name
+        // is what the vrsystem knows it by, e.g. {soft_knuckles}/input/soft_knuckles_profile.json.
+        // null with *error set on failure.
+        static std::shared_ptr<const ComponentTable> FromProfile(const char *profile_path, const char *profile_name,
+            const char *hand, std::string *error);
+
+        const KnuckleComponentDefinition *Definitions() const { return m_definitions.data(); }
+        uint32_t Count() const { return (uint32_t)m_definitions.size(); }
+        const PathIndex &Index() const { return m_index; }
+        const std::vector<SkeletonComponent> &Skeletons() const { return m_skeletons; }
+        const std::string &Source() const { return m_source; }
+        const std::string &ProfileName() const { return m_profile_name; }
+        const std::string &ControllerType() const { return m_controller_type; }
+
+        bool Lookup(const std::string &path, uint32_t *index) const;
+
+    private:
+        ComponentTable() {}
+        void Add(const std::string &path, ComponentType type, EVRScalarType scalar_type = EVRScalarType(0),
+            EVRScalarUnits scalar_units = EVRScalarUnits(0), const std::string &skeleton_path = std::string());
+        void BuildIndexes();
+
+        std::vector<KnuckleComponentDefinition> m_definitions;
+        std::deque<std::string> m_strings;      // owns the definitions' paths; a deque never moves them
+        PathIndex m_index;
+        std::vector<SkeletonComponent> m_skeletons;
+        std::string m_source;                   // profile path, or "compiled"
+        std::string m_profile_name;             // unresolved, as in the setting
+        std::string m_controller_type;
+    };
+
+    // the table for a hand, from the "inputProfile" setting or else the compiled definitions.
+    // call once per hand at Init and share the result between the devices.
+    std::shared_ptr<const ComponentTable> load_component_table(ETrackedControllerRole role);
+};
@@ -1,54 +1,259 @@
 //////////////////////////////////////////////////////////////////////////////
-// dprintf.h
+// dprintf.cpp
 // See header file for description.
 //
+// The ring is a bounded multi producer / single consumer queue: producers
+// claim a slot with a compare-and-swap on the enqueue position and publish
+// it by storing the slot's sequence number; the writer thread consumes
+// slots in order once their sequence numbers say they are complete.
+//
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
 #include <openvr_driver.h>
+#include "dprintf.h"
 
 #if defined(_WIN32)
 #include <windows.h>
 // disable vc fopen warning
-#pragma warning(disable : 4996)  
-#define vsprintf vsprintf_s
+#pragma warning(disable : 4996)
 #endif
 
-void dprintf(const char *fmt, ...)
+namespace
 {
-    va_list args;
-    char buffer[2048];
+    const uint32_t kNumSlots = 1024;                // must be a power of two
+    const uint32_t kSlotTextSize = 248;
+    const uint32_t kBatchSize = 64 * 1024;
+    const int kWriterIdleSleepMs = 2;
 
-    va_start(args, fmt);
-    vsprintf(buffer, fmt, args);
-    va_end(args);
+    struct LogSlot
+    {
+        std::atomic<uint64_t> sequence;
+        char text[kSlotTextSize];
+    };
 
-#if !defined(NDEBUG)
-    static FILE *factory_log;
-    if (factory_log == 0)
+    class LogRing
     {
-        factory_log = fopen("c:\\temp\\soft_knuckles_log.txt", "wt");
-        if (!factory_log)
+    public:
+        LogRing()
+            : m_enqueue_pos(0),
+              m_dequeue_pos(0),
+              m_dropped(0),
+              m_start_count(0),
+              m_running(false),
+              m_file(nullptr)
         {
-            factory_log = fopen("c:\\temp\\soft_knuckles_log1.txt", "wt");
+            for (uint32_t i = 0; i < kNumSlots; i++)
+            {
+                m_slots[i].sequence.store(i, std::memory_order_relaxed);
+            }
         }
-    }
 
-    if (factory_log)
-    {
-        fprintf(factory_log, "%s", buffer);
-        fflush(factory_log);
-    }
+        ~LogRing()
+        {
+            Shutdown();
+        }
+
+        void Write(const char *fmt, va_list args)
+        {
+            uint64_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+            LogSlot *slot;
+            for (;;)
+            {
+                slot = &m_slots[pos & (kNumSlots - 1)];
+                uint64_t seq = slot->sequence.load(std::memory_order_acquire);
+                int64_t diff = (int64_t)seq - (int64_t)pos;
+                if (diff == 0)
+                {
+                    if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)
+                {
+                    // full: the writer hasn't caught up.  drop rather than wait.
+                    m_dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                else
+                {
+                    pos = m_enqueue_pos.load(std::memory_order_relaxed);
+                }
+            }
 
-#ifdef WIN32
-	OutputDebugStringA(buffer);
+            int len = vsnprintf(slot->text, kSlotTextSize, fmt, args);
+            if (len >= (int)kSlotTextSize)
+            {
+                // mark the truncation and keep the line ending
+                memcpy(slot->text + kSlotTextSize - 5, "...\n", 5);
+            }
+            else if (len < 0)
+            {
+                slot->text[0] = 0;
+            }
+            slot->sequence.store(pos + 1, std::memory_order_release);
+        }
+
+        void Start(const char *log_file_path)
+        {
+            std::lock_guard<std::mutex> lock(m_control_mutex);
+            if (log_file_path && log_file_path[0] && !m_file)
+            {
+                // only the writer touches m_file once running, so open it before starting the
+                // writer, or hand it over while the writer is paused below.
+                if (m_start_count > 0)
+                    StopWriter(false);
+                m_file = fopen(log_file_path, "wt");
+                if (m_start_count > 0)
+                    StartWriter();
+            }
+            if (m_start_count++ == 0)
+            {
+                StartWriter();
+            }
+        }
+
+        void Stop()
+        {
+            std::lock_guard<std::mutex> lock(m_control_mutex);
+            if (m_start_count == 0 || --m_start_count > 0)
+                return;
+            StopWriter();
+        }
+
+    private:
+        void Shutdown()
+        {
+            std::lock_guard<std::mutex> lock(m_control_mutex);
+            m_start_count = 0;
+            StopWriter();
+        }
+
+        void StartWriter()
+        {
+            m_running = true;
+            m_writer = std::thread(writer_thread, this);
+        }
+
+        void StopWriter(bool close_file = true)
+        {
+            m_running = false;
+            if (m_writer.joinable())
+            {
+                m_writer.join();
+            }
+            if (m_file && close_file)
+            {
+                fclose(m_file);
+                m_file = nullptr;
+            }
+        }
+
+        // copies completed messages into batch.  returns the number of bytes used.
+        uint32_t Drain(char *batch, uint32_t batch_size)
+        {
+            uint32_t used = 0;
+            for (;;)
+            {
+                LogSlot *slot = &m_slots[m_dequeue_pos & (kNumSlots - 1)];
+                if (slot->sequence.load(std::memory_order_acquire) != m_dequeue_pos + 1)
+                    break;
+                size_t len = strlen(slot->text);
+                if (used + len + 1 > batch_size)
+                    break;
+                memcpy(batch + used, slot->text, len);
+                used += (uint32_t)len;
+                slot->sequence.store(m_dequeue_pos + kNumSlots, std::memory_order_release);
+                m_dequeue_pos++;
+            }
+
+            uint64_t dropped = m_dropped.exchange(0, std::memory_order_relaxed);
+            if (dropped && used + 64 < batch_size)
+            {
+                used += snprintf(batch + used, batch_size - used, "dprintf: dropped %llu messages\n",
+                    (unsigned long long)dropped);
+            }
+            batch[used] = 0;
+            return used;
+        }
+
+        void Emit(const char *batch, uint32_t len)
+        {
+            if (m_file)
+            {
+                fwrite(batch, 1, len, m_file);
+                fflush(m_file);
+            }
+#if defined(_WIN32) && !defined(NDEBUG)
+            OutputDebugStringA(batch);
 #endif
+            if (vr::VRDriverContext() && vr::VRDriverLog())
+            {
+                vr::VRDriverLog()->Log(batch);
+            }
+        }
 
+        static void writer_thread(LogRing *pthis)
+        {
+#ifdef _WIN32
+            SetThreadDescription(GetCurrentThread(), L"soft knuckles log writer");
 #endif
+            static char batch[kBatchSize];
+            for (;;)
+            {
+                bool running = pthis->m_running;
+                uint32_t len = pthis->Drain(batch, sizeof(batch));
+                if (len)
+                {
+                    pthis->Emit(batch, len);
+                }
+                else if (!running)
+                {
+                    break;  // stopped and fully drained
+                }
+                else
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(kWriterIdleSleepMs));
+                }
+            }
+        }
+
+        LogSlot m_slots[kNumSlots];
+        std::atomic<uint64_t> m_enqueue_pos;
+        uint64_t m_dequeue_pos;                 // only touched by the writer thread
+        std::atomic<uint64_t> m_dropped;
+
+        std::mutex m_control_mutex;
+        int m_start_count;
+        std::atomic<bool> m_running;
+        std::thread m_writer;
+        FILE *m_file;
+    };
 
-    if (vr::VRDriverContext() && vr::VRDriverLog())
+    LogRing &log_ring()
     {
-        vr::VRDriverLog()->Log(buffer);
+        static LogRing ring;
+        return ring;
     }
+}
+
+void dprintf(const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    log_ring().Write(fmt, args);
+    va_end(args);
+}
 
-    
-}
\ No newline at end of file
+void dprintf_start(const char *log_file_path)
+{
+    log_ring().Start(log_file_path);
+}
+
+void dprintf_stop()
+{
+    log_ring().Stop();
+}
@@ -1,8 +1,135 @@
 //////////////////////////////////////////////////////////////////////////////
 // dprintf.h
-// common logging functionality.  
-// In debug builds, logs to a file as well as to vr::VRDriverLog and outputdebugstring
-// In release builds, logs only to vr::VRDriverLog
+// common logging functionality.
+// dprintf formats into a slot of a fixed size lock-free ring buffer and
+// returns; it never blocks, allocates or makes a syscall.  A background
+// writer thread drains the ring in batches to vr::VRDriverLog, to a log file
+// and, in debug builds on windows, to OutputDebugString.
+//
+// Messages logged before dprintf_start are held in the ring (until it fills)
+// and written once the writer starts.  If the ring is full the message is
+// dropped and counted; long messages are truncated.
+//
+// Prefer the leveled DLOG_xxx macros below over calling dprintf directly.
+// Levels above SK_LOG_LEVEL compile to nothing, arguments included, so
+// debug and trace logging on hot paths costs nothing in release builds.
+// The DLOG_xxx_LIMITED variants also rate limit each call site with its
+// own token bucket: at most `burst` messages at once, refilling at
+// `per_second`.  Suppressed messages are counted and reported with the
+// next message that gets through.
 //
 #pragma once
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+
 extern void dprintf(const char *fmt, ...);
+
+// starts the writer thread.  log_file_path may be null or empty for no file.
+// calls are reference counted so the provider and watchdog can both start it.
+extern void dprintf_start(const char *log_file_path);
+
+// writes out everything queued so far and, on the last matching call, stops the writer.
+extern void dprintf_stop();
+
+#define SK_LOG_LEVEL_ERROR  0
+#define SK_LOG_LEVEL_WARN   1
+#define SK_LOG_LEVEL_INFO   2
+#define SK_LOG_LEVEL_DEBUG  3
+#define SK_LOG_LEVEL_TRACE  4
+
+#ifndef SK_LOG_LEVEL
+#if defined(NDEBUG)
+#define SK_LOG_LEVEL SK_LOG_LEVEL_INFO
+#else
+#define SK_LOG_LEVEL SK_LOG_LEVEL_DEBUG
+#endif
+#endif
+
+// per call site token bucket, implemented as a generic cell rate algorithm
+// over a single atomic "theoretical arrival time".
+class DLogRateLimiter
+{
+public:
+    DLogRateLimiter(double per_second, int burst)
+        : m_interval_ns((int64_t)(1e9 / per_second)),
+          m_tolerance_ns((int64_t)(1e9 / per_second) * (burst > 1 ? burst - 1 : 0)),
+          m_tat_ns(0),
+          m_suppressed(0)
+    {}
+
+    bool Allow(uint32_t *suppressed)
+    {
+        int64_t now = (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        int64_t tat = m_tat_ns.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            if (tat - now > m_tolerance_ns)
+            {
+                m_suppressed.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            int64_t next = (tat > now ? tat : now) + m_interval_ns;
+            if (m_tat_ns.compare_exchange_weak(tat, next, std::memory_order_relaxed))
+                break;
+        }
+        *suppressed = m_suppressed.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    int64_t m_interval_ns;
+    int64_t m_tolerance_ns;
+    std::atomic<int64_t> m_tat_ns;
+    std::atomic<uint32_t> m_suppressed;
+};
+
+#define SK_DLOG_LIMITED(per_second, burst, ...) \
+    do { \
+        static DLogRateLimiter sk_dlog_limiter((per_second), (burst)); \
+        uint32_t sk_dlog_suppressed; \
+        if (sk_dlog_limiter.Allow(&sk_dlog_suppressed)) \
+        { \
+            if (sk_dlog_suppressed) \
+                dprintf("(%u similar messages suppressed)\n", sk_dlog_suppressed); \
+            dprintf(__VA_ARGS__); \
+        } \
+    } while (0)
+
+#define SK_DLOG_DISABLED(...) do {} while (0)
+
+#define DLOG_ERROR(...) dprintf(__VA_ARGS__)
+#define DLOG_ERROR_LIMITED(per_second, burst, ...) SK_DLOG_LIMITED(per_second, burst, __VA_ARGS__)
+
+#if SK_LOG_LEVEL >= SK_LOG_LEVEL_WARN
+#define DLOG_WARN(...) dprintf(__VA_ARGS__)
+#define DLOG_WARN_LIMITED(per_second, burst, ...) SK_DLOG_LIMITED(per_second, burst, __VA_ARGS__)
+#else
+#define DLOG_WARN(...) SK_DLOG_DISABLED()
+#define DLOG_WARN_LIMITED(...) SK_DLOG_DISABLED()
+#endif
+
+#if SK_LOG_LEVEL >= SK_LOG_LEVEL_INFO
+#define DLOG_INFO(...) dprintf(__VA_ARGS__)
+#define DLOG_INFO_LIMITED(per_second, burst, ...) SK_DLOG_LIMITED(per_second, burst, __VA_ARGS__)
+#else
+#define DLOG_INFO(...) SK_DLOG_DISABLED()
+#define DLOG_INFO_LIMITED(...) SK_DLOG_DISABLED()
+#endif
+
+#if SK_LOG_LEVEL >= SK_LOG_LEVEL_DEBUG
+#define DLOG_DEBUG(...) dprintf(__VA_ARGS__)
+#define DLOG_DEBUG_LIMITED(per_second, burst, ...) SK_DLOG_LIMITED(per_second, burst, __VA_ARGS__)
+#else
+#define DLOG_DEBUG(...) SK_DLOG_DISABLED()
+#define DLOG_DEBUG_LIMITED(...) SK_DLOG_DISABLED()
+#endif
+
+#if SK_LOG_LEVEL >= SK_LOG_LEVEL_TRACE
+#define DLOG_TRACE(...) dprintf(__VA_ARGS__)
+#define DLOG_TRACE_LIMITED(per_second, burst, ...) SK_DLOG_LIMITED(per_second, burst, __VA_ARGS__)
+#else
+#define DLOG_TRACE(...) SK_DLOG_DISABLED()
+#define DLOG_TRACE_LIMITED(...) SK_DLOG_DISABLED()
+#endif
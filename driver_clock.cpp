@@ -0,0 +1,152 @@
+//////////////////////////////////////////////////////////////////////////////
+// driver_clock.cpp
+//
+// See header for description
+//
+// In virtual mode every sleeper parks a Sleeper on g_sleepers and waits
+// for clock_advance() to mark it woken.  The advancing thread removes the
+// sleepers it wakes itself, so the "everyone is asleep" check can't count
+// a thread that has been woken but hasn't run yet.
+//
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "driver_clock.h"
+
+namespace soft_knuckles
+{
+
+namespace
+{
+    struct Sleeper
+    {
+        uint64_t deadline_ns;
+        bool woken;
+    };
+
+    std::atomic<bool> g_virtual(false);
+    std::atomic<uint64_t> g_virtual_now_ns(kVirtualClockStartNs);
+
+    std::mutex g_clock_mutex;                   // everything below
+    std::condition_variable g_clock_changed;
+    std::vector<Sleeper *> g_sleepers;
+    uint32_t g_attached = 0;
+
+    uint64_t steady_now_ns()
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+void clock_set_virtual(bool enabled)
+{
+    g_virtual = enabled;
+}
+
+bool clock_is_virtual()
+{
+    return g_virtual.load(std::memory_order_relaxed);
+}
+
+uint64_t clock_now_ns()
+{
+    if (clock_is_virtual())
+        return g_virtual_now_ns.load(std::memory_order_acquire);
+    return steady_now_ns();
+}
+
+void clock_sleep_until(uint64_t deadline_ns, const std::atomic<bool> &running)
+{
+    if (!clock_is_virtual())
+    {
+        uint64_t now_ns = steady_now_ns();
+        if (deadline_ns > now_ns)
+        {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(deadline_ns - now_ns));
+        }
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(g_clock_mutex);
+    if (g_virtual_now_ns.load(std::memory_order_relaxed) >= deadline_ns)
+        return;
+    Sleeper sleeper = { deadline_ns, false };
+    g_sleepers.push_back(&sleeper);
+    g_clock_changed.notify_all();           // an advance may be waiting for this thread to sleep
+    g_clock_changed.wait(lock, [&] { return sleeper.woken || !running; });
+    if (!sleeper.woken)
+    {
+        g_sleepers.erase(std::find(g_sleepers.begin(), g_sleepers.end(), &sleeper));
+    }
+}
+
+void clock_wake_sleepers()
+{
+    std::lock_guard<std::mutex> lock(g_clock_mutex);
+    g_clock_changed.notify_all();
+}
+
+void clock_attach_thread()
+{
+    std::lock_guard<std::mutex> lock(g_clock_mutex);
+    g_attached++;
+}
+
+void clock_detach_thread()
+{
+    std::lock_guard<std::mutex> lock(g_clock_mutex);
+    g_attached--;
+    g_clock_changed.notify_all();
+}
+
+bool clock_advance(uint64_t ns)
+{
+    if (!clock_is_virtual())
+        return false;
+
+    std::unique_lock<std::mutex> lock(g_clock_mutex);
+    uint64_t target_ns = g_virtual_now_ns.load(std::memory_order_relaxed) + ns;
+    for (;;)
+    {
+        // let every attached thread finish what it is doing and go back to sleep
+        g_clock_changed.wait(lock, [] { return g_sleepers.size() >= g_attached; });
+
+        uint64_t next_ns = target_ns;
+        for (Sleeper *sleeper : g_sleepers)
+        {
+            next_ns = std::min(next_ns, sleeper->deadline_ns);
+        }
+        g_virtual_now_ns.store(next_ns, std::memory_order_release);
+
+        bool woke_any = false;
+        for (size_t i = 0; i < g_sleepers.size();)
+        {
+            if (g_sleepers[i]->deadline_ns <= next_ns)
+            {
+                g_sleepers[i]->woken = true;
+                g_sleepers[i] = g_sleepers.back();
+                g_sleepers.pop_back();
+                woke_any = true;
+            }
+            else
+            {
+                i++;
+            }
+        }
+        if (woke_any)
+        {
+            g_clock_changed.notify_all();
+        }
+        else if (next_ns == target_ns)
+        {
+            break;
+        }
+    }
+    return true;
+}
+
+};
@@ -0,0 +1,51 @@
+//////////////////////////////////////////////////////////////////////////////
+// driver_clock.h
+//
+// The clock every timestamp and pose thread deadline in the driver is
+// taken from.
+//
+// By default it is the steady clock and sleeps are real sleeps.  With the
+// "virtualClock" setting the clock is virtual: it starts at
+// kVirtualClockStartNs and only moves when clock_advance() is called, from
+// the "clock advance" debug request or by a host that drives the clock
+// itself (soft_knuckles_mock_host --virtual).
+//
+// clock_advance() steps through time deadline by deadline.  It moves the
+// clock to the earliest deadline any attached thread sleeps until, wakes
+// that thread, waits for every attached thread to be back asleep, and
+// repeats until it reaches the target.  So each pose tick sees exactly the
+// time it would have in real time, with no scheduling jitter, and a long
+// scripted session finishes as fast as the ticks can run.  Its results are
+// the same from run to run.
+//
+// Threads that sleep on the clock attach before they start (the caller
+// attaches on their behalf, so an advance can't miss their first tick) and
+// detach as they exit.
+//
+#pragma once
+#include <stdint.h>
+#include <atomic>
+
+namespace soft_knuckles
+{
+    static const uint64_t kVirtualClockStartNs = 1000000000ull;
+
+    // switch modes before any thread uses the clock.  Init only.
+    void clock_set_virtual(bool enabled);
+    bool clock_is_virtual();
+
+    uint64_t clock_now_ns();
+
+    // returns at deadline_ns, or early once running is false and clock_wake_sleepers() is called
+    void clock_sleep_until(uint64_t deadline_ns, const std::atomic<bool> &running);
+
+    // call after clearing a running flag a sleeper waits on
+    void clock_wake_sleepers();
+
+    void clock_attach_thread();
+    void clock_detach_thread();
+
+    // virtual mode only: moves the clock forward, running every deadline on the way.
+    // returns false in real time.
+    bool clock_advance(uint64_t ns);
+};
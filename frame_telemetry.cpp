@@ -0,0 +1,92 @@
+//////////////////////////////////////////////////////////////////////////////
+// frame_telemetry.cpp
+//
+// See header for description
+//
+#include <stdio.h>
+#include "frame_telemetry.h"
+
+namespace soft_knuckles
+{
+
+FrameTelemetry g_frame_telemetry;
+
+void FrameTelemetry::PerFrame::Sample(const TelemetryCounter &counter)
+{
+    uint64_t total = counter.total.load(std::memory_order_relaxed);
+    uint64_t delta = total - last_total.load(std::memory_order_relaxed);
+    last_total.store(total, std::memory_order_relaxed);
+    sum.fetch_add(delta, std::memory_order_relaxed);
+    if (delta > max.load(std::memory_order_relaxed))
+    {
+        max.store(delta, std::memory_order_relaxed);
+    }
+    if (delta == 0)
+    {
+        empty_frames.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void FrameTelemetry::PerFrame::Reset(const TelemetryCounter &counter)
+{
+    last_total.store(counter.total.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+    empty_frames.store(0, std::memory_order_relaxed);
+}
+
+FrameTelemetry::FrameTelemetry()
+    : m_frames(0), m_last_frame_ns(0), m_frames_since_reset(0)
+{
+}
+
+uint64_t FrameTelemetry::FrameStarted(uint64_t now_ns)
+{
+    uint64_t last_ns = m_last_frame_ns.exchange(now_ns, std::memory_order_relaxed);
+    if (last_ns)
+    {
+        // the first frame has no interval, and its counts cover everything before it
+        m_frame_interval.Record(now_ns - last_ns);
+        m_commands.Sample(commands);
+        m_poses.Sample(poses);
+        m_skeletons.Sample(skeletons);
+        m_frames_since_reset.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        m_commands.Reset(commands);
+        m_poses.Reset(poses);
+        m_skeletons.Reset(skeletons);
+    }
+    return m_frames.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+// the next frame starts a fresh interval
+void FrameTelemetry::Reset()
+{
+    m_last_frame_ns.store(0, std::memory_order_relaxed);
+    m_frames_since_reset.store(0, std::memory_order_relaxed);
+    m_frame_interval.Reset();
+    m_commands.Reset(commands);
+    m_poses.Reset(poses);
+    m_skeletons.Reset(skeletons);
+}
+
+std::string FrameTelemetry::Summary() const
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+        "frames %llu interval %s commands %llu %llu poses %llu %llu %llu skeletons %llu %llu",
+        (unsigned long long)m_frames_since_reset.load(std::memory_order_relaxed),
+        m_frame_interval.Summary().c_str(),
+        (unsigned long long)m_commands.sum.load(std::memory_order_relaxed),
+        (unsigned long long)m_commands.max.load(std::memory_order_relaxed),
+        (unsigned long long)m_poses.sum.load(std::memory_order_relaxed),
+        (unsigned long long)m_poses.max.load(std::memory_order_relaxed),
+        (unsigned long long)m_poses.empty_frames.load(std::memory_order_relaxed),
+        (unsigned long long)m_skeletons.sum.load(std::memory_order_relaxed),
+        (unsigned long long)m_skeletons.max.load(std::memory_order_relaxed));
+    return buf;
+}
+
+};
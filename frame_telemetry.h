@@ -0,0 +1,87 @@
+//////////////////////////////////////////////////////////////////////////////
+// frame_telemetry.h
+//
+// Per-frame counters, to tell whether the driver keeps up with the
+// compositor's frame cadence.
+//
+// The pose threads and debug requests bump driver-wide totals: commands
+// applied (debug requests and scheduled input events), poses submitted and
+// skeleton updates issued.  Each total sits on its own cache line so the
+// threads that bump them don't false-share.  RunFrame calls FrameStarted(),
+// which records the interval since the previous frame and how much each
+// total moved during that frame.
+//
+// Everything is relaxed atomics: bumping a counter is one uncontended add,
+// and reading while counting gives a slightly stale view, which is fine for
+// reporting.
+//
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include "latency_histogram.h"
+
+namespace soft_knuckles
+{
+    static const size_t kCacheLineSize = 64;
+
+    struct alignas(kCacheLineSize) TelemetryCounter
+    {
+        std::atomic<uint64_t> total;
+
+        TelemetryCounter() : total(0) {}
+
+        void Add(uint64_t n = 1)
+        {
+            total.fetch_add(n, std::memory_order_relaxed);
+        }
+    };
+    static_assert(sizeof(TelemetryCounter) == kCacheLineSize, "TelemetryCounter should fill one cache line");
+
+    class FrameTelemetry
+    {
+    public:
+        FrameTelemetry();
+
+        // bumped from any thread
+        TelemetryCounter commands;
+        TelemetryCounter poses;
+        TelemetryCounter skeletons;
+
+        // RunFrame only.  returns the frame number, counting from 1.
+        uint64_t FrameStarted(uint64_t now_ns);
+
+        void Reset();
+
+        // counts are since the last Reset():
+        // "frames <n> interval <count> <p50_us> <p99_us> <p99.9_us> <max_us>
+        //  commands <total> <max/frame> poses <total> <max/frame> <frames without one>
+        //  skeletons <total> <max/frame>"
+        std::string Summary() const;
+
+    private:
+        // how much a counter moved per frame.  written by RunFrame only.
+        struct PerFrame
+        {
+            std::atomic<uint64_t> last_total;
+            std::atomic<uint64_t> sum;          // since the last reset
+            std::atomic<uint64_t> max;
+            std::atomic<uint64_t> empty_frames;
+
+            PerFrame() : last_total(0), sum(0), max(0), empty_frames(0) {}
+            void Sample(const TelemetryCounter &counter);
+            void Reset(const TelemetryCounter &counter);
+        };
+
+        alignas(kCacheLineSize) std::atomic<uint64_t> m_frames;
+        std::atomic<uint64_t> m_last_frame_ns;
+        std::atomic<uint64_t> m_frames_since_reset;
+        PerFrame m_commands;
+        PerFrame m_poses;
+        PerFrame m_skeletons;
+        LatencyHistogram m_frame_interval;
+    };
+
+    // one per driver
+    extern FrameTelemetry g_frame_telemetry;
+};
@@ -0,0 +1,68 @@
+//////////////////////////////////////////////////////////////////////////////
+// haptic_ring.cpp
+//
+// See header for description
+//
+#include "haptic_ring.h"
+
+namespace soft_knuckles
+{
+
+HapticRing::HapticRing()
+    : m_write(0),
+      m_read(0),
+      m_received(0),
+      m_dropped(0)
+{
+}
+
+void HapticRing::Push(const HapticEvent &event)
+{
+    m_received.fetch_add(1, std::memory_order_relaxed);
+    m_age.Record(event.age_ns);
+    uint64_t w = m_write.load(std::memory_order_relaxed);
+    if (w - m_read.load(std::memory_order_acquire) >= kCapacity)
+    {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    m_events[w & (kCapacity - 1)] = event;
+    m_write.store(w + 1, std::memory_order_release);
+}
+
+uint32_t HapticRing::Pop(HapticEvent *events, uint32_t max_events)
+{
+    std::lock_guard<std::mutex> lock(m_read_mutex);
+    uint64_t r = m_read.load(std::memory_order_relaxed);
+    uint64_t w = m_write.load(std::memory_order_acquire);
+    uint32_t n = 0;
+    for (; r != w && n < max_events; r++, n++)
+    {
+        events[n] = m_events[r & (kCapacity - 1)];
+    }
+    m_read.store(r, std::memory_order_release);
+    return n;
+}
+
+void HapticRing::Reset()
+{
+    std::lock_guard<std::mutex> lock(m_read_mutex);
+    m_read.store(m_write.load(std::memory_order_acquire), std::memory_order_release);
+    m_received.store(0, std::memory_order_relaxed);
+    m_dropped.store(0, std::memory_order_relaxed);
+    m_age.Reset();
+}
+
+uint32_t HapticRing::Pending() const
+{
+    return (uint32_t)(m_write.load(std::memory_order_acquire) - m_read.load(std::memory_order_acquire));
+}
+
+std::string HapticRing::Summary() const
+{
+    return std::to_string(m_received.load(std::memory_order_relaxed)) + " " +
+        std::to_string(m_dropped.load(std::memory_order_relaxed)) + " " +
+        std::to_string(Pending()) + " " + m_age.Summary();
+}
+
+};
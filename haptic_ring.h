@@ -0,0 +1,65 @@
+//////////////////////////////////////////////////////////////////////////////
+// haptic_ring.h
+//
+// Per device capture of the haptic vibrations applications send to
+// /output/haptic.  The provider's RunFrame drains VREvent_Input_HapticVibration
+// events and pushes each onto the device's ring.  Test harnesses read them
+// back with the "haptics" debug request.
+//
+// The ring is single producer (RunFrame) and lock free on that side.  When
+// it is full, new events are dropped and counted rather than blocking the
+// frame.  Readers, which are debug requests, take a mutex among themselves
+// only.
+//
+// Each event's eventAgeSeconds (how long the host held it before RunFrame
+// polled it) goes into a latency histogram: the app to driver haptic latency.
+//
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include "latency_histogram.h"
+
+namespace soft_knuckles
+{
+    struct HapticEvent
+    {
+        uint64_t receive_ns;        // driver clock when RunFrame polled it
+        uint64_t age_ns;            // how old the host said it was then
+        float duration_seconds;
+        float frequency;
+        float amplitude;
+    };
+
+    class HapticRing
+    {
+    public:
+        static const uint32_t kCapacity = 256;     // must be a power of two
+
+        HapticRing();
+
+        // RunFrame only
+        void Push(const HapticEvent &event);
+
+        // oldest first.  returns the number copied.
+        uint32_t Pop(HapticEvent *events, uint32_t max_events);
+
+        // drops pending events and zeroes the counts and latency
+        void Reset();
+
+        uint32_t Pending() const;
+
+        // "<received> <dropped> <pending> <latency count p50 p99 p99.9 max (us)>"
+        std::string Summary() const;
+
+    private:
+        HapticEvent m_events[kCapacity];
+        std::atomic<uint64_t> m_write;
+        std::atomic<uint64_t> m_read;
+        std::atomic<uint64_t> m_received;
+        std::atomic<uint64_t> m_dropped;
+        std::mutex m_read_mutex;
+        LatencyHistogram m_age;
+    };
+};
@@ -0,0 +1,91 @@
+//////////////////////////////////////////////////////////////////////////////
+// input_event_queue.cpp
+//
+// See header for description
+//
+#include <algorithm>
+#include "input_event_queue.h"
+
+namespace soft_knuckles
+{
+
+static const uint64_t kEmpty = UINT64_MAX;
+
+InputEventQueue::InputEventQueue()
+    : m_next_due_ns(kEmpty),
+      m_sequence(0),
+      m_size(0)
+{
+}
+
+// heap comparator: the root is the earliest event
+bool InputEventQueue::later(const Entry &a, const Entry &b)
+{
+    if (a.due_ns != b.due_ns)
+        return a.due_ns > b.due_ns;
+    return a.sequence > b.sequence;
+}
+
+void InputEventQueue::UpdateNextDue()
+{
+    m_next_due_ns.store(m_size ? m_heap[0].due_ns : kEmpty, std::memory_order_release);
+}
+
+bool InputEventQueue::Push(const InputEvent *events, uint32_t count)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (count > kCapacity - m_size)
+        return false;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        Entry &e = m_heap[m_size++];
+        e.due_ns = events[i].due_ns;
+        e.sequence = m_sequence++;
+        e.component_index = events[i].component_index;
+        e.value = events[i].value;
+        std::push_heap(m_heap, m_heap + m_size, later);
+    }
+    UpdateNextDue();
+    return true;
+}
+
+void InputEventQueue::Clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_size = 0;
+    UpdateNextDue();
+}
+
+uint32_t InputEventQueue::Size()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_size;
+}
+
+uint32_t InputEventQueue::Drain(uint64_t now_ns, GeneratorOutputFn output, void *context)
+{
+    if (m_next_due_ns.load(std::memory_order_acquire) > now_ns)
+        return 0;
+
+    // pop under the lock, emit outside of it so the output can't block producers
+    Entry due[kCapacity];
+    uint32_t num_due = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        while (m_size && m_heap[0].due_ns <= now_ns)
+        {
+            std::pop_heap(m_heap, m_heap + m_size, later);
+            due[num_due++] = m_heap[--m_size];
+        }
+        UpdateNextDue();
+    }
+
+    for (uint32_t i = 0; i < num_due; i++)
+    {
+        output(context, due[i].component_index, due[i].value);
+    }
+    return num_due;
+}
+
+};
@@ -0,0 +1,61 @@
+//////////////////////////////////////////////////////////////////////////////
+// input_event_queue.h
+//
+// Per device queue of timed input events: "set component N to value V at
+// time T".  Debug requests (e.g. running a macro) push batches of events;
+// the device pose thread drains every event that has come due on each tick.
+//
+// The queue is a fixed size binary heap ordered by due time and then by
+// insertion order, so events with the same due time are applied in the
+// order they were queued.  The pose thread only takes the lock when the
+// earliest event has come due.
+//
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include "input_generator.h"
+
+namespace soft_knuckles
+{
+    struct InputEvent
+    {
+        uint64_t due_ns;
+        uint32_t component_index;
+        float value;
+    };
+
+    class InputEventQueue
+    {
+    public:
+        static const uint32_t kCapacity = 256;
+
+        InputEventQueue();
+
+        // all or nothing: fails without queueing anything if the batch doesn't fit
+        bool Push(const InputEvent *events, uint32_t count);
+        void Clear();
+
+        // called from the pose thread: emits every event due at or before now_ns
+        uint32_t Drain(uint64_t now_ns, GeneratorOutputFn output, void *context);
+
+        uint32_t Size();
+
+    private:
+        struct Entry
+        {
+            uint64_t due_ns;
+            uint64_t sequence;
+            uint32_t component_index;
+            float value;
+        };
+        static bool later(const Entry &a, const Entry &b);
+        void UpdateNextDue();
+
+        std::mutex m_mutex;
+        std::atomic<uint64_t> m_next_due_ns;    // UINT64_MAX when empty
+        uint64_t m_sequence;
+        uint32_t m_size;
+        Entry m_heap[kCapacity];
+    };
+};
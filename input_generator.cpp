@@ -0,0 +1,199 @@
+//////////////////////////////////////////////////////////////////////////////
+// input_generator.cpp
+//
+// See header for description
+//
+#include <math.h>
+#include <string.h>
+#include "input_generator.h"
+
+namespace soft_knuckles
+{
+
+static const double kPi = 3.14159265358979323846;
+
+bool parse_easing(const char *name, GeneratorEasing *easing)
+{
+    static const struct { const char *name; GeneratorEasing easing; } easings[] =
+    {
+        { "linear", EASE_LINEAR },
+        { "in", EASE_IN },
+        { "out", EASE_OUT },
+        { "inout", EASE_IN_OUT },
+        { "sine", EASE_SINE },
+    };
+    for (size_t i = 0; i < sizeof(easings) / sizeof(easings[0]); i++)
+    {
+        if (strcmp(name, easings[i].name) == 0)
+        {
+            *easing = easings[i].easing;
+            return true;
+        }
+    }
+    return false;
+}
+
+static double ease(GeneratorEasing easing, double t)
+{
+    switch (easing)
+    {
+        case EASE_IN:       return t * t;
+        case EASE_OUT:      return t * (2.0 - t);
+        case EASE_IN_OUT:   return t * t * (3.0 - 2.0 * t);
+        case EASE_SINE:     return 0.5 - 0.5 * cos(t * kPi);
+        case EASE_LINEAR:
+        default:            return t;
+    }
+}
+
+InputGeneratorSet::InputGeneratorSet()
+    : m_active_count(0)
+{
+    memset(m_generators, 0, sizeof(m_generators));
+}
+
+InputGeneratorSet::Generator *InputGeneratorSet::Allocate(uint32_t component_index)
+{
+    Generator *free_slot = nullptr;
+    for (int i = 0; i < kMaxGenerators; i++)
+    {
+        Generator &g = m_generators[i];
+        if (g.kind != GK_NONE && g.component_index == component_index)
+        {
+            return &g;
+        }
+        if (g.kind == GK_NONE && !free_slot)
+        {
+            free_slot = &g;
+        }
+    }
+    if (free_slot)
+    {
+        m_active_count++;
+    }
+    return free_slot;
+}
+
+bool InputGeneratorSet::StartRamp(uint32_t component_index, float start_value, float target_value,
+    uint64_t start_ns, uint64_t duration_ns, GeneratorEasing easing, uint32_t repeat)
+{
+    if (duration_ns == 0)
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Generator *g = Allocate(component_index);
+    if (!g)
+        return false;
+    g->kind = GK_RAMP;
+    g->component_index = component_index;
+    g->start_value = start_value;
+    g->target_value = target_value;
+    g->start_ns = start_ns;
+    g->duration_ns = duration_ns;
+    g->period_ns = duration_ns;
+    g->easing = easing;
+    g->repeat = repeat;
+    g->have_last_value = false;
+    return true;
+}
+
+bool InputGeneratorSet::StartPulse(uint32_t component_index, float rest_value, float pulse_value,
+    uint64_t start_ns, uint64_t duration_ns, uint64_t period_ns, uint32_t repeat)
+{
+    if (duration_ns == 0 || period_ns < duration_ns)
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Generator *g = Allocate(component_index);
+    if (!g)
+        return false;
+    g->kind = GK_PULSE;
+    g->component_index = component_index;
+    g->start_value = rest_value;
+    g->target_value = pulse_value;
+    g->start_ns = start_ns;
+    g->duration_ns = duration_ns;
+    g->period_ns = period_ns;
+    g->easing = EASE_LINEAR;
+    g->repeat = repeat;
+    g->have_last_value = false;
+    return true;
+}
+
+void InputGeneratorSet::Stop(uint32_t component_index)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (int i = 0; i < kMaxGenerators; i++)
+    {
+        if (m_generators[i].kind != GK_NONE && m_generators[i].component_index == component_index)
+        {
+            m_generators[i].kind = GK_NONE;
+            m_active_count--;
+        }
+    }
+}
+
+void InputGeneratorSet::StopAll()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (int i = 0; i < kMaxGenerators; i++)
+    {
+        m_generators[i].kind = GK_NONE;
+    }
+    m_active_count = 0;
+}
+
+void InputGeneratorSet::Evaluate(uint64_t now_ns, GeneratorOutputFn output, void *context)
+{
+    if (m_active_count.load(std::memory_order_relaxed) == 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (int i = 0; i < kMaxGenerators; i++)
+    {
+        Generator &g = m_generators[i];
+        if (g.kind == GK_NONE || now_ns < g.start_ns)
+            continue;
+
+        uint64_t elapsed = now_ns - g.start_ns;
+        uint64_t cycle = elapsed / g.period_ns;
+        uint64_t into_cycle = elapsed % g.period_ns;
+        bool finished = g.repeat != 0 && cycle >= g.repeat;
+
+        float value;
+        if (g.kind == GK_RAMP)
+        {
+            if (finished)
+            {
+                // land exactly on the end of the last cycle
+                value = (g.repeat % 2) ? g.target_value : g.start_value;
+            }
+            else
+            {
+                double t = ease(g.easing, double(into_cycle) / double(g.duration_ns));
+                if (cycle % 2)
+                    t = 1.0 - t;
+                value = float(g.start_value + (g.target_value - g.start_value) * t);
+            }
+        }
+        else
+        {
+            value = (!finished && into_cycle < g.duration_ns) ? g.target_value : g.start_value;
+        }
+
+        if (!g.have_last_value || value != g.last_value)
+        {
+            output(context, g.component_index, value);
+            g.last_value = value;
+            g.have_last_value = true;
+        }
+
+        if (finished)
+        {
+            g.kind = GK_NONE;
+            m_active_count--;
+        }
+    }
+}
+
+};
@@ -0,0 +1,86 @@
+//////////////////////////////////////////////////////////////////////////////
+// input_generator.h
+//
+// Server side ramp and pulse generators for input components.
+//
+// Instead of streaming hundreds of scalar debug requests to sweep a
+// trigger or joystick axis, one request starts a generator on the device.
+// The device pose thread evaluates every active generator once per tick
+// and pushes the resulting values to the component, so the sweep is
+// smooth and exactly timed at the pose thread's resolution.
+//
+//  ramp:  moves from the component's current value to a target over a
+//         duration along an easing curve.  with repeat > 1 it sweeps back
+//         and forth, i.e. odd cycles run target -> start.
+//  pulse: holds a value for a duration, then returns to the value the
+//         component had when the pulse started, once per period.
+//
+// A repeat count of 0 runs until stopped.  There is a fixed number of
+// generator slots per device; starting a generator on a component that
+// already has one replaces it.
+//
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+
+namespace soft_knuckles
+{
+    enum GeneratorEasing
+    {
+        EASE_LINEAR,
+        EASE_IN,        // quadratic, slow start
+        EASE_OUT,       // quadratic, slow finish
+        EASE_IN_OUT,    // smoothstep
+        EASE_SINE,      // half cosine
+    };
+
+    bool parse_easing(const char *name, GeneratorEasing *easing);
+
+    // receives the values produced by the generators
+    typedef void(*GeneratorOutputFn)(void *context, uint32_t component_index, float value);
+
+    class InputGeneratorSet
+    {
+    public:
+        static const int kMaxGenerators = 8;
+
+        InputGeneratorSet();
+
+        bool StartRamp(uint32_t component_index, float start_value, float target_value,
+            uint64_t start_ns, uint64_t duration_ns, GeneratorEasing easing, uint32_t repeat);
+        bool StartPulse(uint32_t component_index, float rest_value, float pulse_value,
+            uint64_t start_ns, uint64_t duration_ns, uint64_t period_ns, uint32_t repeat);
+        void Stop(uint32_t component_index);
+        void StopAll();
+
+        // called from the pose thread once per tick
+        void Evaluate(uint64_t now_ns, GeneratorOutputFn output, void *context);
+
+        int ActiveCount() const { return m_active_count.load(std::memory_order_relaxed); }
+
+    private:
+        enum GeneratorKind { GK_NONE, GK_RAMP, GK_PULSE };
+
+        struct Generator
+        {
+            GeneratorKind kind;
+            uint32_t component_index;
+            float start_value;      // ramp start, or pulse rest value
+            float target_value;     // ramp target, or pulse value
+            uint64_t start_ns;
+            uint64_t duration_ns;
+            uint64_t period_ns;
+            GeneratorEasing easing;
+            uint32_t repeat;
+            float last_value;
+            bool have_last_value;
+        };
+
+        Generator *Allocate(uint32_t component_index);
+
+        std::mutex m_mutex;
+        std::atomic<int> m_active_count;
+        Generator m_generators[kMaxGenerators];
+    };
+};
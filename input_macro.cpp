@@ -0,0 +1,121 @@
+//////////////////////////////////////////////////////////////////////////////
+// input_macro.cpp
+//
+// See header for description
+//
+#include <stdlib.h>
+#include <string.h>
+#include "dprintf.h"
+#include "input_macro.h"
+
+using namespace std;
+
+namespace soft_knuckles
+{
+
+static void split(const string &input, const char *delim, vector<string> *ret)
+{
+    ret->resize(0);
+    size_t start = input.find_first_not_of(delim);
+    while (start != string::npos)
+    {
+        size_t end = input.find_first_of(delim, start);
+        ret->push_back(input.substr(start, end == string::npos ? string::npos : end - start));
+        start = input.find_first_not_of(delim, end);
+    }
+}
+
+bool MacroTable::Define(const string &name, const vector<string> &tokens, size_t first,
+    const PathIndex &path_index, const char *hand)
+{
+    if (first >= tokens.size() || (tokens.size() - first) % 3 != 0)
+    {
+        DLOG_WARN("macro %s: expected <path> <value> <offset_ms> triples\n", name.c_str());
+        return false;
+    }
+
+    vector<MacroStep> steps;
+    steps.reserve((tokens.size() - first) / 3);
+    for (size_t i = first; i < tokens.size(); i += 3)
+    {
+        string path = tokens[i];
+        size_t hand_pos = path.find("{hand}");
+        if (hand_pos != string::npos)
+        {
+            path.replace(hand_pos, 6, hand);
+        }
+        auto iter = path_index.find(path);
+        if (iter == path_index.end())
+        {
+            DLOG_WARN("macro %s: unknown component %s\n", name.c_str(), path.c_str());
+            return false;
+        }
+        double offset_ms = atof(tokens[i + 2].c_str());
+        if (offset_ms < 0)
+        {
+            DLOG_WARN("macro %s: negative offset for %s\n", name.c_str(), path.c_str());
+            return false;
+        }
+
+        MacroStep step;
+        step.component_index = (*iter).second;
+        step.value = (float)atof(tokens[i + 1].c_str());
+        step.offset_us = (uint32_t)(offset_ms * 1000.0);
+        steps.push_back(step);
+    }
+
+    m_macros[name].swap(steps);
+    return true;
+}
+
+int MacroTable::DefineAll(const char *definitions, const PathIndex &path_index, const char *hand)
+{
+    int defined = 0;
+    vector<string> macros;
+    split(definitions, ";", &macros);
+    for (const string &macro : macros)
+    {
+        size_t colon = macro.find(':');
+        if (colon == string::npos)
+        {
+            DLOG_WARN("macro definition missing ':' in \"%s\"\n", macro.c_str());
+            continue;
+        }
+        vector<string> name;
+        split(macro.substr(0, colon), " \t\r\n", &name);
+        vector<string> tokens;
+        split(macro.substr(colon + 1), " \t\r\n,", &tokens);
+        if (name.size() == 1 && Define(name[0], tokens, 0, path_index, hand))
+        {
+            defined++;
+        }
+    }
+    return defined;
+}
+
+bool MacroTable::Remove(const string &name)
+{
+    return m_macros.erase(name) > 0;
+}
+
+const vector<MacroStep> *MacroTable::Find(const string &name) const
+{
+    auto iter = m_macros.find(name);
+    if (iter == m_macros.end())
+        return nullptr;
+    return &(*iter).second;
+}
+
+string MacroTable::Names() const
+{
+    string names;
+    for (auto &entry : m_macros)
+    {
+        if (!names.empty())
+            names += " ";
+        names += entry.first;
+    }
+    return names;
+}
+
+};
@@ -0,0 +1,55 @@
+//////////////////////////////////////////////////////////////////////////////
+// input_macro.h
+//
+// Named input macros such as "grab" (grip click + trigger 1.0 + fist
+// skeleton) or "menu press-release".
+//
+// A macro is written as a list of "<path> <value> <offset_ms>" steps, e.g.
+//
+//   /input/grip/click 1 0 /input/trigger/value 1 0 /input/skeleton/{hand} 1 0
+//
+// where {hand} is replaced with left or right for the device the macro is
+// compiled for.  Compiling resolves each path through the device's
+// component table once, so a compiled macro is a flat array of
+// (component index, value, time offset) records that can be pushed into
+// the device's InputEventQueue in one go.
+//
+// Macros come from the "macros" setting in driver_soft_knuckles,
+//   "name: <steps>; name: <steps>"
+// and from the macro_define debug request at runtime.
+//
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace soft_knuckles
+{
+    struct MacroStep
+    {
+        uint32_t component_index;
+        float value;
+        uint32_t offset_us;
+    };
+
+    class MacroTable
+    {
+    public:
+        typedef std::unordered_map<std::string, uint32_t> PathIndex;
+
+        // compiles tokens[first..] as path/value/offset_ms triples and stores it as name
+        bool Define(const std::string &name, const std::vector<std::string> &tokens, size_t first,
+            const PathIndex &path_index, const char *hand);
+
+        // parses the "name: steps; name: steps" settings format
+        int DefineAll(const char *definitions, const PathIndex &path_index, const char *hand);
+
+        bool Remove(const std::string &name);
+        const std::vector<MacroStep> *Find(const std::string &name) const;
+        std::string Names() const;
+
+    private:
+        std::unordered_map<std::string, std::vector<MacroStep>> m_macros;
+    };
+};
@@ -0,0 +1,136 @@
+//////////////////////////////////////////////////////////////////////////////
+// latency_histogram.cpp
+//
+// See header for description
+//
+// Bucket layout: values below 2 * kSubBucketCount each get their own
+// bucket.  Above that, a value with its top bit at position
+// kSubBucketBits + e (e >= 1) is shifted right by e, leaving a sub-bucket
+// in [kSubBucketCount, 2 * kSubBucketCount), and each e gets
+// kSubBucketCount buckets.
+//
+#include <math.h>
+#include <stdio.h>
+#include "latency_histogram.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace soft_knuckles
+{
+
+static inline uint32_t highest_bit(uint64_t value)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return (uint32_t)index;
+#else
+    return 63 - (uint32_t)__builtin_clzll(value);
+#endif
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+    Reset();
+}
+
+uint32_t LatencyHistogram::bucket_index(uint64_t value)
+{
+    if (value < 2 * kSubBucketCount)
+        return (uint32_t)value;
+    uint32_t e = highest_bit(value) - kSubBucketBits;
+    if (e > kMaxMagnitude)
+        return kNumBuckets - 1;
+    uint32_t sub = (uint32_t)(value >> e);
+    return 2 * kSubBucketCount + (e - 1) * kSubBucketCount + (sub - kSubBucketCount);
+}
+
+uint64_t LatencyHistogram::bucket_upper_bound(uint32_t index)
+{
+    if (index < 2 * kSubBucketCount)
+        return index;
+    uint32_t e = (index - 2 * kSubBucketCount) / kSubBucketCount + 1;
+    uint64_t sub = (index - 2 * kSubBucketCount) % kSubBucketCount + kSubBucketCount;
+    return ((sub + 1) << e) - 1;
+}
+
+void LatencyHistogram::Record(uint64_t value_ns)
+{
+    m_counts[bucket_index(value_ns)].fetch_add(1, std::memory_order_relaxed);
+    m_total.fetch_add(1, std::memory_order_relaxed);
+    uint64_t max = m_max.load(std::memory_order_relaxed);
+    while (value_ns > max && !m_max.compare_exchange_weak(max, value_ns, std::memory_order_relaxed))
+    {
+    }
+}
+
+void LatencyHistogram::Reset()
+{
+    for (uint32_t i = 0; i < kNumBuckets; i++)
+    {
+        m_counts[i].store(0, std::memory_order_relaxed);
+    }
+    m_total.store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram &other)
+{
+    for (uint32_t i = 0; i < kNumBuckets; i++)
+    {
+        m_counts[i].fetch_add(other.m_counts[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    m_total.fetch_add(other.Count(), std::memory_order_relaxed);
+    uint64_t other_max = other.Max();
+    uint64_t max = m_max.load(std::memory_order_relaxed);
+    while (other_max > max && !m_max.compare_exchange_weak(max, other_max, std::memory_order_relaxed))
+    {
+    }
+}
+
+uint64_t LatencyHistogram::Count() const
+{
+    return m_total.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::Max() const
+{
+    return m_max.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::Percentile(double percentile) const
+{
+    uint64_t total = Count();
+    if (total == 0)
+        return 0;
+    uint64_t target = (uint64_t)ceil(percentile / 100.0 * (double)total);
+    if (target < 1)
+        target = 1;
+    uint64_t seen = 0;
+    uint64_t max = Max();
+    for (uint32_t i = 0; i < kNumBuckets; i++)
+    {
+        seen += m_counts[i].load(std::memory_order_relaxed);
+        if (seen >= target)
+        {
+            if (i == kNumBuckets - 1)
+                return max;     // the overflow bucket
+            uint64_t upper = bucket_upper_bound(i);
+            return upper < max ? upper : max;
+        }
+    }
+    return max;
+}
+
+std::string LatencyHistogram::Summary() const
+{
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%llu %.1f %.1f %.1f %.1f",
+        (unsigned long long)Count(),
+        Percentile(50.0) / 1000.0, Percentile(99.0) / 1000.0, Percentile(99.9) / 1000.0, Max() / 1000.0);
+    return buf;
+}
+
+};
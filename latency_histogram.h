@@ -0,0 +1,54 @@
+//////////////////////////////////////////////////////////////////////////////
+// latency_histogram.h
+//
+// HDR style latency histogram: log-linear buckets, 32 linear sub-buckets
+// per power of two, so any recorded value is reported to within about 3%
+// from 1ns up to about a minute.  Longer values land in the last bucket;
+// the exact maximum is tracked separately.
+//
+// Record() is a couple of relaxed atomic adds and never blocks, so it can be
+// called from the pose thread and debug requests at the same time.
+// Reading while recording gives a slightly stale but consistent enough view
+// for reporting.
+//
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+namespace soft_knuckles
+{
+    class LatencyHistogram
+    {
+    public:
+        static const uint32_t kSubBucketBits = 5;
+        static const uint32_t kSubBucketCount = 1 << kSubBucketBits;
+        static const uint32_t kMaxMagnitude = 31;          // up to 2^36 ns
+        static const uint32_t kNumBuckets = 2 * kSubBucketCount + kMaxMagnitude * kSubBucketCount;
+
+        LatencyHistogram();
+
+        void Record(uint64_t value_ns);
+        void Reset();
+
+        // adds other's counts into this one
+        void Merge(const LatencyHistogram &other);
+
+        uint64_t Count() const;
+        uint64_t Max() const;
+
+        // the upper bound of the bucket holding the given percentile (0-100), capped at Max()
+        uint64_t Percentile(double percentile) const;
+
+        // "<count> <p50_us> <p99_us> <p99.9_us> <max_us>"
+        std::string Summary() const;
+
+    private:
+        static uint32_t bucket_index(uint64_t value);
+        static uint64_t bucket_upper_bound(uint32_t index);
+
+        std::atomic<uint64_t> m_counts[kNumBuckets];
+        std::atomic<uint64_t> m_total;
+        std::atomic<uint64_t> m_max;
+    };
+};
@@ -5,7 +5,7 @@ export INCLUDES=-I$OPENVR_DIR/headers
 
 echo $INCLUDES
 
-export COMPILE_PFX="g++ $INCLUDES -std=c++11"
+export COMPILE_PFX="g++ $INCLUDES -std=c++11 -fPIC -O2"
 
 
 $COMPILE_PFX -c dprintf.cpp 
@@ -14,3 +14,32 @@ $COMPILE_PFX -c soft_knuckles_config.cpp
 $COMPILE_PFX -c soft_knuckles_debug_handler.cpp 
 $COMPILE_PFX -c soft_knuckles_device.cpp 
 $COMPILE_PFX -c soft_knuckles_provider.cpp 
+$COMPILE_PFX -c pose_history.cpp 
+$COMPILE_PFX -c pose_filter.cpp 
+$COMPILE_PFX -c input_generator.cpp 
+$COMPILE_PFX -c input_event_queue.cpp 
+$COMPILE_PFX -c input_macro.cpp 
+$COMPILE_PFX -c latency_histogram.cpp 
+$COMPILE_PFX -c trace.cpp 
+$COMPILE_PFX -c frame_telemetry.cpp 
+$COMPILE_PFX -c driver_clock.cpp 
+$COMPILE_PFX -c session_log.cpp 
+$COMPILE_PFX -c skeleton_codec.cpp 
+$COMPILE_PFX -c binary_command.cpp 
+$COMPILE_PFX -c haptic_ring.cpp 
+$COMPILE_PFX -c watchdog_waker.cpp 
+$COMPILE_PFX -c thread_tuning.cpp 
+$COMPILE_PFX -c component_table.cpp 
+
+g++ -shared -o driver_soft_knuckles.so *.o -lpthread
+
+# headless vrserver stand-in for running the driver without SteamVR
+$COMPILE_PFX -c soft_knuckles_mock_host/mock_host.cpp -o soft_knuckles_mock_host/mock_host.o
+$COMPILE_PFX -c soft_knuckles_mock_host/mock_host_main.cpp -o soft_knuckles_mock_host/mock_host_main.o
+g++ -o soft_knuckles_mock_host/soft_knuckles_mock_host soft_knuckles_mock_host/mock_host.o soft_knuckles_mock_host/mock_host_main.o -ldl -lpthread
+
+# microbenchmarks, if google benchmark is installed.  see soft_knuckles_benchmarks/driver_benchmarks.cpp
+if [ -f /usr/include/benchmark/benchmark.h ] || [ -f /usr/local/include/benchmark/benchmark.h ]; then
+$COMPILE_PFX -c soft_knuckles_benchmarks/driver_benchmarks.cpp -o soft_knuckles_benchmarks/driver_benchmarks.o
+g++ -o soft_knuckles_benchmarks/soft_knuckles_benchmarks soft_knuckles_benchmarks/driver_benchmarks.o soft_knuckles_mock_host/mock_host.o *.o -lbenchmark -ldl -lpthread
+fi
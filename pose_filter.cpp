@@ -0,0 +1,121 @@
+//////////////////////////////////////////////////////////////////////////////
+// pose_filter.cpp
+//
+// See header for description
+//
+#include <math.h>
+#include "pose_filter.h"
+#include "pose_math.h"
+
+namespace soft_knuckles
+{
+
+static const double kPi = 3.14159265358979323846;
+static const double kMinDt = 1e-4;  // samples closer than this are treated as 0.1ms apart
+
+// smoothing factor of a first order low-pass with the given cutoff, sampled dt apart
+static inline double lowpass_alpha(double cutoff, double dt)
+{
+    double tau = 1.0 / (2.0 * kPi * cutoff);
+    return 1.0 / (1.0 + tau / dt);
+}
+
+PoseFilterParams PoseFilter::DefaultParams()
+{
+    PoseFilterParams p;
+    p.min_cutoff = 1.0;
+    p.beta = 0.5;
+    p.derivative_cutoff = 1.0;
+    p.rotation_min_cutoff = 1.0;
+    p.rotation_beta = 0.5;
+    return p;
+}
+
+PoseFilter::PoseFilter()
+    : m_enabled(false),
+      m_params(DefaultParams())
+{
+    Reset();
+}
+
+void PoseFilter::Configure(bool enabled, const PoseFilterParams &params)
+{
+    m_enabled = enabled;
+    m_params = params;
+    Reset();
+}
+
+void PoseFilter::Reset()
+{
+    m_have_position = false;
+    m_position_t = 0;
+    m_have_rotation = false;
+    m_rotation_t = 0;
+    m_rotation = quat(1, 0, 0, 0);
+    m_angular_speed = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        m_position[i] = 0;
+        m_velocity[i] = 0;
+    }
+}
+
+void PoseFilter::FilterPosition(double t_seconds, const double in[3], double out[3])
+{
+    if (!m_have_position)
+    {
+        m_have_position = true;
+        m_position_t = t_seconds;
+        for (int i = 0; i < 3; i++)
+        {
+            m_position[i] = out[i] = in[i];
+            m_velocity[i] = 0;
+        }
+        return;
+    }
+
+    double dt = t_seconds - m_position_t;
+    if (dt < kMinDt)
+        dt = kMinDt;
+    m_position_t = t_seconds;
+
+    double derivative_alpha = lowpass_alpha(m_params.derivative_cutoff, dt);
+    for (int i = 0; i < 3; i++)
+    {
+        double raw_velocity = (in[i] - m_position[i]) / dt;
+        m_velocity[i] += derivative_alpha * (raw_velocity - m_velocity[i]);
+        double cutoff = m_params.min_cutoff + m_params.beta * fabs(m_velocity[i]);
+        m_position[i] += lowpass_alpha(cutoff, dt) * (in[i] - m_position[i]);
+        out[i] = m_position[i];
+    }
+}
+
+vr::HmdQuaternion_t PoseFilter::FilterRotation(double t_seconds, const vr::HmdQuaternion_t &in)
+{
+    if (!m_have_rotation)
+    {
+        m_have_rotation = true;
+        m_rotation_t = t_seconds;
+        m_rotation = in;
+        m_angular_speed = 0;
+        return m_rotation;
+    }
+
+    double dt = t_seconds - m_rotation_t;
+    if (dt < kMinDt)
+        dt = kMinDt;
+    m_rotation_t = t_seconds;
+
+    // angle between the filtered rotation and the new sample
+    double d = fabs(quat_dot(m_rotation, in));
+    if (d > 1.0)
+        d = 1.0;
+    double raw_speed = 2.0 * acos(d) / dt;
+
+    m_angular_speed += lowpass_alpha(m_params.derivative_cutoff, dt) * (raw_speed - m_angular_speed);
+    double cutoff = m_params.rotation_min_cutoff + m_params.rotation_beta * m_angular_speed;
+    m_rotation = quat_slerp(m_rotation, in, lowpass_alpha(cutoff, dt));
+    return m_rotation;
+}
+
+};
@@ -0,0 +1,62 @@
+//////////////////////////////////////////////////////////////////////////////
+// pose_filter.h
+//
+// Optional smoothing stage for poses that are pushed into a device from
+// outside (debug requests, scripts, sockets).  Those samples are noisy and
+// arrive at uneven intervals, so each one is run through:
+//
+//  * a One-Euro filter per position axis.  The cutoff frequency rises with
+//    the filtered speed, so slow movement is smoothed heavily and fast
+//    movement passes with little lag.
+//    See http://cristal.univ-lille.fr/~casiez/1euro/
+//
+//  * an adaptive quaternion low-pass for rotation: a slerp towards the new
+//    sample whose cutoff rises with the filtered angular speed in the same
+//    way.
+//
+// The state is a handful of doubles; filtering does not allocate.
+//
+#pragma once
+#include <openvr_driver.h>
+
+namespace soft_knuckles
+{
+    struct PoseFilterParams
+    {
+        double min_cutoff;          // Hz.  cutoff at rest; lower is smoother
+        double beta;                // how quickly the cutoff rises with speed
+        double derivative_cutoff;   // Hz.  cutoff used to smooth the speed estimate
+        double rotation_min_cutoff; // Hz
+        double rotation_beta;
+    };
+
+    class PoseFilter
+    {
+    public:
+        PoseFilter();
+
+        void Configure(bool enabled, const PoseFilterParams &params);
+        bool Enabled() const { return m_enabled; }
+        void Reset();
+
+        // t_seconds is the arrival time of the sample on a monotonic clock
+        void FilterPosition(double t_seconds, const double in[3], double out[3]);
+        vr::HmdQuaternion_t FilterRotation(double t_seconds, const vr::HmdQuaternion_t &in);
+
+        static PoseFilterParams DefaultParams();
+
+    private:
+        bool m_enabled;
+        PoseFilterParams m_params;
+
+        bool m_have_position;
+        double m_position_t;
+        double m_position[3];
+        double m_velocity[3];
+
+        bool m_have_rotation;
+        double m_rotation_t;
+        vr::HmdQuaternion_t m_rotation;
+        double m_angular_speed;
+    };
+};
@@ -0,0 +1,143 @@
+//////////////////////////////////////////////////////////////////////////////
+// pose_history.cpp
+//
+// See header for description
+//
+#include <string.h>
+#include "pose_history.h"
+#include "pose_math.h"
+
+namespace soft_knuckles
+{
+
+static const int kMaxReadAttempts = 8;
+
+PoseHistory::PoseHistory()
+    : m_count(0)
+{
+    for (uint32_t i = 0; i < kCapacity; i++)
+    {
+        m_slots[i].sequence.store(0, std::memory_order_relaxed);
+        m_slots[i].timestamp_ns = 0;
+        memset(&m_slots[i].pose, 0, sizeof(m_slots[i].pose));
+    }
+}
+
+void PoseHistory::Push(uint64_t timestamp_ns, const vr::DriverPose_t &pose)
+{
+    uint64_t index = m_count.load(std::memory_order_relaxed);
+    Slot &slot = m_slots[index & (kCapacity - 1)];
+
+    // mark the slot as being written before touching the payload
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.timestamp_ns = timestamp_ns;
+    slot.pose = pose;
+    slot.sequence.store(2 * index + 2, std::memory_order_release);
+
+    m_count.store(index + 1, std::memory_order_release);
+}
+
+bool PoseHistory::ReadSlot(uint64_t index, uint64_t *timestamp_ns, vr::DriverPose_t *pose) const
+{
+    const Slot &slot = m_slots[index & (kCapacity - 1)];
+    uint64_t expected = 2 * index + 2;
+    if (slot.sequence.load(std::memory_order_acquire) != expected)
+        return false;
+
+    *timestamp_ns = slot.timestamp_ns;
+    if (pose)
+    {
+        memcpy(pose, &slot.pose, sizeof(*pose));
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.sequence.load(std::memory_order_relaxed) == expected;
+}
+
+bool PoseHistory::ReadTimestamp(uint64_t index, uint64_t *timestamp_ns) const
+{
+    return ReadSlot(index, timestamp_ns, nullptr);
+}
+
+bool PoseHistory::GetWindow(uint64_t *oldest_ns, uint64_t *newest_ns, uint64_t *count) const
+{
+    for (int attempt = 0; attempt < kMaxReadAttempts; attempt++)
+    {
+        uint64_t total = m_count.load(std::memory_order_acquire);
+        if (total == 0)
+            return false;
+
+        uint64_t first = total > kCapacity ? total - kCapacity : 0;
+        if (ReadTimestamp(first, oldest_ns) && ReadTimestamp(total - 1, newest_ns))
+        {
+            *count = total - first;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PoseHistory::Sample(uint64_t timestamp_ns, vr::DriverPose_t *pose) const
+{
+    for (int attempt = 0; attempt < kMaxReadAttempts; attempt++)
+    {
+        uint64_t total = m_count.load(std::memory_order_acquire);
+        if (total == 0)
+            return false;
+
+        uint64_t lo = total > kCapacity ? total - kCapacity : 0;
+        uint64_t hi = total - 1;
+        uint64_t oldest, newest;
+        if (!ReadTimestamp(lo, &oldest) || !ReadTimestamp(hi, &newest))
+            continue;
+        if (timestamp_ns < oldest || timestamp_ns > newest)
+            return false;
+
+        // find the newest pose at or before the requested time
+        bool torn = false;
+        while (lo < hi)
+        {
+            uint64_t mid = lo + (hi - lo + 1) / 2;
+            uint64_t mid_ns;
+            if (!ReadTimestamp(mid, &mid_ns))
+            {
+                torn = true;
+                break;
+            }
+            if (mid_ns <= timestamp_ns)
+                lo = mid;
+            else
+                hi = mid - 1;
+        }
+        if (torn)
+            continue;
+
+        uint64_t a_ns;
+        vr::DriverPose_t a;
+        if (!ReadSlot(lo, &a_ns, &a))
+            continue;
+        if (a_ns == timestamp_ns || lo == total - 1)
+        {
+            *pose = a;
+            return true;
+        }
+
+        uint64_t b_ns;
+        vr::DriverPose_t b;
+        if (!ReadSlot(lo + 1, &b_ns, &b))
+            continue;
+
+        double t = b_ns > a_ns ? double(timestamp_ns - a_ns) / double(b_ns - a_ns) : 0.0;
+        *pose = a;
+        vec3_lerp(a.vecPosition, b.vecPosition, t, pose->vecPosition);
+        vec3_lerp(a.vecVelocity, b.vecVelocity, t, pose->vecVelocity);
+        vec3_lerp(a.vecAcceleration, b.vecAcceleration, t, pose->vecAcceleration);
+        vec3_lerp(a.vecAngularVelocity, b.vecAngularVelocity, t, pose->vecAngularVelocity);
+        pose->qRotation = quat_slerp(a.qRotation, b.qRotation, t);
+        return true;
+    }
+    return false;
+}
+
+};
@@ -0,0 +1,57 @@
+//////////////////////////////////////////////////////////////////////////////
+// pose_history.h
+//
+// Fixed size ring buffer of the poses a device has submitted to the
+// vrsystem, each tagged with a driver clock timestamp in nanoseconds.
+//
+// There is exactly one writer (the device pose thread) and any number of
+// readers (debug requests).  Each slot carries a sequence number so that
+// readers can detect a slot being overwritten underneath them and retry;
+// nothing blocks and nothing allocates after construction.
+//
+// Sample() answers "where was the controller at time T" by interpolating
+// between the two recorded poses that bracket T.
+//
+#pragma once
+#include <openvr_driver.h>
+#include <atomic>
+#include <stdint.h>
+#include "driver_clock.h"
+
+namespace soft_knuckles
+{
+    // the monotonic clock history entries are stamped with.  virtual when the driver clock is.
+    inline uint64_t pose_history_now_ns()
+    {
+        return clock_now_ns();
+    }
+
+    class PoseHistory
+    {
+    public:
+        static const uint32_t kCapacity = 2048; // must be a power of two
+
+        PoseHistory();
+
+        // writer side.  only ever called from the pose thread.
+        void Push(uint64_t timestamp_ns, const vr::DriverPose_t &pose);
+
+        // reader side.  safe from any thread.
+        bool GetWindow(uint64_t *oldest_ns, uint64_t *newest_ns, uint64_t *count) const;
+        bool Sample(uint64_t timestamp_ns, vr::DriverPose_t *pose) const;
+
+    private:
+        struct Slot
+        {
+            std::atomic<uint64_t> sequence; // 2*index+1 while writing, 2*index+2 once complete
+            uint64_t timestamp_ns;
+            vr::DriverPose_t pose;
+        };
+
+        bool ReadSlot(uint64_t index, uint64_t *timestamp_ns, vr::DriverPose_t *pose) const;
+        bool ReadTimestamp(uint64_t index, uint64_t *timestamp_ns) const;
+
+        Slot m_slots[kCapacity];
+        std::atomic<uint64_t> m_count;   // total number of poses ever pushed
+    };
+};
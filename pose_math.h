@@ -0,0 +1,204 @@
+//////////////////////////////////////////////////////////////////////////////
+// pose_math.h
+//
+// Small inline vector and quaternion helpers for composing and blending
+// DriverPose_t values.  Quaternions use the openvr HmdQuaternion_t layout
+// (w, x, y, z) and are expected to be unit length.
+//
+#pragma once
+#include <openvr_driver.h>
+#include <math.h>
+
+namespace soft_knuckles
+{
+    inline vr::HmdQuaternion_t quat(double w, double x, double y, double z)
+    {
+        vr::HmdQuaternion_t q;
+        q.w = w;
+        q.x = x;
+        q.y = y;
+        q.z = z;
+        return q;
+    }
+
+    inline vr::HmdQuaternion_t quat_normalize(const vr::HmdQuaternion_t &q)
+    {
+        double len = sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+        if (len <= 0.0)
+        {
+            return quat(1, 0, 0, 0);
+        }
+        double inv = 1.0 / len;
+        return quat(q.w * inv, q.x * inv, q.y * inv, q.z * inv);
+    }
+
+    inline double quat_dot(const vr::HmdQuaternion_t &a, const vr::HmdQuaternion_t &b)
+    {
+        return a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    // spherical interpolation along the shortest arc.  falls back to a
+    // normalized lerp when the two rotations are nearly identical.
+    inline vr::HmdQuaternion_t quat_slerp(const vr::HmdQuaternion_t &a, vr::HmdQuaternion_t b, double t)
+    {
+        double cos_theta = quat_dot(a, b);
+        if (cos_theta < 0)
+        {
+            b = quat(-b.w, -b.x, -b.y, -b.z);
+            cos_theta = -cos_theta;
+        }
+
+        double wa, wb;
+        if (cos_theta > 0.9995)
+        {
+            wa = 1.0 - t;
+            wb = t;
+        }
+        else
+        {
+            double theta = acos(cos_theta);
+            double inv_sin = 1.0 / sin(theta);
+            wa = sin((1.0 - t) * theta) * inv_sin;
+            wb = sin(t * theta) * inv_sin;
+        }
+        return quat_normalize(quat(wa * a.w + wb * b.w,
+                                   wa * a.x + wb * b.x,
+                                   wa * a.y + wb * b.y,
+                                   wa * a.z + wb * b.z));
+    }
+
+    inline void vec3_lerp(const double *a, const double *b, double t, double *out)
+    {
+        out[0] = a[0] + (b[0] - a[0]) * t;
+        out[1] = a[1] + (b[1] - a[1]) * t;
+        out[2] = a[2] + (b[2] - a[2]) * t;
+    }
+
+    inline vr::HmdQuaternion_t quat_multiply(const vr::HmdQuaternion_t &a, const vr::HmdQuaternion_t &b)
+    {
+        return quat(a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+                    a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+                    a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+                    a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w);
+    }
+
+    inline vr::HmdQuaternion_t quat_conjugate(const vr::HmdQuaternion_t &q)
+    {
+        return quat(q.w, -q.x, -q.y, -q.z);
+    }
+
+    // out = q * v * conjugate(q).  out may alias v.
+    inline void quat_rotate(const vr::HmdQuaternion_t &q, const double *v, double *out)
+    {
+        // t = 2 * cross(q.xyz, v)
+        double tx = 2.0 * (q.y * v[2] - q.z * v[1]);
+        double ty = 2.0 * (q.z * v[0] - q.x * v[2]);
+        double tz = 2.0 * (q.x * v[1] - q.y * v[0]);
+        double x = v[0] + q.w * tx + (q.y * tz - q.z * ty);
+        double y = v[1] + q.w * ty + (q.z * tx - q.x * tz);
+        double z = v[2] + q.w * tz + (q.x * ty - q.y * tx);
+        out[0] = x;
+        out[1] = y;
+        out[2] = z;
+    }
+
+    // yaw about +y, pitch about +x, roll about +z, applied roll first.
+    inline vr::HmdQuaternion_t quat_from_euler_degrees(double yaw, double pitch, double roll)
+    {
+        const double half_rad = 3.14159265358979323846 / 360.0;
+        double cy = cos(yaw * half_rad), sy = sin(yaw * half_rad);
+        double cp = cos(pitch * half_rad), sp = sin(pitch * half_rad);
+        double cr = cos(roll * half_rad), sr = sin(roll * half_rad);
+        vr::HmdQuaternion_t qy = quat(cy, 0, sy, 0);
+        vr::HmdQuaternion_t qp = quat(cp, sp, 0, 0);
+        vr::HmdQuaternion_t qr = quat(cr, 0, 0, sr);
+        return quat_multiply(qy, quat_multiply(qp, qr));
+    }
+
+    inline vr::HmdQuaternion_t quat_from_matrix34(const vr::HmdMatrix34_t &m)
+    {
+        double trace = m.m[0][0] + m.m[1][1] + m.m[2][2];
+        vr::HmdQuaternion_t q;
+        if (trace > 0)
+        {
+            double s = 0.5 / sqrt(trace + 1.0);
+            q = quat(0.25 / s,
+                     (m.m[2][1] - m.m[1][2]) * s,
+                     (m.m[0][2] - m.m[2][0]) * s,
+                     (m.m[1][0] - m.m[0][1]) * s);
+        }
+        else if (m.m[0][0] > m.m[1][1] && m.m[0][0] > m.m[2][2])
+        {
+            double s = 2.0 * sqrt(1.0 + m.m[0][0] - m.m[1][1] - m.m[2][2]);
+            q = quat((m.m[2][1] - m.m[1][2]) / s,
+                     0.25 * s,
+                     (m.m[0][1] + m.m[1][0]) / s,
+                     (m.m[0][2] + m.m[2][0]) / s);
+        }
+        else if (m.m[1][1] > m.m[2][2])
+        {
+            double s = 2.0 * sqrt(1.0 + m.m[1][1] - m.m[0][0] - m.m[2][2]);
+            q = quat((m.m[0][2] - m.m[2][0]) / s,
+                     (m.m[0][1] + m.m[1][0]) / s,
+                     0.25 * s,
+                     (m.m[1][2] + m.m[2][1]) / s);
+        }
+        else
+        {
+            double s = 2.0 * sqrt(1.0 + m.m[2][2] - m.m[0][0] - m.m[1][1]);
+            q = quat((m.m[1][0] - m.m[0][1]) / s,
+                     (m.m[0][2] + m.m[2][0]) / s,
+                     (m.m[1][2] + m.m[2][1]) / s,
+                     0.25 * s);
+        }
+        return quat_normalize(q);
+    }
+
+    // a rotation followed by a translation: p' = rotation * p + translation
+    struct RigidTransform
+    {
+        vr::HmdQuaternion_t rotation;
+        double translation[3];
+    };
+
+    inline RigidTransform rigid_identity()
+    {
+        RigidTransform r;
+        r.rotation = quat(1, 0, 0, 0);
+        r.translation[0] = r.translation[1] = r.translation[2] = 0;
+        return r;
+    }
+
+    inline RigidTransform rigid_from_matrix34(const vr::HmdMatrix34_t &m)
+    {
+        RigidTransform r;
+        r.rotation = quat_from_matrix34(m);
+        r.translation[0] = m.m[0][3];
+        r.translation[1] = m.m[1][3];
+        r.translation[2] = m.m[2][3];
+        return r;
+    }
+
+    // returns a * b, i.e. b is applied first and then a
+    inline RigidTransform rigid_compose(const RigidTransform &a, const RigidTransform &b)
+    {
+        RigidTransform r;
+        r.rotation = quat_multiply(a.rotation, b.rotation);
+        quat_rotate(a.rotation, b.translation, r.translation);
+        r.translation[0] += a.translation[0];
+        r.translation[1] += a.translation[1];
+        r.translation[2] += a.translation[2];
+        return r;
+    }
+
+    inline RigidTransform rigid_inverse(const RigidTransform &a)
+    {
+        RigidTransform r;
+        r.rotation = quat_conjugate(a.rotation);
+        quat_rotate(r.rotation, a.translation, r.translation);
+        r.translation[0] = -r.translation[0];
+        r.translation[1] = -r.translation[1];
+        r.translation[2] = -r.translation[2];
+        return r;
+    }
+};
@@ -0,0 +1,443 @@
+//////////////////////////////////////////////////////////////////////////////
+// session_log.cpp
+//
+// See header for description
+//
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <math.h>
+#include <string.h>
+#include "session_log.h"
+
+#if defined(_WIN32)
+#pragma warning(disable : 4996)
+#endif
+
+namespace soft_knuckles
+{
+
+static const char kSessionMagic[4] = { 'S', 'K', 'S', '2' };
+static const size_t kSessionFileBufferSize = 64 * 1024;
+static const double kPositionScale = 10000.0;      // 0.1mm
+static const float kValueScale = 32767.0f;
+
+static size_t put_varint(uint8_t *out, uint64_t value)
+{
+    size_t n = 0;
+    while (value >= 0x80)
+    {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+static bool get_varint(const uint8_t *data, size_t size, size_t *offset, uint64_t *value)
+{
+    uint64_t result = 0;
+    for (uint32_t shift = 0; shift < 64 && *offset < size; shift += 7)
+    {
+        uint8_t byte = data[(*offset)++];
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint64_t zigzag(int64_t value)
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value)
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static size_t put_unit(uint8_t *out, float value)
+{
+    if (value > 1.0f)
+        value = 1.0f;
+    if (value < -1.0f)
+        value = -1.0f;
+    int16_t q = (int16_t)lrintf(value * kValueScale);
+    out[0] = (uint8_t)(q & 0xff);
+    out[1] = (uint8_t)((uint16_t)q >> 8);
+    return 2;
+}
+
+static bool get_unit(const uint8_t *data, size_t size, size_t *offset, float *value)
+{
+    if (size - *offset < 2)
+        return false;
+    int16_t q = (int16_t)(data[*offset] | (data[*offset + 1] << 8));
+    *offset += 2;
+    *value = q / kValueScale;
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// SessionRecorder
+//
+SessionRecorder::SessionRecorder()
+    : m_recording(false),
+      m_file(nullptr),
+      m_last_ns(0),
+      m_records(0),
+      m_bytes(0)
+{
+}
+
+SessionRecorder::~SessionRecorder()
+{
+    Stop(nullptr, nullptr);
+}
+
+bool SessionRecorder::Start(const char *path, uint32_t num_components, uint64_t now_ns)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_file)
+        return false;
+    m_file = fopen(path, "wb");
+    if (!m_file)
+        return false;
+    setvbuf(m_file, nullptr, _IOFBF, kSessionFileBufferSize);
+
+    uint8_t header[16];
+    memcpy(header, kSessionMagic, sizeof(kSessionMagic));
+    size_t n = sizeof(kSessionMagic) + put_varint(header + sizeof(kSessionMagic), num_components);
+    fwrite(header, 1, n, m_file);
+    m_bytes = n;
+    m_records = 0;
+    if (m_skeleton_codec)
+    {
+        m_skeleton_codec->Reset();      // the first skeleton is a keyframe
+    }
+    m_last_ns = now_ns;
+    m_recording = true;
+    return true;
+}
+
+bool SessionRecorder::Stop(uint64_t *records, uint64_t *bytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file)
+        return false;
+    m_recording = false;
+    fclose(m_file);
+    m_file = nullptr;
+    if (records)
+        *records = m_records;
+    if (bytes)
+        *bytes = m_bytes;
+    return true;
+}
+
+void SessionRecorder::SetSkeletonReference(const vr::VRBoneTransform_t *reference, uint32_t bone_count)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_skeleton_codec.reset(new SkeletonCodec(reference, bone_count));
+}
+
+void SessionRecorder::Write(uint64_t now_ns, SessionRecordKind kind, const uint8_t *payload, size_t payload_size)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    WriteLocked(now_ns, kind, payload, payload_size);
+}
+
+void SessionRecorder::WriteLocked(uint64_t now_ns, SessionRecordKind kind, const uint8_t *payload, size_t payload_size)
+{
+    uint8_t prefix[1 + 10];
+    if (!m_file)
+        return;
+    // commands from different threads can be stamped slightly out of order
+    uint64_t delta_us = now_ns > m_last_ns ? (now_ns - m_last_ns) / 1000 : 0;
+    m_last_ns += delta_us * 1000;       // keep the rounding error from accumulating
+    prefix[0] = (uint8_t)kind;
+    size_t n = 1 + put_varint(prefix + 1, delta_us);
+    fwrite(prefix, 1, n, m_file);
+    fwrite(payload, 1, payload_size, m_file);
+    m_bytes += n + payload_size;
+    m_records++;
+}
+
+void SessionRecorder::Component(uint64_t now_ns, uint32_t component_index, float value)
+{
+    if (!Recording())
+        return;
+    uint8_t payload[10 + 2];
+    size_t n = put_varint(payload, component_index);
+    n += put_unit(payload + n, value);
+    Write(now_ns, kSessionComponent, payload, n);
+}
+
+void SessionRecorder::Position(uint64_t now_ns, const double position[3])
+{
+    if (!Recording())
+        return;
+    uint8_t payload[3 * 10];
+    size_t n = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        n += put_varint(payload + n, zigzag((int64_t)llround(position[i] * kPositionScale)));
+    }
+    Write(now_ns, kSessionPosition, payload, n);
+}
+
+void SessionRecorder::Rotation(uint64_t now_ns, const vr::HmdQuaternion_t &rotation)
+{
+    if (!Recording())
+        return;
+    uint8_t payload[4 * 2];
+    size_t n = put_unit(payload, (float)rotation.w);
+    n += put_unit(payload + n, (float)rotation.x);
+    n += put_unit(payload + n, (float)rotation.y);
+    n += put_unit(payload + n, (float)rotation.z);
+    Write(now_ns, kSessionRotation, payload, n);
+}
+
+void SessionRecorder::Skeleton(uint64_t now_ns, uint32_t component_index, const vr::VRBoneTransform_t *bones)
+{
+    if (!Recording())
+        return;
+    uint8_t payload[10 + SkeletonCodec::kMaxEncodedSize];
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_skeleton_codec)
+        return;
+    // encode under the lock: the codec's previous frame must follow file order
+    size_t n = put_varint(payload, component_index);
+    n += m_skeleton_codec->Encode(bones, payload + n);
+    WriteLocked(now_ns, kSessionSkeleton, payload, n);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// SessionReplay
+//
+SessionReplay::SessionReplay()
+    : m_active(false),
+      m_records_played(0),
+      m_data(nullptr),
+      m_size(0),
+      m_offset(0),
+      m_num_components(0),
+      m_next_kind(0),
+      m_next_due_ns(0),
+      m_mapping(nullptr),
+      m_file(-1)
+{
+}
+
+SessionReplay::~SessionReplay()
+{
+    Stop();
+}
+
+void SessionReplay::SetSkeletonReference(const vr::VRBoneTransform_t *reference, uint32_t bone_count)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_skeleton_codec.reset(new SkeletonCodec(reference, bone_count));
+}
+
+void SessionReplay::Unmap()
+{
+#if defined(_WIN32)
+    if (m_data)
+        UnmapViewOfFile(m_data);
+    if (m_mapping)
+        CloseHandle((HANDLE)m_mapping);
+    if (m_file != -1)
+        CloseHandle((HANDLE)m_file);
+#else
+    if (m_data)
+        munmap((void *)m_data, m_size);
+    if (m_file != -1)
+        close((int)m_file);
+#endif
+    m_data = nullptr;
+    m_mapping = nullptr;
+    m_file = -1;
+    m_size = 0;
+    m_offset = 0;
+}
+
+bool SessionReplay::Start(const char *path, uint32_t num_components, uint64_t now_ns)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_active = false;
+    Unmap();
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    m_file = (intptr_t)file;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        Unmap();
+        return false;
+    }
+    m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping)
+        m_data = (const uint8_t *)MapViewOfFile((HANDLE)m_mapping, FILE_MAP_READ, 0, 0, 0);
+    m_size = (size_t)size.QuadPart;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    m_file = fd;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        Unmap();
+        return false;
+    }
+    m_size = (size_t)st.st_size;
+    void *data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED)
+    {
+        m_data = (const uint8_t *)data;
+        madvise(data, m_size, MADV_SEQUENTIAL);
+    }
+#endif
+    m_num_components = num_components;
+    if (!m_data || !ReadHeader(num_components) || !PrepareNext(now_ns))
+    {
+        Unmap();
+        return false;
+    }
+    if (m_skeleton_codec)
+    {
+        m_skeleton_codec->Reset();
+    }
+    m_records_played = 0;
+    m_active = true;
+    return true;
+}
+
+void SessionReplay::Stop()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_active = false;
+    Unmap();
+}
+
+bool SessionReplay::ReadHeader(uint32_t num_components)
+{
+    uint64_t recorded_components;
+    m_offset = sizeof(kSessionMagic);
+    return m_size > sizeof(kSessionMagic) &&
+        memcmp(m_data, kSessionMagic, sizeof(kSessionMagic)) == 0 &&
+        get_varint(m_data, m_size, &m_offset, &recorded_components) &&
+        recorded_components == num_components;
+}
+
+// reads the kind and delta of the next record, leaving m_offset at its payload
+bool SessionReplay::PrepareNext(uint64_t previous_ns)
+{
+    uint64_t delta_us;
+    if (m_offset >= m_size)
+        return false;
+    m_next_kind = m_data[m_offset++];
+    if (!get_varint(m_data, m_size, &m_offset, &delta_us))
+        return false;
+    m_next_due_ns = previous_ns + delta_us * 1000;
+    return true;
+}
+
+bool SessionReplay::ApplyNext(const SessionReplayOutput &output)
+{
+    switch (m_next_kind)
+    {
+        case kSessionComponent:
+        {
+            uint64_t index;
+            float value;
+            if (!get_varint(m_data, m_size, &m_offset, &index) || !get_unit(m_data, m_size, &m_offset, &value) ||
+                index >= m_num_components)
+                return false;
+            output.component(output.context, (uint32_t)index, value);
+            return true;
+        }
+        case kSessionPosition:
+        {
+            double position[3];
+            for (int i = 0; i < 3; i++)
+            {
+                uint64_t q;
+                if (!get_varint(m_data, m_size, &m_offset, &q))
+                    return false;
+                position[i] = unzigzag(q) / kPositionScale;
+            }
+            output.position(output.context, position);
+            return true;
+        }
+        case kSessionRotation:
+        {
+            float wxyz[4];
+            for (int i = 0; i < 4; i++)
+            {
+                if (!get_unit(m_data, m_size, &m_offset, &wxyz[i]))
+                    return false;
+            }
+            vr::HmdQuaternion_t rotation;
+            rotation.w = wxyz[0];
+            rotation.x = wxyz[1];
+            rotation.y = wxyz[2];
+            rotation.z = wxyz[3];
+            output.rotation(output.context, rotation);
+            return true;
+        }
+        case kSessionSkeleton:
+        {
+            uint64_t index;
+            if (!m_skeleton_codec || !get_varint(m_data, m_size, &m_offset, &index) || index >= m_num_components ||
+                !m_skeleton_codec->Decode(m_data, m_size, &m_offset, m_skeleton))
+                return false;
+            output.skeleton(output.context, (uint32_t)index, m_skeleton, m_skeleton_codec->BoneCount());
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+uint32_t SessionReplay::Drain(uint64_t now_ns, const SessionReplayOutput &output)
+{
+    if (!Active())
+        return 0;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint32_t applied = 0;
+    while (m_active && m_next_due_ns <= now_ns)
+    {
+        if (!ApplyNext(output))
+        {
+            // truncated or malformed
+            m_active = false;
+            Unmap();
+            break;
+        }
+        applied++;
+        if (!PrepareNext(m_next_due_ns))
+        {
+            m_active = false;
+            Unmap();
+        }
+    }
+    m_records_played.fetch_add(applied, std::memory_order_relaxed);
+    return applied;
+}
+
+};
@@ -0,0 +1,143 @@
+//////////////////////////////////////////////////////////////////////////////
+// session_log.h
+//
+// Binary record and replay of what a device is told to do: component value
+// updates (direct, queued, generated) and position / rotation commands.
+//
+// File layout, little endian:
+//   "SKS2"  varint component count
+//   then records, each:
+//     kind byte
+//     varint microseconds since the previous record (the first: since Start)
+//     kSessionComponent: varint component index, int16 value * 32767
+//     kSessionPosition:  3 zigzag varints, metres * 10000 (0.1mm)
+//     kSessionRotation:  4 int16 w x y z * 32767
+//     kSessionSkeleton:  varint component index, one skeleton codec frame
+// A typical record is 4-8 bytes.  Values are clamped to [-1, 1], which
+// covers every boolean and scalar component the device has.
+//
+// Skeletons are recorded as the bone transforms actually submitted, through
+// a SkeletonCodec (see skeleton_codec.h) against a reference pose set with
+// SetSkeletonReference, rather than as the component value that picked
+// them.  Both motion ranges get the same transforms, so one frame covers
+// both.
+//
+// SessionRecorder writes through a fixed size stdio buffer, so an hour of
+// recording costs no more memory than a second of it.  When nothing is
+// being recorded each hook is one relaxed atomic load.
+//
+// SessionReplay memory-maps the file and the pose thread walks it in
+// place, applying every record that has come due on each tick, at the
+// original spacing relative to when the replay started.  Nothing is parsed
+// ahead or copied, so the footprint is fixed regardless of length.  Replay
+// applies records through the same setters that recorded them, so a
+// replayed session can itself be recorded.
+//
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <mutex>
+#include <openvr_driver.h>
+#include <memory>
+#include "input_generator.h"
+#include "skeleton_codec.h"
+
+namespace soft_knuckles
+{
+    enum SessionRecordKind
+    {
+        kSessionComponent = 0,
+        kSessionPosition = 1,
+        kSessionRotation = 2,
+        kSessionSkeleton = 3,
+    };
+
+    class SessionRecorder
+    {
+    public:
+        SessionRecorder();
+        ~SessionRecorder();
+
+        // truncates path.  fails if already recording or the file can't be opened.
+        bool Start(const char *path, uint32_t num_components, uint64_t now_ns);
+        // returns false if not recording
+        bool Stop(uint64_t *records, uint64_t *bytes);
+
+        bool Recording() const { return m_recording.load(std::memory_order_relaxed); }
+
+        // before Start.  reference must outlive the recorder.
+        void SetSkeletonReference(const vr::VRBoneTransform_t *reference, uint32_t bone_count);
+
+        // safe from any thread
+        void Component(uint64_t now_ns, uint32_t component_index, float value);
+        void Position(uint64_t now_ns, const double position[3]);
+        void Rotation(uint64_t now_ns, const vr::HmdQuaternion_t &rotation);
+        // bones holds the reference's bone count.  ignored without a reference.
+        void Skeleton(uint64_t now_ns, uint32_t component_index, const vr::VRBoneTransform_t *bones);
+
+    private:
+        void Write(uint64_t now_ns, SessionRecordKind kind, const uint8_t *payload, size_t payload_size);
+        void WriteLocked(uint64_t now_ns, SessionRecordKind kind, const uint8_t *payload, size_t payload_size);
+
+        std::atomic<bool> m_recording;
+        std::mutex m_mutex;             // everything below
+        FILE *m_file;
+        uint64_t m_last_ns;
+        uint64_t m_records;
+        uint64_t m_bytes;
+        std::unique_ptr<SkeletonCodec> m_skeleton_codec;
+    };
+
+    struct SessionReplayOutput
+    {
+        void *context;
+        GeneratorOutputFn component;
+        void (*position)(void *context, const double position[3]);
+        void (*rotation)(void *context, const vr::HmdQuaternion_t &rotation);
+        void (*skeleton)(void *context, uint32_t component_index, const vr::VRBoneTransform_t *bones, uint32_t bone_count);
+    };
+
+    class SessionReplay
+    {
+    public:
+        SessionReplay();
+        ~SessionReplay();
+
+        // before Start: the same reference the log was recorded with.  without
+        // one, skeleton records end the replay.
+        void SetSkeletonReference(const vr::VRBoneTransform_t *reference, uint32_t bone_count);
+
+        // fails if the file can't be mapped, isn't a session log or was recorded
+        // from a device with a different number of components
+        bool Start(const char *path, uint32_t num_components, uint64_t now_ns);
+        void Stop();
+
+        bool Active() const { return m_active.load(std::memory_order_relaxed); }
+        uint64_t RecordsPlayed() const { return m_records_played.load(std::memory_order_relaxed); }
+
+        // called from the pose thread: applies every record due at or before now_ns.
+        // stops by itself at the end of the file or on a malformed record.
+        uint32_t Drain(uint64_t now_ns, const SessionReplayOutput &output);
+
+    private:
+        bool ReadHeader(uint32_t num_components);
+        bool PrepareNext(uint64_t previous_ns);
+        bool ApplyNext(const SessionReplayOutput &output);
+        void Unmap();
+
+        std::atomic<bool> m_active;
+        std::atomic<uint64_t> m_records_played;
+        std::mutex m_mutex;             // everything below
+        const uint8_t *m_data;
+        size_t m_size;
+        size_t m_offset;                // the payload of the next record
+        uint32_t m_num_components;
+        uint8_t m_next_kind;
+        uint64_t m_next_due_ns;
+        std::unique_ptr<SkeletonCodec> m_skeleton_codec;
+        vr::VRBoneTransform_t m_skeleton[SkeletonCodec::kMaxBones];
+        void *m_mapping;                // platform handles
+        intptr_t m_file;
+    };
+};
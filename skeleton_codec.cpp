@@ -0,0 +1,469 @@
+//////////////////////////////////////////////////////////////////////////////
+// skeleton_codec.cpp
+//
+// See header for description
+//
+#include <math.h>
+#include <string.h>
+#include "skeleton_codec.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SK_SKELETON_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace soft_knuckles
+{
+
+static const float kPositionScale = 10000.0f;                   // 0.1mm
+static const float kPositionLimit = 8388607.0f;                 // 24 bit offsets, +-838m
+static const uint32_t kMaxPositionBits = 24;
+static const uint32_t kRotationBits = 12;
+static const float kQuaternionScale = 2047.0f * 1.41421356f;    // +-1/sqrt(2) -> +-2047
+static const float kQuaternionLimit = 2047.0f;
+
+enum
+{
+    kKeyframe = 0,
+    kDeltaFrame = 1,
+};
+
+// how a changed bone's rotation is written in a delta frame
+enum
+{
+    kRotationSame = 0,          // as predicted
+    kRotationDelta = 1,         // difference from the prediction
+    kRotationAbsolute = 2,      // largest component changed: index and smallest three
+};
+
+// fields are written least significant bit first and the frame is padded to
+// a whole byte.  widths are at most 32 bits.
+class BitWriter
+{
+public:
+    explicit BitWriter(uint8_t *out) : m_out(out), m_size(0), m_bits(0), m_count(0) {}
+
+    void Put(uint32_t value, uint32_t width)
+    {
+        m_bits |= ((uint64_t)value & (((uint64_t)1 << width) - 1)) << m_count;
+        m_count += width;
+        while (m_count >= 8)
+        {
+            m_out[m_size++] = (uint8_t)m_bits;
+            m_bits >>= 8;
+            m_count -= 8;
+        }
+    }
+
+    size_t Finish()
+    {
+        if (m_count)
+            m_out[m_size++] = (uint8_t)m_bits;
+        m_bits = 0;
+        m_count = 0;
+        return m_size;
+    }
+
+private:
+    uint8_t *m_out;
+    size_t m_size;
+    uint64_t m_bits;
+    uint32_t m_count;
+};
+
+class BitReader
+{
+public:
+    BitReader(const uint8_t *data, size_t size, size_t offset)
+        : m_data(data), m_size(size), m_offset(offset), m_bits(0), m_count(0), m_ok(true) {}
+
+    uint32_t Get(uint32_t width)
+    {
+        while (m_count < width)
+        {
+            if (m_offset >= m_size)
+            {
+                m_ok = false;
+                return 0;
+            }
+            m_bits |= (uint64_t)m_data[m_offset++] << m_count;
+            m_count += 8;
+        }
+        uint32_t value = (uint32_t)(m_bits & (((uint64_t)1 << width) - 1));
+        m_bits >>= width;
+        m_count -= width;
+        return value;
+    }
+
+    int32_t GetSigned(uint32_t width)
+    {
+        if (width == 0)
+            return 0;
+        uint32_t sign = 1u << (width - 1);
+        return (int32_t)((Get(width) ^ sign) - sign);
+    }
+
+    bool Ok() const { return m_ok; }
+    size_t Offset() const { return m_offset; }
+
+private:
+    const uint8_t *m_data;
+    size_t m_size;
+    size_t m_offset;
+    uint64_t m_bits;
+    uint32_t m_count;
+    bool m_ok;
+};
+
+// the two's complement width that holds value.  0 for 0.
+static uint32_t signed_bits(int32_t value)
+{
+    uint32_t magnitude = (uint32_t)(value ^ (value >> 31));
+    uint32_t bits = value ? 1 : 0;
+    while (magnitude)
+    {
+        bits++;
+        magnitude >>= 1;
+    }
+    return bits;
+}
+
+SkeletonCodec::SkeletonCodec(const vr::VRBoneTransform_t *reference, uint32_t bone_count)
+    : m_reference(reference),
+      m_bone_count(bone_count < kMaxBones ? bone_count : kMaxBones)
+{
+    Reset();
+}
+
+void SkeletonCodec::Reset()
+{
+    m_frames_since_keyframe = 0;
+    m_have_previous = false;
+    m_have_before_previous = false;
+    memset(m_previous, 0, sizeof(m_previous));
+    memset(m_before_previous, 0, sizeof(m_before_previous));
+}
+
+void SkeletonCodec::Quantize(const vr::VRBoneTransform_t &bone, const vr::VRBoneTransform_t &reference, QuantizedBone *q)
+{
+    const float *o = &bone.orientation.w;
+    uint32_t largest = 0;
+    for (uint32_t i = 1; i < 4; i++)
+    {
+        if (fabsf(o[i]) > fabsf(o[largest]))
+            largest = i;
+    }
+    // q and -q are the same rotation: flip so the dropped component is positive
+    float scale = o[largest] < 0 ? -kQuaternionScale : kQuaternionScale;
+    int32_t scaled[4];
+
+#if defined(SK_SKELETON_SSE2)
+    __m128 position_limit = _mm_set1_ps(kPositionLimit);
+    __m128 offset = _mm_sub_ps(_mm_loadu_ps(bone.position.v), _mm_loadu_ps(reference.position.v));
+    offset = _mm_mul_ps(offset, _mm_set1_ps(kPositionScale));
+    offset = _mm_max_ps(_mm_min_ps(offset, position_limit), _mm_sub_ps(_mm_setzero_ps(), position_limit));
+    _mm_storeu_si128((__m128i *)q->v, _mm_cvtps_epi32(offset));
+
+    __m128 limit = _mm_set1_ps(kQuaternionLimit);
+    __m128 orientation = _mm_mul_ps(_mm_loadu_ps(o), _mm_set1_ps(scale));
+    orientation = _mm_max_ps(_mm_min_ps(orientation, limit), _mm_sub_ps(_mm_setzero_ps(), limit));
+    _mm_storeu_si128((__m128i *)scaled, _mm_cvtps_epi32(orientation));
+#else
+    for (int i = 0; i < 3; i++)
+    {
+        float value = (bone.position.v[i] - reference.position.v[i]) * kPositionScale;
+        value = value > kPositionLimit ? kPositionLimit : (value < -kPositionLimit ? -kPositionLimit : value);
+        q->v[i] = (int32_t)lrintf(value);
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        float value = o[i] * scale;
+        value = value > kQuaternionLimit ? kQuaternionLimit : (value < -kQuaternionLimit ? -kQuaternionLimit : value);
+        scaled[i] = (int32_t)lrintf(value);
+    }
+#endif
+    q->v[3] = (int32_t)largest;
+    for (uint32_t i = 0, j = 4; i < 4; i++)
+    {
+        if (i != largest)
+            q->v[j++] = scaled[i];
+    }
+    q->v[7] = 0;
+}
+
+void SkeletonCodec::Dequantize(const QuantizedBone &q, const vr::VRBoneTransform_t &reference, vr::VRBoneTransform_t *bone)
+{
+    float small[3];
+#if defined(SK_SKELETON_SSE2)
+    __m128 offset = _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)q.v)), _mm_set1_ps(1.0f / kPositionScale));
+    _mm_storeu_ps(bone->position.v, _mm_add_ps(offset, _mm_loadu_ps(reference.position.v)));
+    float unpacked[4];
+    _mm_storeu_ps(unpacked, _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(q.v + 4))),
+        _mm_set1_ps(1.0f / kQuaternionScale)));
+    memcpy(small, unpacked, sizeof(small));
+#else
+    for (int i = 0; i < 3; i++)
+    {
+        bone->position.v[i] = reference.position.v[i] + q.v[i] / kPositionScale;
+        small[i] = q.v[4 + i] / kQuaternionScale;
+    }
+#endif
+    // the slot holding the largest index isn't a position
+    bone->position.v[3] = reference.position.v[3];
+
+    float sum = small[0] * small[0] + small[1] * small[1] + small[2] * small[2];
+    float *o = &bone->orientation.w;
+    uint32_t largest = (uint32_t)q.v[3] & 3;
+    for (uint32_t i = 0, j = 0; i < 4; i++)
+    {
+        o[i] = i == largest ? sqrtf(sum < 1.0f ? 1.0f - sum : 0.0f) : small[j++];
+    }
+}
+
+bool SkeletonCodec::Same(const QuantizedBone &a, const QuantizedBone &b)
+{
+#if defined(SK_SKELETON_SSE2)
+    __m128i lo = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)a.v), _mm_loadu_si128((const __m128i *)b.v));
+    __m128i hi = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(a.v + 4)), _mm_loadu_si128((const __m128i *)(b.v + 4)));
+    return _mm_movemask_epi8(_mm_and_si128(lo, hi)) == 0xffff;
+#else
+    return memcmp(a.v, b.v, sizeof(a.v)) == 0;
+#endif
+}
+
+// linear extrapolation from the last two frames.  the rotation is only
+// extrapolated while its largest component stays the same, since the
+// smallest three of different largest components don't line up.
+void SkeletonCodec::Predict(uint32_t bone, QuantizedBone *predicted) const
+{
+    const QuantizedBone &previous = m_previous[bone];
+    *predicted = previous;
+    if (!m_have_before_previous)
+        return;
+    const QuantizedBone &before = m_before_previous[bone];
+    for (int k = 0; k < 3; k++)
+    {
+        predicted->v[k] = 2 * previous.v[k] - before.v[k];
+    }
+    if (previous.v[3] == before.v[3])
+    {
+        for (int k = 4; k < 7; k++)
+        {
+            predicted->v[k] = 2 * previous.v[k] - before.v[k];
+        }
+    }
+}
+
+void SkeletonCodec::Advance(const QuantizedBone *current)
+{
+    memcpy(m_before_previous, m_previous, m_bone_count * sizeof(QuantizedBone));
+    memcpy(m_previous, current, m_bone_count * sizeof(QuantizedBone));
+    m_have_previous = true;
+}
+
+size_t SkeletonCodec::Encode(const vr::VRBoneTransform_t *bones, uint8_t *out)
+{
+    QuantizedBone current[kMaxBones];
+    for (uint32_t i = 0; i < m_bone_count; i++)
+    {
+        Quantize(bones[i], m_reference[i], &current[i]);
+    }
+
+    BitWriter writer(out);
+    bool keyframe = !m_have_previous || m_frames_since_keyframe >= kKeyframeInterval;
+    if (keyframe)
+    {
+        uint32_t position_bits = 0;
+        for (uint32_t i = 0; i < m_bone_count; i++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t bits = signed_bits(current[i].v[k]);
+                position_bits = bits > position_bits ? bits : position_bits;
+            }
+        }
+        writer.Put(kKeyframe, 8);
+        writer.Put(position_bits, 5);
+        for (uint32_t i = 0; i < m_bone_count; i++)
+        {
+            const QuantizedBone &q = current[i];
+            bool moved = (q.v[0] | q.v[1] | q.v[2]) != 0;
+            writer.Put((uint32_t)q.v[3], 2);
+            writer.Put(moved, 1);
+            for (int k = 0; moved && k < 3; k++)
+            {
+                writer.Put((uint32_t)q.v[k], position_bits);
+            }
+            for (int k = 4; k < 7; k++)
+            {
+                writer.Put((uint32_t)q.v[k], kRotationBits);
+            }
+        }
+        m_frames_since_keyframe = 0;
+        m_have_before_previous = false;
+    }
+    else
+    {
+        QuantizedBone residual[kMaxBones];
+        uint8_t rotation[kMaxBones];
+        uint32_t changed = 0;
+        uint32_t position_bits = 0;
+        uint32_t rotation_bits = 0;
+        for (uint32_t i = 0; i < m_bone_count; i++)
+        {
+            QuantizedBone predicted;
+            Predict(i, &predicted);
+            if (Same(current[i], predicted))
+                continue;
+            changed |= 1u << i;
+            for (int k = 0; k < 7; k++)
+            {
+                residual[i].v[k] = current[i].v[k] - predicted.v[k];
+            }
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t bits = signed_bits(residual[i].v[k]);
+                position_bits = bits > position_bits ? bits : position_bits;
+            }
+            if (residual[i].v[3] != 0)
+            {
+                rotation[i] = kRotationAbsolute;
+            }
+            else if ((residual[i].v[4] | residual[i].v[5] | residual[i].v[6]) == 0)
+            {
+                rotation[i] = kRotationSame;
+            }
+            else
+            {
+                rotation[i] = kRotationDelta;
+                for (int k = 4; k < 7; k++)
+                {
+                    uint32_t bits = signed_bits(residual[i].v[k]);
+                    rotation_bits = bits > rotation_bits ? bits : rotation_bits;
+                }
+            }
+        }
+        writer.Put(kDeltaFrame, 8);
+        writer.Put(changed, m_bone_count);
+        writer.Put(position_bits, 5);
+        writer.Put(rotation_bits, 4);
+        for (uint32_t i = 0; i < m_bone_count; i++)
+        {
+            if ((changed & (1u << i)) == 0)
+                continue;
+            const QuantizedBone &r = residual[i];
+            bool moved = (r.v[0] | r.v[1] | r.v[2]) != 0;
+            writer.Put(moved, 1);
+            writer.Put(rotation[i], 2);
+            for (int k = 0; moved && k < 3; k++)
+            {
+                writer.Put((uint32_t)r.v[k], position_bits);
+            }
+            if (rotation[i] == kRotationDelta)
+            {
+                for (int k = 4; k < 7; k++)
+                {
+                    writer.Put((uint32_t)r.v[k], rotation_bits);
+                }
+            }
+            else if (rotation[i] == kRotationAbsolute)
+            {
+                writer.Put((uint32_t)current[i].v[3], 2);
+                for (int k = 4; k < 7; k++)
+                {
+                    writer.Put((uint32_t)current[i].v[k], kRotationBits);
+                }
+            }
+        }
+        m_frames_since_keyframe++;
+        m_have_before_previous = true;
+    }
+    Advance(current);
+    return writer.Finish();
+}
+
+bool SkeletonCodec::Decode(const uint8_t *data, size_t size, size_t *offset, vr::VRBoneTransform_t *bones)
+{
+    if (*offset >= size)
+        return false;
+    BitReader reader(data, size, *offset);
+    uint32_t kind = reader.Get(8);
+    QuantizedBone current[kMaxBones];
+    if (kind == kKeyframe)
+    {
+        uint32_t position_bits = reader.Get(5);
+        if (position_bits > kMaxPositionBits)
+            return false;
+        for (uint32_t i = 0; i < m_bone_count; i++)
+        {
+            QuantizedBone &q = current[i];
+            q.v[3] = (int32_t)reader.Get(2);
+            bool moved = reader.Get(1) != 0;
+            for (int k = 0; k < 3; k++)
+            {
+                q.v[k] = moved ? reader.GetSigned(position_bits) : 0;
+            }
+            for (int k = 4; k < 7; k++)
+            {
+                q.v[k] = reader.GetSigned(kRotationBits);
+            }
+            q.v[7] = 0;
+        }
+    }
+    else if (kind == kDeltaFrame && m_have_previous)
+    {
+        uint32_t changed = reader.Get(m_bone_count);
+        uint32_t position_bits = reader.Get(5);
+        uint32_t rotation_bits = reader.Get(4);
+        for (uint32_t i = 0; i < m_bone_count; i++)
+        {
+            QuantizedBone &q = current[i];
+            Predict(i, &q);
+            if ((changed & (1u << i)) == 0)
+                continue;
+            bool moved = reader.Get(1) != 0;
+            uint32_t rotation = reader.Get(2);
+            for (int k = 0; moved && k < 3; k++)
+            {
+                q.v[k] += reader.GetSigned(position_bits);
+            }
+            if (rotation == kRotationDelta)
+            {
+                for (int k = 4; k < 7; k++)
+                {
+                    q.v[k] += reader.GetSigned(rotation_bits);
+                }
+            }
+            else if (rotation == kRotationAbsolute)
+            {
+                q.v[3] = (int32_t)reader.Get(2);
+                for (int k = 4; k < 7; k++)
+                {
+                    q.v[k] = reader.GetSigned(kRotationBits);
+                }
+            }
+            else if (rotation != kRotationSame)
+            {
+                return false;
+            }
+        }
+    }
+    else
+    {
+        return false;
+    }
+    if (!reader.Ok())
+        return false;
+
+    // only a whole frame moves the decoder on, so a bad one leaves it where it was
+    m_have_before_previous = kind == kDeltaFrame;
+    Advance(current);
+    *offset = reader.Offset();
+    for (uint32_t i = 0; i < m_bone_count; i++)
+    {
+        Dequantize(current[i], m_reference[i], &bones[i]);
+    }
+    return true;
+}
+
+};
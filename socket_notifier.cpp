@@ -2,20 +2,33 @@
 // socket_notifier
 //	* hide ipc and cross platform stuff 
 //
+// The listen socket and the wake pair are opened by StartListening and
+// closed by StopListening only after the listen thread has been joined, so
+// the thread never sees a descriptor closed or reused under it.  The thread
+// blocks in poll() on both.  StopListening writes a byte to the wake pair
+// (a pipe, or on Windows a loopback UDP socket connected to itself) to end
+// the wait, rather than closing the socket out from under accept().
+//
 #if defined(_WIN32)
 #include <io.h>
 #include <tchar.h>
+#include <winsock2.h>
 #include <windows.h>
 #define LAST_ERROR() WSAGetLastError() 
 #define CLOSE_SOCKET(x) closesocket(x)
-#define SHUTDOWN_BOTH 2
+#define POLL(fds, n, timeout) WSAPoll(fds, n, timeout)
+#define INTERRUPTED(error) false
 #else
 #define SOCKET int
 #define INVALID_SOCKET (-1) 
 #define SOCKET_ERROR (-1) 
 #define CLOSE_SOCKET(x) close(x)
 #define LAST_ERROR() errno 
-#define SHUTDOWN_BOTH SHUT_RDWR
+#define POLL(fds, n, timeout) poll(fds, n, timeout)
+#define INTERRUPTED(error) ((error) == EINTR)
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -30,6 +43,7 @@
 #include <vector>
 #include <string>
 #include "dprintf.h"
+#include "trace.h"
 
 #include "socket_notifier.h"
 
@@ -41,11 +55,16 @@ private:
 	SocketNotifier *m_who_to_notify;
 
 	SOCKET m_listen_socket;
+	SOCKET m_wake_read;		// readable when StopListening wants the thread to exit
+	SOCKET m_wake_write;	// the same socket as m_wake_read on Windows
 	string m_listen_address;
 	u_short m_listen_port;
 	thread m_listen_thread;    // a thread to wait to know when to add the new devices;
 	
 	static void listen_thread(SocketNotifierImpl *pthis);
+	bool OpenListenSocket();
+	bool OpenWakePair();
+	void CloseAll();
 public:
 	SocketNotifierImpl(SocketNotifier *who_to_notify);
 	~SocketNotifierImpl();
@@ -53,9 +72,23 @@ public:
 	void StopListening();
 };
 
+static bool set_nonblocking(SOCKET s)
+{
+#if defined(_WIN32)
+	u_long on = 1;
+	return ioctlsocket(s, FIONBIO, &on) == 0;
+#else
+	int flags = fcntl(s, F_GETFL, 0);
+	return flags >= 0 && fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0 && fcntl(s, F_SETFD, FD_CLOEXEC) == 0;
+#endif
+}
+
 SocketNotifierImpl::SocketNotifierImpl(SocketNotifier *who_to_notify)
 	:	m_who_to_notify(who_to_notify),
-		m_listen_socket(-1)
+		m_listen_socket(INVALID_SOCKET),
+		m_wake_read(INVALID_SOCKET),
+		m_wake_write(INVALID_SOCKET),
+		m_listen_port(0)
 {
 }
 
@@ -64,10 +97,97 @@ SocketNotifierImpl::~SocketNotifierImpl()
 	StopListening();
 }
 
+bool SocketNotifierImpl::OpenListenSocket()
+{
+	m_listen_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (m_listen_socket == INVALID_SOCKET) {
+		DLOG_ERROR("socket failed with error: %ld\n", LAST_ERROR());
+		return false;
+	}
+
+	// a restart shouldn't have to wait out the last run's TIME_WAIT connections
+	int reuse = 1;
+	setsockopt(m_listen_socket, SOL_SOCKET, SO_REUSEADDR, (const char *)&reuse, sizeof(reuse));
+
+	sockaddr_in service;
+	memset(&service, 0, sizeof(service));
+	service.sin_family = AF_INET;
+	service.sin_addr.s_addr = inet_addr(m_listen_address.c_str());
+	service.sin_port = htons(m_listen_port);
+	if (::bind(m_listen_socket, (sockaddr*)&service, sizeof(service)) == SOCKET_ERROR) {
+		DLOG_ERROR("bind failed with error: %ld\n", LAST_ERROR());
+		return false;
+	}
+	DLOG_DEBUG("about to listen\n");
+	if (listen(m_listen_socket, 4) == SOCKET_ERROR) {
+		DLOG_ERROR("listen failed with error: %ld\n", LAST_ERROR());
+		return false;
+	}
+	// poll says when to accept; non-blocking so a connection reset in between can't hang accept
+	return set_nonblocking(m_listen_socket);
+}
+
+bool SocketNotifierImpl::OpenWakePair()
+{
+#if defined(_WIN32)
+	m_wake_read = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (m_wake_read == INVALID_SOCKET)
+		return false;
+	sockaddr_in self;
+	memset(&self, 0, sizeof(self));
+	self.sin_family = AF_INET;
+	self.sin_addr.s_addr = inet_addr("127.0.0.1");
+	self.sin_port = 0;
+	int size = sizeof(self);
+	if (::bind(m_wake_read, (sockaddr*)&self, sizeof(self)) == SOCKET_ERROR ||
+		getsockname(m_wake_read, (sockaddr*)&self, &size) == SOCKET_ERROR ||
+		connect(m_wake_read, (sockaddr*)&self, sizeof(self)) == SOCKET_ERROR)
+	{
+		return false;
+	}
+	m_wake_write = m_wake_read;
+	return set_nonblocking(m_wake_read);
+#else
+	int fds[2];
+	if (pipe(fds) != 0)
+		return false;
+	m_wake_read = fds[0];
+	m_wake_write = fds[1];
+	return set_nonblocking(m_wake_read) && set_nonblocking(m_wake_write);
+#endif
+}
+
+void SocketNotifierImpl::CloseAll()
+{
+	if (m_listen_socket != INVALID_SOCKET)
+		CLOSE_SOCKET(m_listen_socket);
+	if (m_wake_write != INVALID_SOCKET && m_wake_write != m_wake_read)
+		CLOSE_SOCKET(m_wake_write);
+	if (m_wake_read != INVALID_SOCKET)
+		CLOSE_SOCKET(m_wake_read);
+	m_listen_socket = INVALID_SOCKET;
+	m_wake_read = INVALID_SOCKET;
+	m_wake_write = INVALID_SOCKET;
+}
+
 void SocketNotifierImpl::StartListening(const char *listen_address, u_short listen_port)
 {
+	// re-arming: finish with any previous listener first
+	StopListening();
+
 	m_listen_address = listen_address;
 	m_listen_port = listen_port;
+	if (!OpenWakePair())
+	{
+		DLOG_ERROR("could not create the notifier wake pair: %ld\n", LAST_ERROR());
+		CloseAll();
+		return;
+	}
+	if (!OpenListenSocket())
+	{
+		CloseAll();
+		return;
+	}
 	m_listen_thread = thread(listen_thread, this);
 }
 
@@ -77,54 +197,45 @@ void SocketNotifierImpl::listen_thread(SocketNotifierImpl *pthis)
 #ifdef _WIN32
 	HRESULT hr = SetThreadDescription(GetCurrentThread(), L"soft knuckles listen to activate thread");
 #endif
-	dprintf("listen thread started\n");
-	pthis->m_listen_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-	if (pthis->m_listen_socket == INVALID_SOCKET) {
-		dprintf("socket failed with error: %ld\n", LAST_ERROR());
-		return;
-	}
-	else
+	trace_set_thread_name("notifier listen thread");
+	DLOG_INFO("listen thread started\n");
+
+	while (true)
 	{
-		sockaddr_in service;
-		memset(&service, 0, sizeof(service));
-		service.sin_family = AF_INET;
-		service.sin_addr.s_addr = inet_addr(pthis->m_listen_address.c_str());
-		service.sin_port = htons(pthis->m_listen_port);
-
-		if (::bind(pthis->m_listen_socket, (sockaddr*)&service, sizeof(service)) == SOCKET_ERROR) {
-			dprintf("bind failed with error: %ld\n", LAST_ERROR());
-			CLOSE_SOCKET(pthis->m_listen_socket);
-			pthis->m_listen_socket = -1;
-			return;
+		pollfd fds[2];
+		memset(fds, 0, sizeof(fds));
+		fds[0].fd = pthis->m_listen_socket;
+		fds[0].events = POLLIN;
+		fds[1].fd = pthis->m_wake_read;
+		fds[1].events = POLLIN;
+		if (POLL(fds, 2, -1) < 0)
+		{
+			if (INTERRUPTED(LAST_ERROR()))
+				continue;
+			DLOG_ERROR("poll failed with error: %ld\n", LAST_ERROR());
+			break;
 		}
-		dprintf("about to listen\n");
-		if (listen(pthis->m_listen_socket, 1) == SOCKET_ERROR) {
-			dprintf("listen failed with error: %ld\n", LAST_ERROR());
-			CLOSE_SOCKET(pthis->m_listen_socket);
-			pthis->m_listen_socket = -1;
+		if (fds[1].revents)
+		{
+			DLOG_DEBUG("listen thread stopping\n");
+			break;
 		}
-		else
+		if (fds[0].revents & POLLIN)
 		{
 			SOCKET incoming = accept(pthis->m_listen_socket, nullptr, nullptr);
-			if (0 > incoming)
+			if (incoming == INVALID_SOCKET)
 			{
-				dprintf("accept failed with error: %ld\n", LAST_ERROR());
+				// e.g. the client gave up between poll and accept
+				DLOG_WARN("accept failed with error: %ld\n", LAST_ERROR());
+				continue;
 			}
-			else
+			SK_TRACE_INSTANT("accept");
+			CLOSE_SOCKET(incoming);
+			DLOG_INFO("new connection from port: %d\n", pthis->m_listen_port);
+			if (pthis->m_who_to_notify)
 			{
-				CLOSE_SOCKET(incoming);
-				if (CLOSE_SOCKET(pthis->m_listen_socket) < 0)
-				{
-					dprintf("close failed - must be shutting down\n");
-				}
-				else
-				{
-					dprintf("new connection from port: %d\n", pthis->m_listen_port);
-					if (pthis->m_who_to_notify)
-					{
-						pthis->m_who_to_notify->Notify();
-					}
-				}
+				SK_TRACE_SCOPE("notify");
+				pthis->m_who_to_notify->Notify();
 			}
 		}
 	}
@@ -132,17 +243,20 @@ void SocketNotifierImpl::listen_thread(SocketNotifierImpl *pthis)
 
 void SocketNotifierImpl::StopListening()
 {
-	// close my listener socket
-	if (m_listen_socket != -1)
+	if (m_listen_thread.joinable())
 	{
-		//shutdown(m_listen_socket, SHUTDOWN_BOTH);
-		CLOSE_SOCKET(m_listen_socket);
-		m_listen_socket = -1;
-		if (m_listen_thread.joinable())
+		char byte = 1;
+#if defined(_WIN32)
+		if (send(m_wake_write, &byte, 1, 0) != 1)
+#else
+		if (write(m_wake_write, &byte, 1) != 1)
+#endif
 		{
-			m_listen_thread.join();
+			DLOG_ERROR("could not wake the listen thread: %ld\n", LAST_ERROR());
 		}
+		m_listen_thread.join();
 	}
+	CloseAll();
 }
 
 SocketNotifier::SocketNotifier()
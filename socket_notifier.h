@@ -3,7 +3,10 @@
 //
 // call Notify if a connection is made on listen_address and listen_port
 // 
-// intended as a signal to the device
+// intended as a signal to the device.  Notify is called from the listen
+// thread, once per connection, until StopListening.  StopListening returns
+// promptly and StartListening may be called again afterwards (or instead:
+// it stops the previous listener first).
 #pragma once
 
 class SocketNotifierImpl;
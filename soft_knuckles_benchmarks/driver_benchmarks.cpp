@@ -0,0 +1,427 @@
+//////////////////////////////////////////////////////////////////////////////
+// driver_benchmarks.cpp
+//
+// Microbenchmarks for the driver's hot paths: text and binary debug
+// requests, tokenize, the input path lookup, GetPose, the skeleton update,
+// the skeleton codec and dprintf, and debug requests to many devices at
+// once.
+//
+// The driver objects are linked in directly and talk to a MockHost (see
+// soft_knuckles_mock_host/mock_host.h), so no SteamVR is needed.  One left
+// hand device is activated and its pose thread is stopped again so that it
+// doesn't compete with the benchmarks.
+//
+// Besides ns/op every benchmark reports allocs/op, counted by replacing the
+// global operator new below.
+//
+// make_linux.sh builds soft_knuckles_benchmarks/soft_knuckles_benchmarks when
+// google benchmark is installed.  Run it from the repository root.  To check
+// for regressions against the checked in baseline:
+//
+//   soft_knuckles_benchmarks/soft_knuckles_benchmarks --benchmark_out=new.json --benchmark_out_format=json
+//   <google benchmark>/tools/compare.py benchmarks soft_knuckles_benchmarks/baseline.json new.json
+//
+// and to update the baseline, write it to soft_knuckles_benchmarks/baseline.json
+// in the same way, from an optimized build on an otherwise idle machine.
+//
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <thread>
+#include <benchmark/benchmark.h>
+#include "../dprintf.h"
+#include "../soft_knuckles_config.h"
+#include "../soft_knuckles_device.h"
+#include "../soft_knuckles_debug_handler.h"
+#include "../skeleton_codec.h"
+#include "../binary_command.h"
+#include "../soft_knuckles_mock_host/mock_host.h"
+
+//////////////////////////////////////////////////////////////////////////////
+// allocation counting
+//
+static std::atomic<uint64_t> g_allocations(0);
+
+#if defined(__GNUC__) && __GNUC__ >= 11
+// gcc can't tell these replace the global operators and warns about malloc/delete pairs
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void *operator new(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+class AllocationCounter
+{
+public:
+    AllocationCounter() : m_start(g_allocations.load(std::memory_order_relaxed)) {}
+
+    void Report(benchmark::State &state)
+    {
+        uint64_t allocations = g_allocations.load(std::memory_order_relaxed) - m_start;
+        state.counters["allocs/op"] = benchmark::Counter((double)allocations, benchmark::Counter::kAvgIterations);
+    }
+
+private:
+    uint64_t m_start;
+};
+
+namespace soft_knuckles
+{
+    // reaches the private pieces the benchmarks measure directly
+    struct BenchmarkAccess
+    {
+        static bool LookupComponent(SoftKnucklesDebugHandler *handler, const std::string &path, uint32_t *index)
+        {
+            return handler->LookupComponent(path, index);
+        }
+
+        static void UpdateSkeleton(SoftKnucklesDevice *device)
+        {
+            SoftKnucklesDevice::update_skeleton(device);
+        }
+
+        // what a pos request does to the device once it is parsed
+        static void PostPosition(SoftKnucklesDevice *device, double x, double y, double z, uint64_t arrival_ns)
+        {
+            device->SetPosition(x, y, z);
+            SoftKnucklesDevice::NotePendingCommand(&device->m_pending_pose_command_ns, arrival_ns);
+        }
+
+        // the loads the pose thread makes every tick, and its take of a pending pose command
+        static bool PollPumpState(SoftKnucklesDevice *device)
+        {
+            bool running = device->m_running.load(std::memory_order_relaxed) || device->m_skeleton_demo.load(std::memory_order_relaxed);
+            return SoftKnucklesDevice::TakePendingCommand(&device->m_pending_pose_command_ns) != 0 || running;
+        }
+    };
+};
+
+using namespace soft_knuckles;
+
+//////////////////////////////////////////////////////////////////////////////
+// one activated left hand device on a mock host, shared by all benchmarks
+//
+struct BenchmarkEnvironment
+{
+    MockHost host;
+    soft_knuckles::SoftKnucklesDevice device;
+    SoftKnucklesDebugHandler handler;
+
+    BenchmarkEnvironment()
+    {
+        host.LoadSettings("soft_knuckles/resources/settings/default.vrsettings");
+        host.SetRecording(false);
+        vr::InitServerDriverContext(&host);
+        dprintf_start(nullptr);
+
+        device.Init(TrackedControllerRole_LeftHand, load_component_table(TrackedControllerRole_LeftHand), &handler);
+        host.TrackedDeviceAdded(device.get_serial().c_str(), TrackedDeviceClass_Controller, &device);
+        host.RunFrame();
+        device.Deactivate();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+};
+
+static BenchmarkEnvironment &environment()
+{
+    static BenchmarkEnvironment *env = new BenchmarkEnvironment;
+    return *env;
+}
+
+static void run_debug_request(benchmark::State &state, const char *request)
+{
+    BenchmarkEnvironment &env = environment();
+    char response[256];
+    AllocationCounter allocations;
+    for (auto _ : state)
+    {
+        env.device.DebugRequest(request, response, sizeof(response));
+        benchmark::DoNotOptimize(response);
+    }
+    allocations.Report(state);
+}
+
+static void BM_DebugRequestBool(benchmark::State &state)
+{
+    run_debug_request(state, "/input/a/click 1");
+}
+BENCHMARK(BM_DebugRequestBool);
+
+static void BM_DebugRequestScalar(benchmark::State &state)
+{
+    run_debug_request(state, "/input/trigger/value 0.5");
+}
+BENCHMARK(BM_DebugRequestScalar);
+
+static void BM_DebugRequestPos(benchmark::State &state)
+{
+    run_debug_request(state, "pos 0.1 0.2 0.3");
+}
+BENCHMARK(BM_DebugRequestPos);
+
+// the binary form of BM_DebugRequestScalar (see binary_command.h)
+static void BM_DebugRequestBinaryScalar(benchmark::State &state)
+{
+    BenchmarkEnvironment &env = environment();
+    char response[256];
+    env.device.DebugRequest("component /input/trigger/value", response, sizeof(response));
+    BinaryCommandEncoder encoder;
+    encoder.Component((uint8_t)atoi(response + 3), 0.5f);
+    run_debug_request(state, encoder.Request());
+}
+BENCHMARK(BM_DebugRequestBinaryScalar);
+
+static void BM_BinaryDecode(benchmark::State &state)
+{
+    BinaryCommandEncoder encoder;
+    encoder.Component(3, 0.5f);
+    const char *request = encoder.Request();
+    BinaryCommand commands[kMaxBinaryCommands];
+    uint32_t count;
+    AllocationCounter allocations;
+    for (auto _ : state)
+    {
+        decode_binary_request(request, commands, kMaxBinaryCommands, &count);
+        benchmark::DoNotOptimize(commands);
+    }
+    allocations.Report(state);
+}
+BENCHMARK(BM_BinaryDecode);
+
+static void BM_Tokenize(benchmark::State &state)
+{
+    std::vector<std::string> tokens;
+    AllocationCounter allocations;
+    for (auto _ : state)
+    {
+        tokenize("/input/trigger/value 0.5", " \r\t\n,", &tokens);
+        benchmark::DoNotOptimize(tokens.data());
+    }
+    allocations.Report(state);
+}
+BENCHMARK(BM_Tokenize);
+
+static void BM_InputLookup(benchmark::State &state)
+{
+    BenchmarkEnvironment &env = environment();
+    std::string path = "/input/trigger/value";
+    uint32_t index = 0;
+    AllocationCounter allocations;
+    for (auto _ : state)
+    {
+        BenchmarkAccess::LookupComponent(&env.handler, path, &index);
+        benchmark::DoNotOptimize(index);
+    }
+    allocations.Report(state);
+}
+BENCHMARK(BM_InputLookup);
+
+static void BM_GetPose(benchmark::State &state)
+{
+    BenchmarkEnvironment &env = environment();
+    AllocationCounter allocations;
+    for (auto _ : state)
+    {
+        DriverPose_t pose = env.device.GetPose();
+        benchmark::DoNotOptimize(pose);
+    }
+    allocations.Report(state);
+}
+BENCHMARK(BM_GetPose);
+
+static void BM_UpdateSkeleton(benchmark::State &state)
+{
+    BenchmarkEnvironment &env = environment();
+    AllocationCounter allocations;
+    for (auto _ : state)
+    {
+        BenchmarkAccess::UpdateSkeleton(&env.device);
+    }
+    allocations.Report(state);
+}
+BENCHMARK(BM_UpdateSkeleton);
+
+// a 31 bone hand curling and opening again over kFrames frames: every bone
+// offset from the reference and rotated a little more each frame, as a hand
+// part way between two poses would be
+struct SkeletonFrames
+{
+    static const uint32_t kBones = 31;
+    static const uint32_t kFrames = 60;
+    VRBoneTransform_t reference[kBones];
+    VRBoneTransform_t frames[kFrames][kBones];
+
+    SkeletonFrames()
+    {
+        for (uint32_t i = 0; i < kBones; i++)
+        {
+            reference[i].position = { { 0.01f * i, 0.02f, -0.005f * i, 1.0f } };
+            reference[i].orientation = { 1.0f, 0.0f, 0.0f, 0.0f };
+        }
+        for (uint32_t f = 0; f < kFrames; f++)
+        {
+            float t = f < kFrames / 2 ? f / (kFrames / 2.0f) : (kFrames - f) / (kFrames / 2.0f);
+            for (uint32_t i = 0; i < kBones; i++)
+            {
+                frames[f][i].position = { { 0.01f * i + 0.003f * t, 0.02f - 0.002f * t, -0.005f * i, 1.0f } };
+                float angle = 0.02f * (i + 1) * t;
+                frames[f][i].orientation = { cosf(angle), sinf(angle), 0.0f, 0.0f };
+            }
+        }
+    }
+};
+
+static void BM_SkeletonEncode(benchmark::State &state)
+{
+    SkeletonFrames frames;
+    SkeletonCodec codec(frames.reference, SkeletonFrames::kBones);
+    uint8_t out[SkeletonCodec::kMaxEncodedSize];
+    size_t bytes = 0;
+    uint32_t f = 0;
+    AllocationCounter allocations;
+    for (auto _ : state)
+    {
+        bytes += codec.Encode(frames.frames[f], out);
+        f = f + 1 < SkeletonFrames::kFrames ? f + 1 : 0;
+        benchmark::DoNotOptimize(out);
+    }
+    state.counters["bytes/frame"] = benchmark::Counter((double)bytes, benchmark::Counter::kAvgIterations);
+    allocations.Report(state);
+}
+BENCHMARK(BM_SkeletonEncode);
+
+static void BM_SkeletonDecodeKeyframe(benchmark::State &state)
+{
+    SkeletonFrames frames;
+    SkeletonCodec encoder(frames.reference, SkeletonFrames::kBones);
+    SkeletonCodec decoder(frames.reference, SkeletonFrames::kBones);
+    uint8_t encoded[SkeletonCodec::kMaxEncodedSize];
+    size_t size = encoder.Encode(frames.frames[SkeletonFrames::kFrames / 2], encoded);
+    VRBoneTransform_t bones[SkeletonFrames::kBones];
+    AllocationCounter allocations;
+    for (auto _ : state)
+    {
+        size_t offset = 0;
+        decoder.Decode(encoded, size, &offset, bones);
+        benchmark::DoNotOptimize(bones);
+    }
+    allocations.Report(state);
+}
+BENCHMARK(BM_SkeletonDecodeKeyframe);
+
+// several devices in an array, as the provider holds them, each with a
+// thread writing its pose state the way a pos request does (without the
+// parsing, so the shared fields dominate) and another doing what the pose
+// thread does to them each tick.  on a multi-core machine the rate should
+// scale with the thread count; if it stops doing so, threads are contending
+// over the device's lines.
+static const uint32_t kManyDevices = 8;
+
+struct ManyDevicesEnvironment
+{
+    soft_knuckles::SoftKnucklesDevice devices[kManyDevices];
+    SoftKnucklesDebugHandler handlers[kManyDevices];
+    std::thread pollers[kManyDevices];
+    std::atomic<bool> polling;
+
+    ManyDevicesEnvironment() : polling(false)
+    {
+        BenchmarkEnvironment &env = environment();
+        std::shared_ptr<const ComponentTable> components = load_component_table(TrackedControllerRole_LeftHand);
+        for (uint32_t i = 0; i < kManyDevices; i++)
+        {
+            char setting[64];
+            snprintf(setting, sizeof(setting), "driver_soft_knuckles.serialNumber=many%u", i);
+            env.host.SetSetting(setting);
+            devices[i].Init(TrackedControllerRole_LeftHand, components, &handlers[i]);
+        }
+    }
+
+    void StartPolling(uint32_t count)
+    {
+        polling = true;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            pollers[i] = std::thread([this, i]() {
+                uint64_t polls = 0;
+                while (polling.load(std::memory_order_relaxed))
+                {
+                    polls += BenchmarkAccess::PollPumpState(&devices[i]) ? 1 : 0;
+                }
+                benchmark::DoNotOptimize(polls);
+            });
+        }
+    }
+
+    void StopPolling(uint32_t count)
+    {
+        polling = false;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            pollers[i].join();
+        }
+    }
+};
+
+static ManyDevicesEnvironment &many_devices()
+{
+    static ManyDevicesEnvironment *env = new ManyDevicesEnvironment;
+    return *env;
+}
+
+static void BM_ManyDevicesPos(benchmark::State &state)
+{
+    ManyDevicesEnvironment &env = many_devices();
+    soft_knuckles::SoftKnucklesDevice &device = env.devices[state.thread_index() % kManyDevices];
+    if (state.thread_index() == 0)
+    {
+        env.StartPolling((uint32_t)state.threads());
+    }
+    uint64_t arrival_ns = 1;
+    for (auto _ : state)
+    {
+        BenchmarkAccess::PostPosition(&device, 0.1, 0.2, 0.3, arrival_ns++);
+    }
+    if (state.thread_index() == 0)
+    {
+        env.StopPolling((uint32_t)state.threads());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ManyDevicesPos)->ThreadRange(1, kManyDevices)->UseRealTime();
+
+// the producer side only: the writer thread drains in the background and
+// messages it can't keep up with are dropped, which is the intended behaviour.
+static void BM_Dprintf(benchmark::State &state)
+{
+    environment();
+    int i = 0;
+    AllocationCounter allocations;
+    for (auto _ : state)
+    {
+        dprintf("benchmark message %d: %f\n", i++, 0.5);
+    }
+    allocations.Report(state);
+}
+BENCHMARK(BM_Dprintf);
+
+BENCHMARK_MAIN();
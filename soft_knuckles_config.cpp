@@ -7,10 +7,10 @@
 
 #define COMPONENT_DEFINITIONS(HAND) \
     {\
-        { "/input/joystick/x", CT_SCALAR, VRScalarType_Absolute, VRScalarUnits_NormalizedTwoSided},\
-        { "/input/joystick/y",      CT_SCALAR, VRScalarType_Absolute, VRScalarUnits_NormalizedTwoSided },\
-        { "/input/joystick/click",  CT_BOOLEAN },\
-        { "/input/joystick/touch",  CT_BOOLEAN },\
+        { "/input/thumbstick/x",    CT_SCALAR, VRScalarType_Absolute, VRScalarUnits_NormalizedTwoSided},\
+        { "/input/thumbstick/y",    CT_SCALAR, VRScalarType_Absolute, VRScalarUnits_NormalizedTwoSided },\
+        { "/input/thumbstick/click", CT_BOOLEAN },\
+        { "/input/thumbstick/touch", CT_BOOLEAN },\
 \
         { "/input/trackpad/x",      CT_SCALAR, VRScalarType_Absolute, VRScalarUnits_NormalizedTwoSided },\
         { "/input/trackpad/y",      CT_SCALAR, VRScalarType_Absolute, VRScalarUnits_NormalizedTwoSided },\
@@ -31,6 +31,7 @@ namespace soft_knuckles
         CT_SCALAR,
         CT_SKELETON,
         CT_HAPTIC,
+        NUM_COMPONENT_TYPES
     };
 
     struct KnuckleComponentDefinition
@@ -0,0 +1,290 @@
+//////////////////////////////////////////////////////////////////////////////
+// debug_script.cpp
+//
+// See header for description
+//
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include "debug_script.h"
+
+#ifdef _WIN32
+#pragma warning (disable: 4996)
+#endif
+
+// sleep until this long before a deadline, then spin
+static const std::chrono::microseconds kSpinWindow(1000);
+
+static char *trim(char *s)
+{
+    while (*s && isspace((unsigned char)*s))
+        s++;
+    char *comment = strchr(s, '#');
+    if (comment)
+        *comment = '\0';
+    size_t n = strlen(s);
+    while (n > 0 && isspace((unsigned char)s[n - 1]))
+        s[--n] = '\0';
+    return s;
+}
+
+static bool parse_number(const char *token, double *value)
+{
+    char *end;
+    *value = strtod(token, &end);
+    return end != token && *end == '\0' && isfinite(*value);
+}
+
+bool parse_script_request(const char *request, ScriptEvent *event, std::string *error)
+{
+    static const uint32_t kMaxTokens = 6;
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", request);
+    char *tokens[kMaxTokens];
+    uint32_t n = 0;
+    for (char *token = strtok(buf, " \t\r\n"); token; token = strtok(nullptr, " \t\r\n"))
+    {
+        if (n < kMaxTokens)
+            tokens[n] = token;
+        n++;
+    }
+
+    event->kind = kScriptText;
+    event->path[0] = '\0';
+    event->delay_us = 0;
+    if (n == 0)
+        return true;
+    if (strcmp(tokens[0], "pos") == 0 || strcmp(tokens[0], "rot") == 0)
+    {
+        bool position = tokens[0][0] == 'p';
+        uint32_t count = position ? 3 : 4;
+        if (n != count + 1)
+        {
+            *error = position ? "expected pos <x> <y> <z>" : "expected rot <w> <x> <y> <z>";
+            return false;
+        }
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (!parse_number(tokens[1 + i], &event->values[i]))
+            {
+                *error = std::string("not a number: ") + tokens[1 + i];
+                return false;
+            }
+        }
+        event->kind = position ? kScriptPosition : kScriptRotation;
+    }
+    else if (tokens[0][0] == '/')
+    {
+        if ((n != 2 && n != 3) || strlen(tokens[0]) >= sizeof(event->path))
+        {
+            *error = "expected <path> <value> [+<delay_ms>]";
+            return false;
+        }
+        if (!parse_number(tokens[1], &event->values[0]))
+        {
+            *error = std::string("not a number: ") + tokens[1];
+            return false;
+        }
+        double delay_ms = 0;
+        if (n == 3 && (tokens[2][0] != '+' || !parse_number(tokens[2] + 1, &delay_ms) || delay_ms < 0 || delay_ms > 4294967.0))
+        {
+            *error = std::string("bad delay: ") + tokens[2] + " (expected +<ms>)";
+            return false;
+        }
+        strcpy(event->path, tokens[0]);
+        event->delay_us = (uint32_t)(delay_ms * 1000);
+        event->kind = kScriptComponent;
+    }
+    return true;
+}
+
+// the text form of a typed event.  the driver queues a +<ms> delay just as it does
+// for a binary request.
+static void format_request(ScriptEvent *event)
+{
+    const double *v = event->values;
+    if (event->kind == kScriptPosition)
+    {
+        snprintf(event->request, sizeof(event->request), "pos %.9g %.9g %.9g", v[0], v[1], v[2]);
+    }
+    else if (event->kind == kScriptRotation)
+    {
+        snprintf(event->request, sizeof(event->request), "rot %.9g %.9g %.9g %.9g", v[0], v[1], v[2], v[3]);
+    }
+    else if (event->delay_us)
+    {
+        snprintf(event->request, sizeof(event->request), "%s %.9g +%.9g", event->path, v[0], event->delay_us / 1000.0);
+    }
+    else
+    {
+        snprintf(event->request, sizeof(event->request), "%s %.9g", event->path, v[0]);
+    }
+}
+
+bool compile_script(const char *path, uint32_t left_index, uint32_t right_index, uint32_t invalid_index,
+    ScriptTimeline *timeline, std::string *error)
+{
+    FILE *f = fopen(path, "rt");
+    if (!f)
+    {
+        *error = std::string("could not open ") + path;
+        return false;
+    }
+    timeline->events.clear();
+    timeline->end_ns = 0;
+
+    uint64_t offset_ns = 0;
+    uint32_t line = 0;
+    char buf[512];
+    bool ok = true;
+    while (ok && fgets(buf, sizeof(buf), f))
+    {
+        line++;
+        char *cmd = trim(buf);
+        char message[128];
+        message[0] = '\0';
+
+        double sleep_ms;
+        char extra;
+        if (*cmd == '\0')
+        {
+            continue;
+        }
+        else if (strncmp(cmd, "sleep", 5) == 0)
+        {
+            if (sscanf(cmd + 5, "%lf %c", &sleep_ms, &extra) != 1 || sleep_ms < 0)
+                snprintf(message, sizeof(message), "line %u: expected sleep <ms>", line);
+            else
+                offset_ns += (uint64_t)(sleep_ms * 1e6);
+        }
+        else if (strcmp(cmd, "quit") == 0)
+        {
+            break;
+        }
+        else if ((cmd[0] == 'l' || cmd[0] == 'r') && isspace((unsigned char)cmd[1]))
+        {
+            ScriptEvent event;
+            event.offset_ns = offset_ns;
+            event.device_index = cmd[0] == 'l' ? left_index : right_index;
+            event.line = line;
+            const char *request = trim(cmd + 1);
+            std::string detail;
+            if (event.device_index == invalid_index)
+                snprintf(message, sizeof(message), "line %u: no %s controller", line, cmd[0] == 'l' ? "left" : "right");
+            else if (*request == '\0' || strlen(request) >= sizeof(event.request))
+                snprintf(message, sizeof(message), "line %u: empty or overlong request", line);
+            else if (!parse_script_request(request, &event, &detail))
+                snprintf(message, sizeof(message), "line %u: %s", line, detail.c_str());
+            else
+            {
+                if (event.kind == kScriptText)
+                    strcpy(event.request, request);
+                else
+                    format_request(&event);
+                timeline->events.push_back(event);
+            }
+        }
+        else
+        {
+            snprintf(message, sizeof(message), "line %u: unrecognized target (choose l or r)", line);
+        }
+
+        if (message[0])
+        {
+            *error = message;
+            ok = false;
+        }
+    }
+    fclose(f);
+    timeline->end_ns = offset_ns;
+    return ok;
+}
+
+static double percentile(std::vector<double> &sorted, double p)
+{
+    if (sorted.empty())
+        return 0;
+    size_t index = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+void play_script(const ScriptTimeline &timeline, ScriptSendFn send, ScriptAdvanceFn advance, void *context,
+    bool verbose, ScriptDriftReport *report)
+{
+    typedef std::chrono::steady_clock clock;
+    std::vector<double> drift_us;
+    drift_us.reserve(timeline.events.size());
+    memset(report, 0, sizeof(*report));
+
+    char response[256];
+    uint64_t virtual_ns = 0;
+    const clock::time_point start = clock::now();
+    for (const ScriptEvent &event : timeline.events)
+    {
+        double drift = 0;
+        if (advance)
+        {
+            if (event.offset_ns > virtual_ns)
+            {
+                advance(context, event.offset_ns - virtual_ns);
+                virtual_ns = event.offset_ns;
+            }
+            send(context, event.device_index, event.request, response, sizeof(response));
+        }
+        else
+        {
+            clock::time_point deadline = start + std::chrono::nanoseconds(event.offset_ns);
+            if (clock::now() < deadline - kSpinWindow)
+            {
+                std::this_thread::sleep_until(deadline - kSpinWindow);
+            }
+            while (clock::now() < deadline)
+            {
+                std::this_thread::yield();
+            }
+            clock::time_point sent = clock::now();
+            send(context, event.device_index, event.request, response, sizeof(response));
+            drift = std::chrono::duration<double, std::micro>(sent - deadline).count();
+            drift_us.push_back(drift);
+            report->mean_us += drift;
+            if (drift > report->max_us)
+            {
+                report->max_us = drift;
+                report->max_line = event.line;
+            }
+            if (drift * 1000 > kScriptLateNs)
+                report->late_events++;
+        }
+        report->events++;
+        if (verbose)
+        {
+            // a request the client encoded to binary isn't printable
+            const char *request = (unsigned char)event.request[0] < 0x80 ? event.request : "(binary)";
+            printf("%6u %10.3fms %8.1fus %s -> %s\n", event.line, event.offset_ns / 1e6, drift, request, response);
+        }
+    }
+
+    // finish the trailing sleep, so a script ending in "sleep" runs its full length
+    if (advance)
+    {
+        if (timeline.end_ns > virtual_ns)
+            advance(context, timeline.end_ns - virtual_ns);
+    }
+    else
+    {
+        std::this_thread::sleep_until(start + std::chrono::nanoseconds(timeline.end_ns));
+    }
+
+    if (!drift_us.empty())
+    {
+        report->mean_us /= drift_us.size();
+        std::sort(drift_us.begin(), drift_us.end());
+        report->p50_us = percentile(drift_us, 50);
+        report->p99_us = percentile(drift_us, 99);
+    }
+}
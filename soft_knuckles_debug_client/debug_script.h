@@ -0,0 +1,85 @@
+//////////////////////////////////////////////////////////////////////////////
+// debug_script.h
+//
+// Script mode for soft_knuckles_debug_client:
+//
+//   soft_knuckles_debug_client --script grab_and_wave.txt
+//
+// The script uses the interactive syntax (l/r commands, sleep, # comments,
+// quit).  Before anything is sent the whole file is compiled into a
+// timeline: each command becomes a ScriptEvent with its device index
+// resolved and its time offset from the start.  Sleeps only move the
+// offset.  Component updates, pos and rot are parsed into typed fields, so
+// a missing value, one that isn't a number or a bad delay is caught here;
+// other verbs have no typed form and are kept as text for the driver to
+// check.  A bad line fails the compile, so nothing runs.
+//
+// Playback sends each event at its absolute deadline, start + offset.  It
+// sleeps until just before the deadline and spins the rest of the way.
+// Because deadlines don't depend on when the previous command finished, a
+// slow request delays only itself and not the rest of the script.  Each
+// send records its drift from the deadline, and playback ends with a
+// summary.
+//
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+enum ScriptEventKind
+{
+    kScriptText,                // any other request, sent as written
+    kScriptComponent,           // <path> <value> [+<delay_ms>]
+    kScriptPosition,            // pos <x> <y> <z>
+    kScriptRotation,            // rot <w> <x> <y> <z>
+};
+
+struct ScriptEvent
+{
+    uint64_t offset_ns;         // from the start of playback
+    uint32_t device_index;
+    uint32_t line;              // in the script, for reports
+    ScriptEventKind kind;
+    char path[128];             // kScriptComponent
+    double values[4];           // the component value, x y z or w x y z
+    uint32_t delay_us;          // kScriptComponent
+    char request[256];          // what playback sends: the text, or for a typed event its fields formatted
+};
+
+// fills in event's kind and typed fields from one request.  false with a message
+// when it is a component update, pos or rot but malformed.
+bool parse_script_request(const char *request, ScriptEvent *event, std::string *error);
+
+struct ScriptTimeline
+{
+    std::vector<ScriptEvent> events;
+    uint64_t end_ns;            // offset of the last sleep's end
+};
+
+// false with a message naming the line on a bad command or a missing target
+bool compile_script(const char *path, uint32_t left_index, uint32_t right_index, uint32_t invalid_index,
+    ScriptTimeline *timeline, std::string *error);
+
+typedef void (*ScriptSendFn)(void *context, uint32_t device_index, const char *request,
+    char *response, uint32_t response_size);
+
+// advance, when given, moves time on instead of waiting, for a driver on its virtual clock:
+// it is called with each gap between events and drift is not measured.
+typedef void (*ScriptAdvanceFn)(void *context, uint64_t ns);
+
+struct ScriptDriftReport
+{
+    uint32_t events;
+    uint32_t late_events;       // more than kScriptLateNs after the deadline
+    double mean_us;
+    double p50_us;
+    double p99_us;
+    double max_us;
+    uint32_t max_line;
+};
+
+static const uint64_t kScriptLateNs = 1000000;
+
+// verbose prints every event's reply and drift as it goes
+void play_script(const ScriptTimeline &timeline, ScriptSendFn send, ScriptAdvanceFn advance, void *context,
+    bool verbose, ScriptDriftReport *report);
@@ -0,0 +1,123 @@
+//////////////////////////////////////////////////////////////////////////////
+// load_generator.cpp
+//
+// See header for description
+//
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include "load_generator.h"
+#include "../latency_histogram.h"
+
+using soft_knuckles::LatencyHistogram;
+
+namespace
+{
+    typedef std::chrono::steady_clock load_clock;
+
+    struct LoadThreadResult
+    {
+        uint64_t requests;
+        uint64_t failures;
+        double seconds;
+        LatencyHistogram latency;
+    };
+
+    void load_thread(const LoadTarget &target, const LoadOptions &options, LoadSendFn send, void *context,
+        load_clock::time_point start, LoadThreadResult *result)
+    {
+        const load_clock::time_point end = start + std::chrono::duration_cast<load_clock::duration>(
+            std::chrono::duration<double>(options.seconds));
+        const load_clock::duration period = options.rate > 0 ?
+            std::chrono::duration_cast<load_clock::duration>(std::chrono::duration<double>(1.0 / options.rate)) :
+            load_clock::duration::zero();
+
+        char response[256];
+        load_clock::time_point scheduled = start;
+        std::this_thread::sleep_until(start);
+        while (scheduled < end)
+        {
+            load_clock::time_point sent;
+            if (options.rate > 0)
+            {
+                std::this_thread::sleep_until(scheduled);
+                sent = scheduled;
+                scheduled += period;
+            }
+            else
+            {
+                sent = load_clock::now();
+                scheduled = sent;
+            }
+
+            response[0] = '\0';
+            send(context, target.device_index, target.request, response, sizeof(response));
+            load_clock::time_point done = load_clock::now();
+
+            result->requests++;
+            if (strncmp(response, "ok", 2) != 0)
+                result->failures++;
+            result->latency.Record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(done - sent).count());
+        }
+        result->seconds = std::chrono::duration<double>(load_clock::now() - start).count();
+    }
+
+    void print_result(const char *name, uint64_t requests, uint64_t failures, double seconds, const LatencyHistogram &latency)
+    {
+        printf("%-8s %10llu %10.0f %8llu   %s\n", name, (unsigned long long)requests,
+            seconds > 0 ? requests / seconds : 0.0, (unsigned long long)failures, latency.Summary().c_str());
+    }
+}
+
+void run_load(const std::vector<LoadTarget> &targets, const LoadOptions &options, LoadSendFn send, void *context)
+{
+    std::vector<LoadThreadResult *> results;
+    std::vector<std::thread> threads;
+
+    // every thread starts on the same tick
+    load_clock::time_point start = load_clock::now() + std::chrono::milliseconds(100);
+    for (const LoadTarget &target : targets)
+    {
+        LoadThreadResult *result = new LoadThreadResult();
+        result->requests = 0;
+        result->failures = 0;
+        result->seconds = 0;
+        results.push_back(result);
+        threads.push_back(std::thread(load_thread, std::cref(target), std::cref(options), send, context, start, result));
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+
+    if (options.rate > 0)
+        printf("\"%s\" for %.1fs at %.0f requests/s per device\n", options.request, options.seconds, options.rate);
+    else
+        printf("\"%s\" for %.1fs, flat out\n", options.request, options.seconds);
+    printf("device     requests      req/s failures   latency us: count p50 p99 p99.9 max\n");
+
+    uint64_t requests = 0;
+    uint64_t failures = 0;
+    double seconds = 0;
+    LatencyHistogram latency;
+    for (size_t i = 0; i < targets.size(); i++)
+    {
+        LoadThreadResult *result = results[i];
+        print_result(targets[i].name, result->requests, result->failures, result->seconds, result->latency);
+        requests += result->requests;
+        failures += result->failures;
+        if (result->seconds > seconds)
+            seconds = result->seconds;
+        latency.Merge(result->latency);
+    }
+    if (targets.size() > 1)
+    {
+        print_result("total", requests, failures, seconds, latency);
+    }
+
+    for (LoadThreadResult *result : results)
+    {
+        delete result;
+    }
+}
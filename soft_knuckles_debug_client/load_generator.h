@@ -0,0 +1,45 @@
+//////////////////////////////////////////////////////////////////////////////
+// load_generator.h
+//
+// Load generator mode for soft_knuckles_debug_client:
+//
+//   soft_knuckles_debug_client --load 10 --rate 2000 --request "/input/trigger/value 0.5"
+//
+// Each target device gets its own sender thread: left, right, and any
+// extra devices named with --device.  Each thread sends the same request
+// for the given number of seconds, at the given rate per thread or as fast
+// as it can with --rate 0.  The run ends with a report of requests/sec,
+// round trip latency percentiles and failures (replies that don't start
+// with "ok"), per device and in total.
+//
+// A rate limited thread measures latency from the moment each request was
+// scheduled to be sent, not from when it actually went out.  A stall then
+// counts against every request queued behind it rather than hiding them
+// (coordinated omission).  A thread that falls behind sends back to back
+// until it catches up.  The client's own wakeup lateness is counted too,
+// so on a loaded machine compare against a --rate 0 run.
+//
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+struct LoadTarget
+{
+    uint32_t device_index;
+    const char *name;
+    const char *request;        // usually options.request, or its binary encoding for this device
+};
+
+struct LoadOptions
+{
+    double seconds;
+    double rate;                // requests per second per thread, 0 for flat out
+    const char *request;        // as typed, for the report
+};
+
+// called from several threads at once
+typedef void (*LoadSendFn)(void *context, uint32_t device_index, const char *request,
+    char *response, uint32_t response_size);
+
+// runs the load and prints the report
+void run_load(const std::vector<LoadTarget> &targets, const LoadOptions &options, LoadSendFn send, void *context);
@@ -11,18 +11,44 @@
 // The example syntax in the printfs below should be sufficient to understand
 // the syntax.  
 //
+// With --virtual, for a driver running with the virtualClock setting,
+// "sleep" advances the driver's clock instead of sleeping, so a long script
+// runs as fast as the driver can step through it.
+//
+// With --script <file>, the file is compiled and played back at absolute
+// deadlines, then the client reports how far each send drifted from its
+// deadline and exits (see debug_script.h).  --verbose prints every event.
+//
+// With --load <seconds>, it runs a sender thread per controller instead,
+// and reports throughput, latency and failures (see load_generator.h):
+//
+//   --rate <n>         requests/s per device, 0 (the default) for flat out
+//   --request <text>   what to send, "/input/trigger/value 0.5" by default
+//   --device <index>   load another device as well, may be repeated
+//
+// With --binary, in any mode, component, pos and rot commands are sent as
+// binary requests (see binary_command.h and BinaryTranslator below).
+//
 #include <stdio.h>
 #include <ctype.h>
 #include <openvr.h>
 #include <thread>
 #include <chrono>
 #include <cstring>
+#include <stdlib.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "debug_script.h"
+#include "load_generator.h"
+#include "../binary_command.h"
 
 #ifdef _WIN32
 #pragma warning (disable: 4996)
 #endif
 
 using namespace vr;
+using soft_knuckles::BinaryCommandEncoder;
 
 static void send_request(COpenVRContext &ctx, vr::TrackedDeviceIndex_t index, const char *request, char *response_buffer, uint32_t response_buffer_size)
 {
@@ -32,8 +58,211 @@ static void send_request(COpenVRContext &ctx, vr::TrackedDeviceIndex_t index, co
     printf("%s\n", response_buffer);
 }
 
-int main()
+// --binary: "<path> <value> [+<delay_ms>]", "pos <x> <y> <z>" and "rot <w> <x> <y> <z>"
+// become binary requests; everything else is sent as text.  component indices come from the
+// driver's "component" request, once per device and path.
+class BinaryTranslator
 {
+public:
+    BinaryTranslator(COpenVRContext *ctx) : m_ctx(ctx) {}
+
+    // returns the binary request, valid until the next call, or text if it can't be encoded
+    const char *Translate(TrackedDeviceIndex_t device, const char *text)
+    {
+        ScriptEvent event;
+        std::string error;
+        if (!parse_script_request(text, &event, &error))
+            return text;
+        const char *request = Encode(device, event);
+        return request ? request : text;
+    }
+
+    // the binary request for a typed event, valid until the next call, or null for
+    // kScriptText and components the driver doesn't know
+    const char *Encode(TrackedDeviceIndex_t device, const ScriptEvent &event)
+    {
+        const double *v = event.values;
+        m_encoder.Reset();
+        bool encoded = false;
+        if (event.kind == kScriptPosition)
+        {
+            encoded = m_encoder.Position(v[0], v[1], v[2]);
+        }
+        else if (event.kind == kScriptRotation)
+        {
+            encoded = m_encoder.Rotation(v[0], v[1], v[2], v[3]);
+        }
+        else if (event.kind == kScriptComponent)
+        {
+            int index = ComponentIndex(device, event.path);
+            encoded = index >= 0 && m_encoder.Component((uint8_t)index, (float)v[0], event.delay_us);
+        }
+        return encoded ? m_encoder.Request() : nullptr;
+    }
+
+private:
+    int ComponentIndex(TrackedDeviceIndex_t device, const char *path)
+    {
+        std::string key = std::to_string(device) + " " + path;
+        auto iter = m_indices.find(key);
+        if (iter != m_indices.end())
+            return iter->second;
+
+        std::string request = std::string("component ") + path;
+        char response[256] = "";
+        m_ctx->VRSystem()->DriverDebugRequest(device, request.c_str(), response, sizeof(response));
+        int index = -1;
+        if (sscanf(response, "ok %d", &index) != 1)
+            index = -1;
+        m_indices[key] = index;
+        return index;
+    }
+
+    COpenVRContext *m_ctx;
+    std::map<std::string, int> m_indices;
+    BinaryCommandEncoder m_encoder;
+};
+
+struct ScriptContext
+{
+    COpenVRContext *ctx;
+    TrackedDeviceIndex_t clock_index;
+};
+
+static void script_send(void *context, uint32_t device_index, const char *request, char *response, uint32_t response_size)
+{
+    ScriptContext *script = (ScriptContext *)context;
+    response[0] = '\0';
+    script->ctx->VRSystem()->DriverDebugRequest(device_index, request, response, response_size);
+}
+
+static void script_advance(void *context, uint64_t ns)
+{
+    ScriptContext *script = (ScriptContext *)context;
+    char request[64];
+    char response[256];
+    snprintf(request, sizeof(request), "clock advance %.6f", ns / 1e6);
+    script_send(context, script->clock_index, request, response, sizeof(response));
+}
+
+static int run_script(COpenVRContext &ctx, const char *path, TrackedDeviceIndex_t left_index, TrackedDeviceIndex_t right_index,
+    bool virtual_clock, bool verbose, BinaryTranslator *binary)
+{
+    ScriptTimeline timeline;
+    std::string error;
+    if (!compile_script(path, left_index, right_index, k_unTrackedDeviceIndexInvalid, &timeline, &error))
+    {
+        printf("%s: %s\n", path, error.c_str());
+        return 1;
+    }
+    if (binary)
+    {
+        // encoded ahead of time too, from the typed fields, so playback only sends
+        for (ScriptEvent &event : timeline.events)
+        {
+            const char *request = binary->Encode(event.device_index, event);
+            if (request && strlen(request) < sizeof(event.request))
+                strcpy(event.request, request);
+        }
+    }
+    printf("%s: %u events over %.3fs\n", path, (uint32_t)timeline.events.size(), timeline.end_ns / 1e9);
+
+    ScriptContext context = { &ctx, left_index != k_unTrackedDeviceIndexInvalid ? left_index : right_index };
+    ScriptDriftReport report;
+    play_script(timeline, script_send, virtual_clock ? script_advance : nullptr, &context, verbose, &report);
+    if (virtual_clock)
+    {
+        printf("%u events sent on the virtual clock\n", report.events);
+    }
+    else
+    {
+        printf("%u events, drift us: mean %.1f p50 %.1f p99 %.1f max %.1f (line %u), %u late by more than %.1fms\n",
+            report.events, report.mean_us, report.p50_us, report.p99_us, report.max_us, report.max_line,
+            report.late_events, kScriptLateNs / 1e6);
+    }
+    return 0;
+}
+
+static void load_send(void *context, uint32_t device_index, const char *request, char *response, uint32_t response_size)
+{
+    COpenVRContext *ctx = (COpenVRContext *)context;
+    ctx->VRSystem()->DriverDebugRequest(device_index, request, response, response_size);
+}
+
+static int run_load_mode(COpenVRContext &ctx, TrackedDeviceIndex_t left_index, TrackedDeviceIndex_t right_index,
+    const std::vector<TrackedDeviceIndex_t> &extra_devices, const LoadOptions &options, BinaryTranslator *binary)
+{
+    std::vector<std::string> names;
+    std::vector<LoadTarget> targets;
+    if (left_index != k_unTrackedDeviceIndexInvalid)
+        targets.push_back({ left_index, "left", options.request });
+    if (right_index != k_unTrackedDeviceIndexInvalid)
+        targets.push_back({ right_index, "right", options.request });
+    names.reserve(extra_devices.size());
+    for (TrackedDeviceIndex_t index : extra_devices)
+    {
+        names.push_back("device " + std::to_string(index));
+        targets.push_back({ index, names.back().c_str(), options.request });
+    }
+    if (targets.empty())
+    {
+        printf("no devices to load\n");
+        return 1;
+    }
+
+    // each device may number its components differently, so each gets its own encoding
+    std::vector<std::string> requests;
+    requests.reserve(targets.size());
+    if (binary)
+    {
+        for (LoadTarget &target : targets)
+        {
+            requests.push_back(binary->Translate(target.device_index, options.request));
+            target.request = requests.back().c_str();
+        }
+    }
+    run_load(targets, options, load_send, &ctx);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    bool virtual_clock = false;
+    bool verbose = false;
+    const char *script_path = nullptr;
+    bool load = false;
+    bool binary = false;
+    LoadOptions load_options = { 0, 0, "/input/trigger/value 0.5" };
+    std::vector<TrackedDeviceIndex_t> extra_devices;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--virtual") == 0)
+            virtual_clock = true;
+        else if (strcmp(argv[i], "--verbose") == 0)
+            verbose = true;
+        else if (strcmp(argv[i], "--binary") == 0)
+            binary = true;
+        else if (strcmp(argv[i], "--script") == 0 && i + 1 < argc)
+            script_path = argv[++i];
+        else if (strcmp(argv[i], "--load") == 0 && i + 1 < argc)
+        {
+            load = true;
+            load_options.seconds = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc)
+            load_options.rate = atof(argv[++i]);
+        else if (strcmp(argv[i], "--request") == 0 && i + 1 < argc)
+            load_options.request = argv[++i];
+        else if (strcmp(argv[i], "--device") == 0 && i + 1 < argc)
+            extra_devices.push_back((TrackedDeviceIndex_t)atoi(argv[++i]));
+        else
+        {
+            printf("usage: soft_knuckles_debug_client [--binary] [--virtual] [--script <file> [--verbose]]\n");
+            printf("       soft_knuckles_debug_client [--binary] --load <seconds> [--rate <n>] [--request <text>] [--device <index>]...\n");
+            return 1;
+        }
+    }
+
     EVRInitError err;
     VR_Init(&err, VRApplication_Utility);
 
@@ -43,6 +272,21 @@ int main()
         // look for the two soft_knuckles controllers
         TrackedDeviceIndex_t left_index = ctx.VRSystem()->GetTrackedDeviceIndexForControllerRole(TrackedControllerRole_LeftHand);
         TrackedDeviceIndex_t right_index = ctx.VRSystem()->GetTrackedDeviceIndexForControllerRole(TrackedControllerRole_RightHand);
+        BinaryTranslator translator(&ctx);
+        BinaryTranslator *binary_translator = binary ? &translator : nullptr;
+
+        if (script_path)
+        {
+            int result = run_script(ctx, script_path, left_index, right_index, virtual_clock, verbose, binary_translator);
+            VR_Shutdown();
+            return result;
+        }
+        if (load)
+        {
+            int result = run_load_mode(ctx, left_index, right_index, extra_devices, load_options, binary_translator);
+            VR_Shutdown();
+            return result;
+        }
 
         printf("Soft Knuckles Debug Client Terminal\n");
         printf("-----------------------------------\n");
@@ -50,9 +294,32 @@ int main()
         printf("   l /input/system/click 0     # toggle system button on left controller\n");
         printf("   l /input/system/click 1\n\n");
         printf("   r pos 0 0 0                 # move right controller to 0,0,0\n");
-        printf("   r /input/joystick/x -1      # set right joystick position to -1\n");
+        printf("   r euler 90 0 0              # yaw right controller 90 degrees\n");
+        printf("   l hmd_follow -0.2 -0.3 -0.4 # keep left controller at an offset from the hmd\n");
+        printf("   r /input/thumbstick/x -1    # set right thumbstick position to -1\n");
         printf("   r /input/trigger/value 0.25 # set right trigger position to .25\n");
-        printf("   sleep 50                    # sleep for 50ms\n");
+        printf("   r ramp /input/trigger/value 1 500 inout 4  # sweep right trigger 0->1->0->1->0 in 500ms steps\n");
+        printf("   l pulse /input/a/click 1 100 # press left a button for 100ms\n");
+        printf("   r macro grab                # run the grab macro on the right controller\n");
+        printf("   l stats                     # command latency: count p50 p99 p99.9 max (us) for pose and input\n");
+        printf("   l stats reset\n");
+        printf("   l frames                    # per frame telemetry: frame interval, commands/poses/skeletons per frame\n");
+        printf("   l frames reset\n");
+        printf("   l record start c:\\temp\\left.sks # capture the left controller's commands to a binary log\n");
+        printf("   l record stop               # replies ok <records> <bytes>\n");
+        printf("   l replay start c:\\temp\\left.sks # play a captured log back at its original timing\n");
+        printf("   l replay stop\n");
+        printf("   l trace flush               # write out trace events, when the traceFile setting is set\n");
+        printf("   l clock                     # driver clock in ms, real or virtual\n");
+        printf("   l clock advance 50          # step a virtualClock driver forward 50ms\n");
+        printf("   l component /input/a/click  # the component's index and type, for binary requests\n");
+        printf("   l haptics                   # vibrations received, dropped, pending and their latency (us)\n");
+        printf("   l haptics pop 4             # take up to 4 captured vibrations: time_ms duration frequency amplitude\n");
+        printf("   l haptics reset\n");
+        printf("   l posethread                # pose tick jitter (us) and the thread's cpus, policy and priority\n");
+        printf("   l posethread reset\n");
+        printf("   l /input/a/click 1 +100     # with --binary: press left a button 100ms from now\n");
+        printf("   sleep 50                    # sleep for 50ms (advance the clock 50ms with --virtual)\n");
         printf("   quit\n");
         printf("\n");
         printf("ok\n");
@@ -85,8 +352,18 @@ int main()
                 }
                 else if (sscanf(cmd, "sleep %d", &sleep_ms) == 1)
                 {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(sleep_ms));
-                    printf("ok\n");
+                    if (virtual_clock)
+                    {
+                        char request[64];
+                        char response[256];
+                        snprintf(request, sizeof(request), "clock advance %d", sleep_ms);
+                        send_request(ctx, left_index, request, response, sizeof(response));
+                    }
+                    else
+                    {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(sleep_ms));
+                        printf("ok\n");
+                    }
                 }
                 else if (strncmp(cmd, "quit", 4) == 0)
                 {
@@ -109,7 +386,8 @@ int main()
                     {
                         // send either /input or pos commands to driver to process
                         char response[256];
-                        send_request(ctx, target, cmd+1, response, sizeof(response));
+                        const char *request = binary ? translator.Translate(target, cmd + 1) : cmd + 1;
+                        send_request(ctx, target, request, response, sizeof(response));
                     }
                     else
                     {
@@ -4,9 +4,15 @@
 // See header for description
 //
 #include "dprintf.h"
+#include "trace.h"
+#include "frame_telemetry.h"
+#include "driver_clock.h"
+#include "binary_command.h"
 #include "soft_knuckles_device.h"
 #include "soft_knuckles_debug_handler.h"
 #include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
 
 #if defined(_WIN32)
 #define strtok_r strtok_s
@@ -22,13 +28,23 @@ SoftKnucklesDebugHandler::SoftKnucklesDebugHandler()
 void SoftKnucklesDebugHandler::Init(SoftKnucklesDevice *d)
 {
     m_device = d;
+
+    // compile the macros from soft_knuckles/resources/settings/default.vrsettings
+    char buf[4096];
+    buf[0] = 0;
+    vr::VRSettings()->GetString(kSettingsSection, "macros", buf, sizeof(buf));
+    int num_macros = m_macros.DefineAll(buf, m_device->m_components->Index(), Hand());
+    DLOG_INFO("soft_knuckles %s macros: %d (%s)\n", Hand(), num_macros, m_macros.Names().c_str());
+}
+
+const char *SoftKnucklesDebugHandler::Hand() const
+{
+    return m_device->m_role == TrackedControllerRole_LeftHand ? "left" : "right";
 }
 
 void SoftKnucklesDebugHandler::SetPosition(double x, double y, double z)
 {
-    m_device->m_pose.vecPosition[0] = x;
-    m_device->m_pose.vecPosition[1] = y;
-    m_device->m_pose.vecPosition[2] = z;
+    m_device->SetPosition(x, y, z);
 }
 
 #if 0
@@ -212,7 +228,7 @@ static void listen_thread(KnucklesProvider *pthis)
 
 #endif
 
-static void tokenize(const char *const_input, const char *delim, vector<string> *ret)
+void tokenize(const char *const_input, const char *delim, vector<string> *ret)
 {
     char input[1024];
     strcpy(input, const_input);
@@ -243,93 +259,768 @@ static void set_response(const char *response_source, char *response, uint32_t r
     }
 }
 
-void SoftKnucklesDebugHandler::InitializeLookupTable()
+// parses "qw qx qy qz [tx ty tz]" starting at tokens[first]
+static bool parse_transform(const vector<string> &tokens, size_t first, RigidTransform *transform)
+{
+    size_t count = tokens.size() - first;
+    if (count != 4 && count != 7)
+        return false;
+    *transform = rigid_identity();
+    transform->rotation = quat(atof(tokens[first].c_str()), atof(tokens[first + 1].c_str()),
+                               atof(tokens[first + 2].c_str()), atof(tokens[first + 3].c_str()));
+    if (count == 7)
+    {
+        transform->translation[0] = atof(tokens[first + 4].c_str());
+        transform->translation[1] = atof(tokens[first + 5].c_str());
+        transform->translation[2] = atof(tokens[first + 6].c_str());
+    }
+    return true;
+}
+
+// parses a duration in ms into ns.  rejects tokens that aren't entirely a number,
+// negatives, and values too large to fit.
+static bool parse_duration_ns(const string &token, uint64_t *ns)
+{
+    char *end;
+    double ms = strtod(token.c_str(), &end);
+    if (end == token.c_str() || *end != '\0' || !(ms >= 0.0 && ms <= 1e12))
+        return false;
+    *ns = (uint64_t)(ms * 1e6);
+    return true;
+}
+
+// parses a generator repeat count: 0 or more
+static bool parse_repeat(const string &token, uint32_t *repeat)
+{
+    char *end;
+    long value = strtol(token.c_str(), &end, 10);
+    if (end == token.c_str() || *end != '\0' || value < 0 || value > 0x7fffffffL)
+        return false;
+    *repeat = (uint32_t)value;
+    return true;
+}
+
+// rot <qw> <qx> <qy> <qz>                         set the controller orientation
+// euler <yaw> <pitch> <roll>                      same, in degrees (yaw about y, pitch about x, roll about z)
+// world_from_driver <qw> <qx> <qy> <qz> [tx ty tz]
+// driver_from_head <qw> <qx> <qy> <qz> [tx ty tz]
+// hmd_follow <x> <y> <z> [qw qx qy qz]            keep the controller at a fixed offset from the hmd
+// hmd_follow off
+bool SoftKnucklesDebugHandler::OrientationRequest(const vector<string> &tokens)
+{
+    const string &verb = tokens[0];
+    if (verb == "rot" && tokens.size() == 5)
+    {
+        RigidTransform t;
+        parse_transform(tokens, 1, &t);
+        m_device->SetRotation(t.rotation);
+        return true;
+    }
+    if (verb == "euler" && tokens.size() == 4)
+    {
+        m_device->SetRotation(quat_from_euler_degrees(
+            atof(tokens[1].c_str()), atof(tokens[2].c_str()), atof(tokens[3].c_str())));
+        return true;
+    }
+    if (verb == "world_from_driver" || verb == "driver_from_head")
+    {
+        RigidTransform t;
+        if (!parse_transform(tokens, 1, &t))
+            return false;
+        if (verb == "world_from_driver")
+            m_device->SetWorldFromDriver(t);
+        else
+            m_device->SetDriverFromHead(t);
+        return true;
+    }
+    if (verb == "hmd_follow")
+    {
+        if (tokens.size() == 2 && tokens[1] == "off")
+        {
+            m_device->SetHmdFollow(false, rigid_identity());
+            return true;
+        }
+        if (tokens.size() == 4 || tokens.size() == 8)
+        {
+            RigidTransform offset = rigid_identity();
+            offset.translation[0] = atof(tokens[1].c_str());
+            offset.translation[1] = atof(tokens[2].c_str());
+            offset.translation[2] = atof(tokens[3].c_str());
+            if (tokens.size() == 8)
+            {
+                offset.rotation = quat(atof(tokens[4].c_str()), atof(tokens[5].c_str()),
+                                       atof(tokens[6].c_str()), atof(tokens[7].c_str()));
+            }
+            m_device->SetHmdFollow(true, offset);
+            return true;
+        }
+    }
+    DLOG_WARN_LIMITED(10, 10, "bad arguments for %s\n", verb.c_str());
+    return false;
+}
+
+bool SoftKnucklesDebugHandler::LookupComponent(const string &path, uint32_t *index)
+{
+    if (!m_device->m_components->Lookup(path, index))
+    {
+        DLOG_WARN_LIMITED(10, 10, "could not find component named %s\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+// ramp <path> <target> <duration_ms> [easing] [repeat]
+//   easing is one of linear (default), in, out, inout, sine.
+//   repeat defaults to 1; 0 sweeps back and forth until stopped.
+// pulse <path> <value> <duration_ms> [period_ms] [repeat]
+//   period defaults to twice the duration.  repeat defaults to 1; 0 runs until stopped.
+//   negative or non-numeric durations, periods and repeat counts fail.
+// stop <path>|all
+bool SoftKnucklesDebugHandler::GeneratorRequest(const vector<string> &tokens)
+{
+    const string &verb = tokens[0];
+    if (verb == "stop")
+    {
+        if (tokens[1] == "all")
+        {
+            m_device->m_generators.StopAll();
+            return true;
+        }
+        uint32_t index;
+        if (!LookupComponent(tokens[1], &index))
+            return false;
+        m_device->m_generators.Stop(index);
+        return true;
+    }
+
+    if (tokens.size() < 4)
+    {
+        DLOG_WARN_LIMITED(10, 10, "not enough arguments for %s\n", verb.c_str());
+        return false;
+    }
+
+    uint32_t index;
+    if (!LookupComponent(tokens[1], &index))
+        return false;
+    ComponentType component_type = m_device->m_component_definitions[index].component_type;
+    if (component_type != CT_SCALAR && component_type != CT_BOOLEAN)
+    {
+        DLOG_WARN_LIMITED(10, 10, "%s is not a scalar or boolean component\n", tokens[1].c_str());
+        return false;
+    }
+
+    float value = (float)atof(tokens[2].c_str());
+    uint64_t duration_ns;
+    if (!parse_duration_ns(tokens[3], &duration_ns))
+    {
+        DLOG_WARN_LIMITED(10, 10, "bad duration %s\n", tokens[3].c_str());
+        return false;
+    }
+    uint32_t repeat = 1;
+    if (tokens.size() > 5 && !parse_repeat(tokens[5], &repeat))
+    {
+        DLOG_WARN_LIMITED(10, 10, "bad repeat count %s\n", tokens[5].c_str());
+        return false;
+    }
+    float current = m_device->GetComponentValue(index);
+    uint64_t now = pose_history_now_ns();
+
+    if (verb == "ramp")
+    {
+        GeneratorEasing easing = EASE_LINEAR;
+        if (tokens.size() > 4 && !parse_easing(tokens[4].c_str(), &easing))
+        {
+            DLOG_WARN_LIMITED(10, 10, "unknown easing %s\n", tokens[4].c_str());
+            return false;
+        }
+        return m_device->m_generators.StartRamp(index, current, value, now, duration_ns, easing, repeat);
+    }
+    else
+    {
+        uint64_t period_ns = 2 * duration_ns;
+        if (tokens.size() > 4 && !parse_duration_ns(tokens[4], &period_ns))
+        {
+            DLOG_WARN_LIMITED(10, 10, "bad period %s\n", tokens[4].c_str());
+            return false;
+        }
+        return m_device->m_generators.StartPulse(index, current, value, now, duration_ns, period_ns, repeat);
+    }
+}
+
+// macro <name>                                   queue the macro's steps, timed from now
+// macro_define <name> <path> <value> <offset_ms> ...
+// macro_delete <name>
+// macros                                         replies with the defined names
+bool SoftKnucklesDebugHandler::MacroRequest(const vector<string> &tokens, string *reply)
+{
+    const string &verb = tokens[0];
+    if (verb == "macros")
+    {
+        *reply = "ok " + m_macros.Names();
+        return true;
+    }
+    if (tokens.size() < 2)
+    {
+        DLOG_WARN_LIMITED(10, 10, "%s needs a macro name\n", verb.c_str());
+        return false;
+    }
+    if (verb == "macro_define")
+    {
+        return m_macros.Define(tokens[1], tokens, 2, m_device->m_components->Index(), Hand());
+    }
+    if (verb == "macro_delete")
+    {
+        return m_macros.Remove(tokens[1]);
+    }
+
+    const vector<MacroStep> *steps = m_macros.Find(tokens[1]);
+    if (!steps)
+    {
+        DLOG_WARN_LIMITED(10, 10, "no macro named %s\n", tokens[1].c_str());
+        return false;
+    }
+
+    InputEvent events[InputEventQueue::kCapacity];
+    if (steps->size() > InputEventQueue::kCapacity)
+        return false;
+    uint64_t now = pose_history_now_ns();
+    for (size_t i = 0; i < steps->size(); i++)
+    {
+        const MacroStep &step = (*steps)[i];
+        events[i].due_ns = now + (uint64_t)step.offset_us * 1000;
+        events[i].component_index = step.component_index;
+        events[i].value = step.value;
+    }
+    if (!m_device->m_event_queue.Push(events, (uint32_t)steps->size()))
+    {
+        DLOG_WARN_LIMITED(10, 10, "event queue full, dropped macro %s\n", tokens[1].c_str());
+        return false;
+    }
+    return true;
+}
+
+// history
+//   replies with the window of recorded poses: ok <oldest_us> <newest_us> <count>
+bool SoftKnucklesDebugHandler::HistoryRequest(const vector<string> &tokens, string *reply)
+{
+    uint64_t oldest_ns, newest_ns, count;
+    if (!m_device->m_pose_history.GetWindow(&oldest_ns, &newest_ns, &count))
+    {
+        DLOG_WARN_LIMITED(10, 10, "pose history is empty\n");
+        return false;
+    }
+    char buf[128];
+    snprintf(buf, sizeof(buf), "ok %llu %llu %llu",
+        (unsigned long long)(oldest_ns / 1000), (unsigned long long)(newest_ns / 1000), (unsigned long long)count);
+    *reply = buf;
+    return true;
+}
+
+// pose_at <t_us>
+//   replies with the pose interpolated at t_us on the driver's monotonic clock.
+//   a negative t_us is relative to now, e.g. "pose_at -50000" is 50ms ago.
+//   ok <t_us> <x> <y> <z> <qw> <qx> <qy> <qz>
+bool SoftKnucklesDebugHandler::PoseAtRequest(const vector<string> &tokens, string *reply)
+{
+    if (tokens.size() != 2)
+    {
+        DLOG_WARN_LIMITED(10, 10, "usage: pose_at <t_us>\n");
+        return false;
+    }
+
+    long long t_us = atoll(tokens[1].c_str());
+    if (t_us < 0)
+    {
+        t_us += (long long)(pose_history_now_ns() / 1000);
+    }
+
+    DriverPose_t pose;
+    if (t_us < 0 || !m_device->m_pose_history.Sample((uint64_t)t_us * 1000, &pose))
+    {
+        DLOG_WARN_LIMITED(10, 10, "pose_at %lld is outside of the recorded window\n", t_us);
+        return false;
+    }
+
+    char buf[256];
+    snprintf(buf, sizeof(buf), "ok %lld %f %f %f %f %f %f %f", t_us,
+        pose.vecPosition[0], pose.vecPosition[1], pose.vecPosition[2],
+        pose.qRotation.w, pose.qRotation.x, pose.qRotation.y, pose.qRotation.z);
+    *reply = buf;
+    return true;
+}
+
+// stats
+//   replies with the command latency histograms, times in microseconds:
+//   ok pose <count> <p50> <p99> <p99.9> <max> input <count> <p50> <p99> <p99.9> <max>
+// stats reset
+//   clears them
+bool SoftKnucklesDebugHandler::StatsRequest(const vector<string> &tokens, string *reply)
+{
+    CommandLatency &latency = m_device->m_command_latency;
+    if (tokens.size() == 2 && tokens[1] == "reset")
+    {
+        latency.pose.Reset();
+        latency.input.Reset();
+        return true;
+    }
+    if (tokens.size() != 1)
+        return false;
+    *reply = "ok pose " + latency.pose.Summary() + " input " + latency.input.Summary();
+    return true;
+}
+
+// frames
+//   replies with the per frame telemetry since the last reset, times in microseconds:
+//   ok frames <n> interval <count> <p50> <p99> <p99.9> <max>
+//      commands <total> <max/frame> poses <total> <max/frame> <frames without one> skeletons <total> <max/frame>
+//   counts are driver wide, not per device.
+// frames reset
+//   clears it
+bool SoftKnucklesDebugHandler::FramesRequest(const vector<string> &tokens, string *reply)
+{
+    if (tokens.size() == 2 && tokens[1] == "reset")
+    {
+        g_frame_telemetry.Reset();
+        return true;
+    }
+    if (tokens.size() != 1)
+        return false;
+    *reply = "ok " + g_frame_telemetry.Summary();
+    return true;
+}
+
+// clock
+//   replies ok <driver clock in ms> real|virtual
+// clock advance <ms>
+//   virtualClock only: moves the clock forward, running every pose tick on the way.
+//   returns once the devices have caught up.  fails in real time.
+bool SoftKnucklesDebugHandler::ClockRequest(const vector<string> &tokens, string *reply)
+{
+    if (tokens.size() == 3 && tokens[1] == "advance")
+    {
+        double ms = atof(tokens[2].c_str());
+        if (ms < 0)
+            return false;
+        return clock_advance((uint64_t)(ms * 1e6));
+    }
+    if (tokens.size() != 1)
+        return false;
+    char buf[64];
+    snprintf(buf, sizeof(buf), "ok %.3f %s", clock_now_ns() / 1e6, clock_is_virtual() ? "virtual" : "real");
+    *reply = buf;
+    return true;
+}
+
+// record start <path>
+//   captures every component update and position / rotation command this device gets
+//   into a binary session log (see session_log.h)
+// record stop
+//   replies ok <records> <bytes>
+bool SoftKnucklesDebugHandler::RecordRequest(const vector<string> &tokens, string *reply)
+{
+    if (tokens.size() == 3 && tokens[1] == "start")
+    {
+        return m_device->m_session_recorder.Start(tokens[2].c_str(), m_device->m_num_component_definitions,
+            pose_history_now_ns());
+    }
+    uint64_t records, bytes;
+    if (tokens.size() == 2 && tokens[1] == "stop" && m_device->m_session_recorder.Stop(&records, &bytes))
+    {
+        *reply = "ok " + to_string(records) + " " + to_string(bytes);
+        return true;
+    }
+    return false;
+}
+
+// replay start <path>
+//   plays a session log back into this device from the pose thread, at its recorded timing.
+//   fails if the log came from a device with different components.
+// replay stop
+// replay
+//   replies ok <records played> playing|stopped
+bool SoftKnucklesDebugHandler::ReplayRequest(const vector<string> &tokens, string *reply)
+{
+    SessionReplay &replay = m_device->m_session_replay;
+    if (tokens.size() == 3 && tokens[1] == "start")
+    {
+        return replay.Start(tokens[2].c_str(), m_device->m_num_component_definitions, pose_history_now_ns());
+    }
+    if (tokens.size() == 2 && tokens[1] == "stop")
+    {
+        replay.Stop();
+        return true;
+    }
+    if (tokens.size() != 1)
+        return false;
+    *reply = "ok " + to_string(replay.RecordsPlayed()) + (replay.Active() ? " playing" : " stopped");
+    return true;
+}
+
+// trace flush
+//   appends the trace events recorded so far to the traceFile.  replies ok <events written>.
+//   fails if tracing is off.
+bool SoftKnucklesDebugHandler::TraceRequest(const vector<string> &tokens, string *reply)
+{
+    if (tokens.size() != 2 || tokens[1] != "flush" || !trace_enabled())
+        return false;
+    *reply = "ok " + to_string(trace_flush());
+    return true;
+}
+
+// sets a boolean, scalar or skeleton component the way the text request "<path> <value>" does:
+// a direct update takes over from any ramp or pulse running on the component.
+// for a skeleton 0 is an open hand and 1 is a fist.
+bool SoftKnucklesDebugHandler::SetComponent(uint32_t index, float value, uint64_t arrival_ns)
+{
+    const KnuckleComponentDefinition &definition = m_device->m_component_definitions[index];
+    ComponentType component_type = definition.component_type;
+    if (component_type == CT_BOOLEAN || component_type == CT_SCALAR)
+    {
+        m_device->m_generators.Stop(index);
+    }
+    if (component_type == CT_BOOLEAN)
+    {
+        value = value != 0.0f ? 1.0f : 0.0f;
+    }
+    else if (component_type != CT_SCALAR && component_type != CT_SKELETON)
+    {
+        DLOG_WARN_LIMITED(10, 10, "%s can't be set\n", definition.full_path);
+        return false;
+    }
+
+    DLOG_TRACE("setting %s to %f\n", definition.full_path, value);
+    EVRInputError err = m_device->UpdateComponentValue(index, value);
+    if (err != VRInputError_None)
+    {
+        DLOG_ERROR_LIMITED(10, 10, "error %d\n", err);
+        return false;
+    }
+    if (component_type == CT_SKELETON)
+    {
+        SoftKnucklesDevice::NotePendingCommand(&m_device->m_pending_skeleton_command_ns, arrival_ns);
+    }
+    else
+    {
+        m_device->m_command_latency.input.Record(pose_history_now_ns() - arrival_ns);
+    }
+    return true;
+}
+
+// queues a boolean, scalar or skeleton update for the pose thread to apply at due_ns.
+// like SetComponent it takes over from any ramp or pulse, which stops now rather than
+// when the update lands, so the generator can't overwrite it.
+bool SoftKnucklesDebugHandler::QueueComponent(uint32_t index, float value, uint64_t due_ns)
+{
+    const KnuckleComponentDefinition &definition = m_device->m_component_definitions[index];
+    ComponentType component_type = definition.component_type;
+    if (component_type != CT_BOOLEAN && component_type != CT_SCALAR && component_type != CT_SKELETON)
+    {
+        DLOG_WARN_LIMITED(10, 10, "%s can't be set\n", definition.full_path);
+        return false;
+    }
+    InputEvent event;
+    event.due_ns = due_ns;
+    event.component_index = index;
+    event.value = value;
+    if (component_type == CT_BOOLEAN)
+        event.value = value != 0.0f ? 1.0f : 0.0f;
+    if (!m_device->m_event_queue.Push(&event, 1))
+    {
+        DLOG_WARN_LIMITED(10, 10, "event queue full, dropped update to %s\n", definition.full_path);
+        return false;
+    }
+    if (component_type != CT_SKELETON)
+        m_device->m_generators.Stop(index);
+    return true;
+}
+
+// component <path>
+//   replies ok <index> <type> where type is boolean, scalar, skeleton or haptic.
+//   binary commands name components by this index (see binary_command.h).
+bool SoftKnucklesDebugHandler::ComponentRequest(const vector<string> &tokens, string *reply)
+{
+    static const char *const kTypeNames[] = { "boolean", "scalar", "skeleton", "haptic" };
+    uint32_t index;
+    if (tokens.size() != 2 || !LookupComponent(tokens[1], &index))
+        return false;
+    *reply = "ok " + to_string(index) + " " + kTypeNames[m_device->m_component_definitions[index].component_type];
+    return true;
+}
+
+// a binary request (see binary_command.h).  the whole batch is checked before any of it
+// is applied: every component must exist, be settable and have a handle.  commands then
+// run in order, delayed component commands going on the input event queue.  returns the
+// number of commands applied, or 0 on failure.  only the checks are all or nothing: if the
+// host rejects an update or the queue is full the request fails there, the commands
+// before it stay applied or queued and none after it run.
+uint32_t SoftKnucklesDebugHandler::BinaryRequest(const char *request, uint64_t arrival_ns)
+{
+    BinaryCommand commands[kMaxBinaryCommands];
+    uint32_t count;
+    if (!decode_binary_request(request, commands, kMaxBinaryCommands, &count) || count == 0)
+    {
+        DLOG_WARN_LIMITED(10, 10, "malformed binary request\n");
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const BinaryCommand &command = commands[i];
+        if (command.op != BINARY_OP_COMPONENT)
+            continue;
+        // handles only exist once the device is activated
+        uint32_t index = command.component_index;
+        ComponentType type = index < m_device->m_num_component_definitions ?
+            m_device->m_component_definitions[index].component_type : CT_HAPTIC;
+        if ((type != CT_BOOLEAN && type != CT_SCALAR && type != CT_SKELETON) ||
+            index >= m_device->m_component_handles.size() ||
+            m_device->m_component_handles[index] == k_ulInvalidInputComponentHandle)
+        {
+            DLOG_WARN_LIMITED(10, 10, "binary request for bad component %u\n", command.component_index);
+            return 0;
+        }
+    }
+
+    bool pose_changed = false;
+    uint32_t applied = 0;
+    for (; applied < count; applied++)
+    {
+        const BinaryCommand &command = commands[applied];
+        bool ok = true;
+        switch (command.op)
+        {
+        case BINARY_OP_COMPONENT:
+            if (command.delay_us)
+                ok = QueueComponent(command.component_index, command.value, arrival_ns + (uint64_t)command.delay_us * 1000);
+            else
+                ok = SetComponent(command.component_index, command.value, arrival_ns);
+            break;
+        case BINARY_OP_POSITION:
+            SetPosition(command.v[0], command.v[1], command.v[2]);
+            pose_changed = true;
+            break;
+        case BINARY_OP_ROTATION:
+            m_device->SetRotation(quat(command.v[0], command.v[1], command.v[2], command.v[3]));
+            pose_changed = true;
+            break;
+        }
+        if (!ok)
+        {
+            DLOG_WARN_LIMITED(10, 10, "binary request failed at command %u of %u\n", applied + 1, count);
+            break;
+        }
+    }
+    if (pose_changed)
+    {
+        SoftKnucklesDevice::NotePendingCommand(&m_device->m_pending_pose_command_ns, arrival_ns);
+    }
+    return applied == count ? count : 0;
+}
+
+// haptics
+//   replies ok <received> <dropped> <pending> <count> <p50> <p99> <p99.9> <max>, the last five being
+//   how long (us) the host held each vibration before RunFrame picked it up
+// haptics pop [n]
+//   removes up to n (default 1, at most 8) captured vibrations, oldest first.
+//   replies ok <count> followed by <receive_ms> <duration_s> <frequency> <amplitude> for each
+// haptics reset
+bool SoftKnucklesDebugHandler::HapticsRequest(const vector<string> &tokens, string *reply)
 {
-    m_inputstring2index.reserve(m_device->m_num_component_definitions);
-    for (uint32_t i = 0; i < m_device->m_num_component_definitions; i++)
+    static const uint32_t kMaxPop = 8;
+    HapticRing &haptics = m_device->m_haptics;
+    if (tokens.size() == 1)
     {
-        m_inputstring2index[m_device->m_component_definitions[i].full_path] = i;
+        *reply = "ok " + haptics.Summary();
+        return true;
     }
+    if (tokens.size() == 2 && tokens[1] == "reset")
+    {
+        haptics.Reset();
+        return true;
+    }
+    if ((tokens.size() == 2 || tokens.size() == 3) && tokens[1] == "pop")
+    {
+        uint32_t max_events = tokens.size() == 3 ? (uint32_t)atoi(tokens[2].c_str()) : 1;
+        if (max_events < 1 || max_events > kMaxPop)
+            return false;
+        HapticEvent events[kMaxPop];
+        uint32_t count = haptics.Pop(events, max_events);
+        *reply = "ok " + to_string(count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            char buf[96];
+            snprintf(buf, sizeof(buf), " %.3f %g %g %g", events[i].receive_ns / 1e6,
+                events[i].duration_seconds, events[i].frequency, events[i].amplitude);
+            *reply += buf;
+        }
+        return true;
+    }
+    return false;
+}
+
+// posethread
+//   replies with how the pose thread is tuned and how late it wakes for its
+//   ticks, times in microseconds:
+//   ok jitter <count> <p50> <p99> <p99.9> <max> cpus=<list> policy=<policy> priority=<n>
+//   (not_started in place of the settings until the thread has applied them)
+// posethread reset
+//   clears the jitter histogram
+bool SoftKnucklesDebugHandler::PoseThreadRequest(const vector<string> &tokens, string *reply)
+{
+    if (tokens.size() == 2 && tokens[1] == "reset")
+    {
+        m_device->m_pose_jitter.Reset();
+        return true;
+    }
+    if (tokens.size() != 1)
+        return false;
+    string applied;
+    {
+        lock_guard<mutex> lock(m_device->m_pose_mutex);
+        applied = m_device->m_pose_thread_applied;
+    }
+    *reply = "ok jitter " + m_device->m_pose_jitter.Summary() + " " + (applied.empty() ? "not_started" : applied);
+    return true;
 }
 
 void SoftKnucklesDebugHandler::DebugRequest(const char *request, char *response, uint32_t response_buffer_size)
 {
-    if (m_inputstring2index.size() == 0)
-        InitializeLookupTable();
+    uint64_t arrival_ns = pose_history_now_ns();
+
+    if (is_binary_request(request))
+    {
+        uint32_t applied = BinaryRequest(request, arrival_ns);
+        if (applied)
+        {
+            g_frame_telemetry.commands.Add(applied);
+            char reply[32];
+            snprintf(reply, sizeof(reply), "ok %u", applied);
+            set_response(reply, response, response_buffer_size);
+        }
+        else
+        {
+            set_response("fail", response, response_buffer_size);
+        }
+        return;
+    }
 
-    dprintf("device_id %d received request: %s\n", m_device->m_id, request);
+    DLOG_DEBUG_LIMITED(50, 100, "device_id %d received request: %s\n", m_device->m_id, request);
 
     vector<string> tokens;
     tokenize(request, " \r\t\n,", &tokens);
     bool success = false;
-    if (tokens.size() > 1) // need at least two params
+    string reply;
+    if (tokens.size() > 0 && tokens[0] == "stats")
+    {
+        success = StatsRequest(tokens, &reply);
+    }
+    else if (tokens.size() > 0 && tokens[0] == "frames")
+    {
+        success = FramesRequest(tokens, &reply);
+    }
+    else if (tokens.size() > 0 && tokens[0] == "clock")
+    {
+        success = ClockRequest(tokens, &reply);
+    }
+    else if (tokens.size() > 0 && tokens[0] == "record")
+    {
+        success = RecordRequest(tokens, &reply);
+    }
+    else if (tokens.size() > 0 && tokens[0] == "replay")
+    {
+        success = ReplayRequest(tokens, &reply);
+    }
+    else if (tokens.size() > 0 && tokens[0] == "haptics")
+    {
+        success = HapticsRequest(tokens, &reply);
+    }
+    else if (tokens.size() > 0 && tokens[0] == "posethread")
+    {
+        success = PoseThreadRequest(tokens, &reply);
+    }
+    else if (tokens.size() > 0 && tokens[0] == "component")
+    {
+        success = ComponentRequest(tokens, &reply);
+    }
+    else if (tokens.size() > 0 && tokens[0] == "trace")
+    {
+        success = TraceRequest(tokens, &reply);
+    }
+    else if (tokens.size() > 0 && tokens[0] == "history")
+    {
+        success = HistoryRequest(tokens, &reply);
+    }
+    else if (tokens.size() > 0 && tokens[0] == "pose_at")
+    {
+        success = PoseAtRequest(tokens, &reply);
+    }
+    else if (tokens.size() > 0 && (tokens[0] == "macro" || tokens[0] == "macro_define" ||
+                                   tokens[0] == "macro_delete" || tokens[0] == "macros"))
+    {
+        success = MacroRequest(tokens, &reply);
+    }
+    else if (tokens.size() > 1 && (tokens[0] == "ramp" || tokens[0] == "pulse" || tokens[0] == "stop"))
+    {
+        success = GeneratorRequest(tokens);
+    }
+    else if (tokens.size() > 1) // need at least two params
     {
         if (tokens[0] == "pos")
         {
             // set the position of this controller
-            double x = atof(tokens[1].c_str());;
-            double y = atof(tokens[2].c_str());;
-            double z = atof(tokens[3].c_str());;
-            m_device->m_pose.vecPosition[0] = x;
-            m_device->m_pose.vecPosition[1] = y;
-            m_device->m_pose.vecPosition[2] = z;
-            // the controller has an update thread, so it'll get posted on the next update
-            success = true;
+            if (tokens.size() == 4)
+            {
+                double x = atof(tokens[1].c_str());
+                double y = atof(tokens[2].c_str());
+                double z = atof(tokens[3].c_str());
+                SetPosition(x, y, z);
+                // the controller has an update thread, so it'll get posted on the next update
+                SoftKnucklesDevice::NotePendingCommand(&m_device->m_pending_pose_command_ns, arrival_ns);
+                success = true;
+            }
+        }
+        else if (tokens[0] == "rot" || tokens[0] == "euler" || tokens[0] == "world_from_driver" ||
+                 tokens[0] == "driver_from_head" || tokens[0] == "hmd_follow")
+        {
+            success = OrientationRequest(tokens);
+            if (success)
+            {
+                SoftKnucklesDevice::NotePendingCommand(&m_device->m_pending_pose_command_ns, arrival_ns);
+            }
         }
         else
         {
-            // tokens[0] is an input state path
-            string input_state_path = tokens[0];
-            auto iter = m_inputstring2index.find(input_state_path);
-            if (iter != m_inputstring2index.end())
+            // tokens[0] is an input state path, optionally followed by +<delay_ms>
+            uint32_t index;
+            uint64_t delay_ns = 0;
+            if (tokens.size() > 3 || (tokens.size() == 3 &&
+                (tokens[2][0] != '+' || !parse_duration_ns(tokens[2].substr(1), &delay_ns))))
             {
-                uint32_t index = (*iter).second;
-                VRInputComponentHandle_t component_handle = m_device->m_component_handles[index];
-                ComponentType component_type = m_device->m_component_definitions[index].component_type;
-                if (component_type == CT_BOOLEAN)
-                {
-                    bool new_value = (tokens[1] == "1");
-                    dprintf("setting %s to %d\n", input_state_path.c_str(), new_value);
-                    EVRInputError err = vr::VRDriverInput()->UpdateBooleanComponent(component_handle, new_value, 0);
-                    if (err != VRInputError_None)
-                    {
-                        dprintf("error %d\n", err);
-                        success = false;
-                    }
-                    else
-                    {
-                        success = true;
-                    }
-                }
-                else if (component_type == CT_SCALAR)
-                {
-                    float new_value = (float)atof(tokens[1].c_str());
-                    dprintf("setting %s to %f\n", input_state_path.c_str(), new_value);
-                    EVRInputError err = vr::VRDriverInput()->UpdateScalarComponent(component_handle, new_value, 0);
-                    if (err != VRInputError_None)
-                    {
-                        dprintf("error %d\n", err);
-                    }
-                    else
-                    {
-                        success = true;
-                    }
-                }
+                DLOG_WARN_LIMITED(10, 10, "bad delay in %s (expected +<ms>)\n", request);
             }
-            else
+            else if (LookupComponent(tokens[0], &index))
             {
-                dprintf("could not find component named %s\n", input_state_path.c_str());
+                float new_value;
+                if (m_device->m_component_definitions[index].component_type == CT_BOOLEAN)
+                    new_value = tokens[1] == "1" ? 1.0f : 0.0f;
+                else
+                    new_value = (float)atof(tokens[1].c_str());
+                if (tokens.size() == 3)
+                    success = QueueComponent(index, new_value, arrival_ns + delay_ns);
+                else
+                    success = SetComponent(index, new_value, arrival_ns);
             }
         }
     }
     else
     {
-        dprintf("not enough tokens: %d\n", tokens.size());
+        DLOG_WARN_LIMITED(10, 10, "not enough tokens: %d\n", tokens.size());
     }
 
     if (success)
     {
-        set_response("ok", response, response_buffer_size);
+        g_frame_telemetry.commands.Add();
+        set_response(reply.empty() ? "ok" : reply.c_str(), response, response_buffer_size);
     }
     else
     {
@@ -7,22 +7,30 @@
 // requests to change input component states.
 //
 // This module uses the DebugRequest mechanism provided by 
-// ITrackedDeviceServerDriver and uses the input configuration provided by
-// soft_knuckles_config.h
+// ITrackedDeviceServerDriver and resolves input source paths through the
+// device's ComponentTable (component_table.h)
 //
 // See soft_knuckles_debug_client.cpp for an example client.
 //
+#pragma once
 #include <openvr_driver.h>
-#include <unordered_map>
+#include <string>
+#include <vector>
+#include "input_macro.h"
 
 class SoftKnucklesDevice;
 
 namespace soft_knuckles
 {
+    // splits input on any of the characters in delim.  input must be shorter than 1024 characters.
+    void tokenize(const char *input, const char *delim, std::vector<std::string> *tokens);
+
     class SoftKnucklesDebugHandler
     {
+        friend struct BenchmarkAccess;     // soft_knuckles_benchmarks
+
         SoftKnucklesDevice *m_device;
-        std::unordered_map<std::string, uint32_t> m_inputstring2index;
+        MacroTable m_macros;
 
     public:
         SoftKnucklesDebugHandler();
@@ -31,8 +39,26 @@ namespace soft_knuckles
         void DebugRequest(const char *pchRequest, char *pchResponseBuffer, uint32_t unResponseBufferSize);
 
     private:
-        void InitializeLookupTable();
         void SetPosition(double x, double y, double z);
+        bool HistoryRequest(const std::vector<std::string> &tokens, std::string *reply);
+        bool PoseAtRequest(const std::vector<std::string> &tokens, std::string *reply);
+        bool StatsRequest(const std::vector<std::string> &tokens, std::string *reply);
+        bool FramesRequest(const std::vector<std::string> &tokens, std::string *reply);
+        bool ClockRequest(const std::vector<std::string> &tokens, std::string *reply);
+        bool RecordRequest(const std::vector<std::string> &tokens, std::string *reply);
+        bool ReplayRequest(const std::vector<std::string> &tokens, std::string *reply);
+        bool TraceRequest(const std::vector<std::string> &tokens, std::string *reply);
+        bool ComponentRequest(const std::vector<std::string> &tokens, std::string *reply);
+        bool HapticsRequest(const std::vector<std::string> &tokens, std::string *reply);
+        bool PoseThreadRequest(const std::vector<std::string> &tokens, std::string *reply);
+        uint32_t BinaryRequest(const char *request, uint64_t arrival_ns);
+        bool SetComponent(uint32_t index, float value, uint64_t arrival_ns);
+        bool QueueComponent(uint32_t index, float value, uint64_t due_ns);
+        bool OrientationRequest(const std::vector<std::string> &tokens);
+        bool GeneratorRequest(const std::vector<std::string> &tokens);
+        bool LookupComponent(const std::string &path, uint32_t *index);
+        bool MacroRequest(const std::vector<std::string> &tokens, std::string *reply);
+        const char *Hand() const;
 
     };
 };
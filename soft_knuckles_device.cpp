@@ -16,6 +16,9 @@
 #include <vector>
 #include <string>
 #include "dprintf.h"
+#include "trace.h"
+#include "frame_telemetry.h"
+#include "driver_clock.h"
 
 #include "soft_knuckles_device.h"
 #include "soft_knuckles_config.h"
@@ -32,9 +35,15 @@ SoftKnucklesDevice::SoftKnucklesDevice()
             m_driver_context(nullptr),
             m_tracked_device_container(k_unTrackedDeviceIndexInvalid),
             m_role(TrackedControllerRole_Invalid),
-            m_running(false)
+            m_pose_update_interval_us(kDefaultPoseUpdateIntervalUs),
+            m_haptic_component(k_ulInvalidInputComponentHandle),
+            m_running(false),
+            m_skeleton_demo(true),
+            m_skeleton_dirty(false),
+            m_pending_pose_command_ns(0),
+            m_pending_skeleton_command_ns(0)
     {
-        dprintf("SoftKnucklesDevice::SoftKnucklesDevice\n");
+        DLOG_INFO("SoftKnucklesDevice::SoftKnucklesDevice\n");
         m_pose = { 0 };
         m_pose.poseIsValid = true;
         m_pose.result = vr::TrackingResult_Running_OK;
@@ -48,23 +57,35 @@ SoftKnucklesDevice::SoftKnucklesDevice()
         m_pose.qDriverFromHeadRotation.y = 0;
         m_pose.qDriverFromHeadRotation.z = 0;
 
+        m_pose.qRotation.w = 1;
+
         m_pose.vecPosition[0] = 0;
         m_pose.vecPosition[1] = -.5;
         m_pose.vecPosition[2] = -1.5;
+
+        m_hmd_follow.enabled = false;
+        m_hmd_follow.offset = rigid_identity();
+        m_hmd_follow.driver_from_world = rigid_identity();
     }
 
 void SoftKnucklesDevice::Init(
     ETrackedControllerRole role,
-    const KnuckleComponentDefinition *component_definitions,
-    uint32_t num_component_definitions,
+    std::shared_ptr<const ComponentTable> components,
     SoftKnucklesDebugHandler *debug_handler)
 {
-    dprintf("SoftKnucklesDevice::Init for role: %d num_definitions %d\n", role, num_component_definitions);
+    uint32_t num_component_definitions = components->Count();
+    DLOG_INFO("SoftKnucklesDevice::Init for role: %d num_definitions %d\n", role, num_component_definitions);
 
-    m_component_definitions = component_definitions;
+    m_components = components;
+    m_component_definitions = components->Definitions();
     m_num_component_definitions = num_component_definitions;
     m_debug_handler = debug_handler;
     m_role = role;
+    m_component_values.reset(new atomic<float>[num_component_definitions]);
+    for (uint32_t i = 0; i < num_component_definitions; i++)
+    {
+        m_component_values[i] = 0.0f;
+    }
 
     // look up config from soft_knuckles/resources/settings/default.vrsettings.  
     char buf[1024];
@@ -72,21 +93,34 @@ void SoftKnucklesDevice::Init(
     m_serial_number = buf;
     vr::VRSettings()->GetString(kSettingsSection, "modelNumber", buf, sizeof(buf));
     m_model_number = buf;
+    int32_t interval_us = vr::VRSettings()->GetInt32(kSettingsSection, "poseUpdateIntervalUs");
+    if (interval_us > 0)
+    {
+        m_pose_update_interval_us = interval_us;
+    }
+    vr::VRSettings()->GetString(kSettingsSection, "poseThreadAffinity", buf, sizeof(buf));
+    m_pose_thread_tuning.affinity = buf;
+    vr::VRSettings()->GetString(kSettingsSection, "poseThreadScheduler", buf, sizeof(buf));
+    m_pose_thread_tuning.scheduler = buf;
+    m_pose_thread_tuning.priority = vr::VRSettings()->GetInt32(kSettingsSection, "poseThreadPriority");
 
     if (m_role == TrackedControllerRole_LeftHand)
     {
         m_serial_number += "L";
         m_render_model_name = "{soft_knuckles}/rendermodels/soft_knuckles_placeholder_left";
+        LoadFilterSettings("left");
     }
     else if (m_role == TrackedControllerRole_RightHand)
     {
         m_serial_number += "R";
         m_render_model_name = "{soft_knuckles}/rendermodels/soft_knuckles_placeholder_right";
 		m_pose.vecPosition[0] += 0.2f; // offset the right a little
+        LoadFilterSettings("right");
     }
         
-    dprintf("soft_knuckles serial: %s\n", m_serial_number.c_str());
-    dprintf("soft_knuckles model_number: %s\n", m_model_number.c_str());
+    DLOG_INFO("soft_knuckles serial: %s\n", m_serial_number.c_str());
+    DLOG_INFO("soft_knuckles model_number: %s\n", m_model_number.c_str());
+    DLOG_INFO("soft_knuckles pose update interval: %dus\n", m_pose_update_interval_us);
 
     if (m_debug_handler)
     {
@@ -94,61 +128,88 @@ void SoftKnucklesDevice::Init(
     }
 }
 
+// reads <hand>FilterEnable, <hand>FilterMinCutoff etc.  missing or zero cutoffs
+// fall back to the PoseFilter defaults.
+void SoftKnucklesDevice::LoadFilterSettings(const char *hand)
+{
+    string prefix = hand;
+    PoseFilterParams params = PoseFilter::DefaultParams();
+    bool enabled = vr::VRSettings()->GetBool(kSettingsSection, (prefix + "FilterEnable").c_str());
+
+    float value = vr::VRSettings()->GetFloat(kSettingsSection, (prefix + "FilterMinCutoff").c_str());
+    if (value > 0)
+        params.min_cutoff = value;
+    params.beta = vr::VRSettings()->GetFloat(kSettingsSection, (prefix + "FilterBeta").c_str());
+    value = vr::VRSettings()->GetFloat(kSettingsSection, (prefix + "FilterDerivativeCutoff").c_str());
+    if (value > 0)
+        params.derivative_cutoff = value;
+    value = vr::VRSettings()->GetFloat(kSettingsSection, (prefix + "FilterRotationMinCutoff").c_str());
+    if (value > 0)
+        params.rotation_min_cutoff = value;
+    params.rotation_beta = vr::VRSettings()->GetFloat(kSettingsSection, (prefix + "FilterRotationBeta").c_str());
+
+    m_pose_filter.Configure(enabled, params);
+    DLOG_INFO("soft_knuckles %s pose filter: %s min_cutoff %f beta %f dcutoff %f rot_min_cutoff %f rot_beta %f\n",
+        hand, enabled ? "on" : "off", params.min_cutoff, params.beta, params.derivative_cutoff,
+        params.rotation_min_cutoff, params.rotation_beta);
+}
+
 void SoftKnucklesDevice::EnterStandby()
 {
-    dprintf("SoftKnucklesDevice::EnterStandby()\n");
+    DLOG_INFO("SoftKnucklesDevice::EnterStandby()\n");
     if (m_running)
     {
         m_running = false;
+        clock_wake_sleepers();
     }
 }
 
 VRInputComponentHandle_t SoftKnucklesDevice::CreateBooleanComponent(const char *full_path)
 {
-	dprintf("SoftKnucklesDevice::CreateBooleanComponent for %s on %d\n", full_path, m_tracked_device_container);
+	DLOG_DEBUG("SoftKnucklesDevice::CreateBooleanComponent for %s on %d\n", full_path, m_tracked_device_container);
     VRInputComponentHandle_t input_handle = k_ulInvalidInputComponentHandle;
     EVRInputError input_error = vr::VRDriverInput()->CreateBooleanComponent(m_tracked_device_container, full_path, &input_handle); // note it goes into the container specific to this instance of the device
     if (input_error != VRInputError_None)
     {
-        dprintf("error %d\n", input_error);
+        DLOG_ERROR("error %d\n", input_error);
     }
     else
     {
-        dprintf("ok\n");
+        DLOG_TRACE("ok\n");
     }
     return input_handle;
 }
 
 VRInputComponentHandle_t SoftKnucklesDevice::CreateScalarComponent(const char *full_path, EVRScalarType scalar_type, EVRScalarUnits scalar_units)
 {
-	dprintf("SoftKnucklesDevice::CreateScalarComponent for %s on %d\n", full_path, m_tracked_device_container);
+	DLOG_DEBUG("SoftKnucklesDevice::CreateScalarComponent for %s on %d\n", full_path, m_tracked_device_container);
     VRInputComponentHandle_t input_handle = k_ulInvalidInputComponentHandle;
     EVRInputError input_error = vr::VRDriverInput()->CreateScalarComponent(m_tracked_device_container, full_path, &input_handle,
                     scalar_type, scalar_units);
     
     if (input_error != VRInputError_None)
     {
-        dprintf("error %d\n", input_error);
+        DLOG_ERROR("error %d\n", input_error);
     }
     else
     {
-        dprintf("ok\n");
+        DLOG_TRACE("ok\n");
     }
     return input_handle;
 }
 
 VRInputComponentHandle_t SoftKnucklesDevice::CreateHapticComponent(const char *name)
 {
-	dprintf("SoftKnucklesDevice::CreateHapticComponent for %s\n", name);
+	DLOG_DEBUG("SoftKnucklesDevice::CreateHapticComponent for %s\n", name);
     VRInputComponentHandle_t input_handle = k_ulInvalidInputComponentHandle;
     EVRInputError input_error = vr::VRDriverInput()->CreateHapticComponent(m_tracked_device_container, name, &input_handle); // note it goes into the container specific to this instance of the device
     if (input_error != VRInputError_None)
     {
-        dprintf("error %d\n", input_error);
+        DLOG_ERROR("error %d\n", input_error);
     }
     else
     {
-        dprintf("ok\n");
+        DLOG_TRACE("ok\n");
     }
     return input_handle;
 }
@@ -156,18 +217,18 @@ VRInputComponentHandle_t SoftKnucklesDevice::CreateHapticComponent(const char *n
 VRInputComponentHandle_t SoftKnucklesDevice::CreateSkeletonComponent(const char *name, const char *skeleton_path, const char *base_pose_path,
                                 const VRBoneTransform_t *pGripLimitTransforms, uint32_t unGripLimitTransformCount)
 {
-	dprintf("SoftKnucklesDevice::CreateSkeletonComponent for %s\n", name);
+	DLOG_DEBUG("SoftKnucklesDevice::CreateSkeletonComponent for %s\n", name);
     VRInputComponentHandle_t input_handle = k_ulInvalidInputComponentHandle;
     EVRInputError input_error = vr::VRDriverInput()->CreateSkeletonComponent(m_tracked_device_container, name, skeleton_path, base_pose_path,
 		VRSkeletalTracking_Partial, pGripLimitTransforms, unGripLimitTransformCount, &input_handle);
 
     if (input_error != VRInputError_None)
     {
-        dprintf("error %d\n", input_error);
+        DLOG_ERROR("error %d\n", input_error);
     }
     else
     {
-        dprintf("ok\n");
+        DLOG_TRACE("ok\n");
     }
     return input_handle;
 }
@@ -261,62 +322,241 @@ static VRBoneTransform_t left_fist_pose[NUM_BONES] =
 
 void SoftKnucklesDevice::update_pose_thread(SoftKnucklesDevice *pthis)
 {
-#ifdef _WIN32
-    HRESULT hr = SetThreadDescription(GetCurrentThread(), L"update_pose_thread");
-#endif
+    string applied = tune_current_thread(("sk pose " + pthis->m_serial_number).c_str(), pthis->m_pose_thread_tuning);
+    DLOG_INFO("pose thread %s: %s\n", pthis->m_serial_number.c_str(), applied.c_str());
+    {
+        lock_guard<mutex> lock(pthis->m_pose_mutex);
+        pthis->m_pose_thread_applied = applied;
+    }
+    trace_set_thread_name(("pose thread " + pthis->m_serial_number).c_str());
 	bool m_show_open_hand_pose = true;
+	const uint64_t interval_ns = pthis->m_pose_update_interval_us * 1000ull;
+	const uint64_t skeleton_interval_ns = 1000000000ull;
+	uint64_t next_tick_ns = clock_now_ns();
+	uint64_t next_skeleton_ns = next_tick_ns;
     while (pthis->m_running)
     {
-        vr::VRServerDriverHost()->TrackedDevicePoseUpdated(pthis->m_id, pthis->GetPose(), sizeof(DriverPose_t));
+        uint64_t tick_start_ns = trace_enabled() ? trace_now_ns() : 0;
+        // taken before the snapshot, so a command that lands after it is measured against the next pose
+        uint64_t pose_command_ns = TakePendingCommand(&pthis->m_pending_pose_command_ns);
+        if (pthis->m_session_replay.Active())
+        {
+            // before the snapshot, so replayed poses go out on this tick
+            SessionReplayOutput output = { pthis, push_component_value, push_position, push_rotation, push_skeleton };
+            uint32_t replayed = pthis->m_session_replay.Drain(pose_history_now_ns(), output);
+            if (replayed)
+            {
+                g_frame_telemetry.commands.Add(replayed);
+            }
+        }
+        DriverPose_t pose;
+        HmdFollowState follow;
+        pthis->SnapshotPose(&pose, &follow);
+        if (follow.enabled)
+        {
+            ApplyHmdFollow(follow, &pose);
+        }
+        vr::VRServerDriverHost()->TrackedDevicePoseUpdated(pthis->m_id, pose, sizeof(DriverPose_t));
+        g_frame_telemetry.poses.Add();
+        uint64_t now_ns = pose_history_now_ns();
+        if (pose_command_ns)
+        {
+            pthis->m_command_latency.pose.Record(now_ns - pose_command_ns);
+        }
+        pthis->m_pose_history.Push(now_ns, pose);
+        uint32_t drained = pthis->m_event_queue.Drain(now_ns, push_component_value, pthis);
+        if (drained)
+        {
+            g_frame_telemetry.commands.Add(drained);
+        }
+        pthis->m_generators.Evaluate(now_ns, push_component_value, pthis);
 
-		// demo code to show alternate fist and open_hand poses on the left hand skeleton
-		VRBoneTransform_t *left_pose;
-		if (m_show_open_hand_pose)
+		if (pthis->m_skeleton_demo && next_tick_ns >= next_skeleton_ns)
+		{
+			// demo code to alternate fist and open_hand poses until a skeleton value is set
+			next_skeleton_ns += skeleton_interval_ns;
+			for (const SkeletonComponent &skeleton : pthis->m_components->Skeletons())
+			{
+				pthis->m_component_values[skeleton.index] = m_show_open_hand_pose ? 0.0f : 1.0f;
+			}
+			m_show_open_hand_pose = !m_show_open_hand_pose;
+			pthis->m_skeleton_dirty = true;
+		}
+		if (pthis->m_skeleton_dirty.exchange(false))
 		{
-			left_pose = left_open_hand_pose;
+			uint64_t skeleton_command_ns = TakePendingCommand(&pthis->m_pending_skeleton_command_ns);
+			update_skeleton(pthis);
+			g_frame_telemetry.skeletons.Add();
+			if (skeleton_command_ns)
+			{
+				pthis->m_command_latency.input.Record(pose_history_now_ns() - skeleton_command_ns);
+			}
 		}
-		else
+
+		if (tick_start_ns)
 		{
-			left_pose = left_fist_pose;
+			trace_complete("pose_tick", tick_start_ns, trace_now_ns());
 		}
-		m_show_open_hand_pose = !m_show_open_hand_pose;
 
-		// update right skeletons with right poses
-		for (int i = 0; i < pthis->m_component_handles.size(); i++)
+		// absolute deadlines so the tick rate doesn't drift with the work done per tick.
+		// if we fell more than a tick behind, resync rather than burst to catch up.
+		next_tick_ns += interval_ns;
+		uint64_t after_ns = clock_now_ns();
+		if (after_ns > next_tick_ns + interval_ns)
 		{
-			if (pthis->m_component_definitions[i].component_type == CT_SKELETON)
-			{
-				if (strcmp(pthis->m_component_definitions[i].skeleton_path, "/skeleton/hand/left") == 0)
-				{
-					vr::VRDriverInput()->UpdateSkeletonComponent(
-						pthis->m_component_handles[i],
-						vr::VRSkeletalMotionRange_WithoutController,
-						left_pose,
-						NUM_BONES);
-					vr::VRDriverInput()->UpdateSkeletonComponent(
-						pthis->m_component_handles[i],
-						vr::VRSkeletalMotionRange_WithController,
-						left_pose,
-						NUM_BONES);
-
-				}
-			}
+			next_tick_ns = after_ns;
+		}
+		clock_sleep_until(next_tick_ns, pthis->m_running);
+		if (pthis->m_running)
+		{
+			uint64_t woke_ns = clock_now_ns();
+			pthis->m_pose_jitter.Record(woke_ns > next_tick_ns ? woke_ns - next_tick_ns : 0);
 		}
-		std::this_thread::sleep_for(std::chrono::milliseconds(1000));
     }
+    clock_detach_thread();
 }
 
+// the open hand and fist poses for each SkeletonHand.  only the left hand has poses so far:
+// right hand skeletons are registered but not submitted, and a SKELETON_HAND_OTHER skeleton,
+// from another kind of controller's profile, has no hand shape to pose.
+struct SkeletonPoses
+{
+    const VRBoneTransform_t *open_hand;
+    const VRBoneTransform_t *fist;
+};
+static const SkeletonPoses skeleton_poses[NUM_SKELETON_HANDS] =
+{
+    { left_open_hand_pose, left_fist_pose },    // SKELETON_HAND_LEFT
+    { nullptr, nullptr },                       // SKELETON_HAND_RIGHT
+    { nullptr, nullptr },                       // SKELETON_HAND_OTHER
+};
+
+// submits the skeletons that have poses: a component value >= 0.5 is a fist, otherwise an open hand.
+void SoftKnucklesDevice::update_skeleton(SoftKnucklesDevice *pthis)
+{
+		for (const SkeletonComponent &skeleton : pthis->m_components->Skeletons())
+		{
+			const SkeletonPoses &poses = skeleton_poses[skeleton.hand];
+			if (!poses.fist)
+				continue;
+			const VRBoneTransform_t *pose = pthis->GetComponentValue(skeleton.index) >= 0.5f ? poses.fist : poses.open_hand;
+			vr::VRDriverInput()->UpdateSkeletonComponent(
+				pthis->m_component_handles[skeleton.index],
+				vr::VRSkeletalMotionRange_WithoutController,
+				pose,
+				NUM_BONES);
+			vr::VRDriverInput()->UpdateSkeletonComponent(
+				pthis->m_component_handles[skeleton.index],
+				vr::VRSkeletalMotionRange_WithController,
+				pose,
+				NUM_BONES);
+			pthis->m_session_recorder.Skeleton(pose_history_now_ns(), skeleton.index, pose);
+		}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// per component type registration and updates.  Activate and
+// UpdateComponentValue index component_ops by the component's type rather
+// than switching on it.
+//
+template <> struct ComponentOps<CT_BOOLEAN>
+{
+    static VRInputComponentHandle_t Create(SoftKnucklesDevice *device, const KnuckleComponentDefinition &definition)
+    {
+        return device->CreateBooleanComponent(definition.full_path);
+    }
+
+    static EVRInputError Update(SoftKnucklesDevice *device, uint32_t index, float value)
+    {
+        EVRInputError err = vr::VRDriverInput()->UpdateBooleanComponent(device->m_component_handles[index], value >= 0.5f, 0);
+        if (err == VRInputError_None)
+        {
+            device->RememberComponentValue(index, value);
+        }
+        return err;
+    }
+};
+
+template <> struct ComponentOps<CT_SCALAR>
+{
+    static VRInputComponentHandle_t Create(SoftKnucklesDevice *device, const KnuckleComponentDefinition &definition)
+    {
+        return device->CreateScalarComponent(definition.full_path, definition.scalar_type, definition.scalar_units);
+    }
+
+    static EVRInputError Update(SoftKnucklesDevice *device, uint32_t index, float value)
+    {
+        EVRInputError err = vr::VRDriverInput()->UpdateScalarComponent(device->m_component_handles[index], value, 0);
+        if (err == VRInputError_None)
+        {
+            device->RememberComponentValue(index, value);
+        }
+        return err;
+    }
+};
+
+template <> struct ComponentOps<CT_SKELETON>
+{
+    static VRInputComponentHandle_t Create(SoftKnucklesDevice *device, const KnuckleComponentDefinition &definition)
+    {
+        return device->CreateSkeletonComponent(definition.full_path, definition.skeleton_path, definition.base_pose_path, nullptr, 0);
+    }
+
+    // skeletons are submitted from the pose thread, and recorded as bone
+    // transforms when update_skeleton submits them
+    static EVRInputError Update(SoftKnucklesDevice *device, uint32_t index, float value)
+    {
+        device->m_skeleton_demo = false;
+        device->m_component_values[index].store(value, std::memory_order_relaxed);
+        device->m_skeleton_dirty = true;
+        return VRInputError_None;
+    }
+};
+
+template <> struct ComponentOps<CT_HAPTIC>
+{
+    static VRInputComponentHandle_t Create(SoftKnucklesDevice *device, const KnuckleComponentDefinition &definition)
+    {
+        device->m_haptic_component = device->CreateHapticComponent(definition.full_path);
+        return device->m_haptic_component;
+    }
+
+    // output only: vibrations arrive as events (see HapticVibration)
+    static EVRInputError Update(SoftKnucklesDevice *, uint32_t, float)
+    {
+        return VRInputError_InvalidHandle;
+    }
+};
+
+struct ComponentDispatch
+{
+    VRInputComponentHandle_t (*create)(SoftKnucklesDevice *device, const KnuckleComponentDefinition &definition);
+    EVRInputError (*update)(SoftKnucklesDevice *device, uint32_t index, float value);
+};
+
+#define COMPONENT_DISPATCH(TYPE) { &ComponentOps<TYPE>::Create, &ComponentOps<TYPE>::Update }
+static const ComponentDispatch component_ops[NUM_COMPONENT_TYPES] =
+{
+    COMPONENT_DISPATCH(CT_BOOLEAN),
+    COMPONENT_DISPATCH(CT_SCALAR),
+    COMPONENT_DISPATCH(CT_SKELETON),
+    COMPONENT_DISPATCH(CT_HAPTIC),
+};
+#undef COMPONENT_DISPATCH
+
 EVRInitError SoftKnucklesDevice::Activate(uint32_t unObjectId) 
 {
-	dprintf("SoftKnucklesDevice::Activate.  object ID: %d\n", unObjectId);
+	DLOG_INFO("SoftKnucklesDevice::Activate.  object ID: %d\n", unObjectId);
     if (m_activated)
     {
-        dprintf("warning: Activate called twice\n");
+        DLOG_WARN("warning: Activate called twice\n");
         return VRInitError_Driver_Failed;
     }
     m_activated = true;
     m_id = unObjectId;
     m_tracked_device_container = vr::VRProperties()->TrackedDeviceToPropertyContainer(m_id);
+    m_session_recorder.SetSkeletonReference(left_open_hand_pose, NUM_BONES);
+    m_session_replay.SetSkeletonReference(left_open_hand_pose, NUM_BONES);
 
     SetProperty(Prop_SerialNumber_String, m_serial_number.c_str());
     SetProperty(Prop_ModelNumber_String, m_model_number.c_str());
@@ -324,32 +564,20 @@ EVRInitError SoftKnucklesDevice::Activate(uint32_t unObjectId)
     SetProperty(Prop_ManufacturerName_String, "sean");
     SetInt32Property(Prop_ControllerRoleHint_Int32, m_role);
     SetInt32Property(Prop_DeviceClass_Int32, (int32_t)TrackedDeviceClass_Controller);
-    SetProperty(Prop_InputProfilePath_String, "{soft_knuckles}/input/soft_knuckles_profile.json");
-    SetProperty(Prop_ControllerType_String, "soft_knuckles");
-    SetProperty(Prop_LegacyInputProfile_String, "soft_knuckles");
+    // the profile the components came from (see component_table.h)
+    SetProperty(Prop_InputProfilePath_String, m_components->ProfileName().c_str());
+    SetProperty(Prop_ControllerType_String, m_components->ControllerType().c_str());
+    SetProperty(Prop_LegacyInputProfile_String, m_components->ControllerType().c_str());
 
     m_component_handles.resize(m_num_component_definitions);
     for (uint32_t i = 0; i < m_num_component_definitions; i++)
     {
-        const KnuckleComponentDefinition *definition = &m_component_definitions[i];
-        switch (definition->component_type)
-        {
-            case CT_BOOLEAN:
-                m_component_handles[i] = CreateBooleanComponent(definition->full_path);
-                break;
-            case CT_SCALAR:
-                m_component_handles[i] = CreateScalarComponent(definition->full_path, definition->scalar_type, definition->scalar_units );
-                break;
-            case CT_SKELETON:
-                m_component_handles[i] = CreateSkeletonComponent(definition->full_path, definition->skeleton_path, definition->base_pose_path, nullptr, 0);
-                break;
-            case CT_HAPTIC:
-                m_component_handles[i] = CreateHapticComponent(definition->full_path);
-                break;
-        }
+        const KnuckleComponentDefinition &definition = m_component_definitions[i];
+        m_component_handles[i] = component_ops[definition.component_type].create(this, definition);
     }
 
     m_running = true;
+    clock_attach_thread();
     m_pose_thread = thread(update_pose_thread, this);
 	m_pose_thread.detach();
 
@@ -358,19 +586,23 @@ EVRInitError SoftKnucklesDevice::Activate(uint32_t unObjectId)
 
 void SoftKnucklesDevice::Deactivate() 
 {
-    dprintf("SoftKnucklesDevice::Deactivate.  object ID: %d\n", m_id);
+    DLOG_INFO("SoftKnucklesDevice::Deactivate.  object ID: %d\n", m_id);
     if (m_running)
     {
 		m_running = false; // signal to pose thread to shut down
+		clock_wake_sleepers();
     }
+    // finish any session log, so it is complete even if nobody sent "record stop"
+    m_session_recorder.Stop(nullptr, nullptr);
 }
 
 void SoftKnucklesDevice::Reactivate()
 {
-    dprintf("SoftKnucklesDevice::Reactivate() object ID: %d\n", m_id);
+    DLOG_INFO("SoftKnucklesDevice::Reactivate() object ID: %d\n", m_id);
     if (!m_running)
     {
         m_running = true;
+        clock_attach_thread();
         m_pose_thread = thread(update_pose_thread, this);
     }
 }
@@ -378,23 +610,193 @@ void SoftKnucklesDevice::Reactivate()
 void *SoftKnucklesDevice::GetComponent(const char *pchComponentNameAndVersion)
 {
     // GetComponent will get called for the IVRControllerComponent_001
-    dprintf("SoftKnucklesDevice::GetComponent: %s\n");
+    DLOG_DEBUG("SoftKnucklesDevice::GetComponent: %s\n", pchComponentNameAndVersion);
     return nullptr;
 }
 
 void SoftKnucklesDevice::DebugRequest(const char *pchRequest, char *pchResponseBuffer, uint32_t unResponseBufferSize)
 {
+    SK_TRACE_SCOPE("DebugRequest");
     if (m_debug_handler)
     {
         m_debug_handler->DebugRequest(pchRequest, pchResponseBuffer, unResponseBufferSize);
     }
 }
 
+bool SoftKnucklesDevice::HapticVibration(const VREvent_HapticVibration_t &vibration, float age_seconds, uint64_t now_ns)
+{
+    if (m_haptic_component == k_ulInvalidInputComponentHandle || vibration.componentHandle != m_haptic_component)
+        return false;
+    HapticEvent event;
+    event.receive_ns = now_ns;
+    event.age_ns = age_seconds > 0 ? (uint64_t)(age_seconds * 1e9) : 0;
+    event.duration_seconds = vibration.fDurationSeconds;
+    event.frequency = vibration.fFrequency;
+    event.amplitude = vibration.fAmplitude;
+    m_haptics.Push(event);
+    return true;
+}
+
 DriverPose_t SoftKnucklesDevice::GetPose()
 {
+    lock_guard<mutex> lock(m_pose_mutex);
     return m_pose;
 }
 
+EVRInputError SoftKnucklesDevice::UpdateComponentValue(uint32_t component_index, float value)
+{
+    return component_ops[m_component_definitions[component_index].component_type].update(this, component_index, value);
+}
+
+// after a boolean or scalar update reached the vrsystem
+void SoftKnucklesDevice::RememberComponentValue(uint32_t component_index, float value)
+{
+    m_component_values[component_index].store(value, std::memory_order_relaxed);
+    m_session_recorder.Component(pose_history_now_ns(), component_index, value);
+}
+
+float SoftKnucklesDevice::GetComponentValue(uint32_t component_index) const
+{
+    return m_component_values[component_index].load(std::memory_order_relaxed);
+}
+
+void SoftKnucklesDevice::push_component_value(void *context, uint32_t component_index, float value)
+{
+    SoftKnucklesDevice *pthis = static_cast<SoftKnucklesDevice *>(context);
+    EVRInputError err = pthis->UpdateComponentValue(component_index, value);
+    if (err != VRInputError_None)
+    {
+        DLOG_WARN_LIMITED(10, 10, "timed update of %s failed: %d\n", pthis->m_component_definitions[component_index].full_path, err);
+    }
+}
+
+void SoftKnucklesDevice::push_position(void *context, const double position[3])
+{
+    static_cast<SoftKnucklesDevice *>(context)->SetPosition(position[0], position[1], position[2]);
+}
+
+void SoftKnucklesDevice::push_rotation(void *context, const HmdQuaternion_t &rotation)
+{
+    static_cast<SoftKnucklesDevice *>(context)->SetRotation(rotation);
+}
+
+// replayed skeletons go straight to the vrserver.  called on the pose thread.
+void SoftKnucklesDevice::push_skeleton(void *context, uint32_t component_index, const VRBoneTransform_t *bones, uint32_t bone_count)
+{
+    SoftKnucklesDevice *pthis = static_cast<SoftKnucklesDevice *>(context);
+    if (pthis->m_component_definitions[component_index].component_type != CT_SKELETON)
+        return;
+    pthis->m_skeleton_demo = false;
+    VRInputComponentHandle_t handle = pthis->m_component_handles[component_index];
+    vr::VRDriverInput()->UpdateSkeletonComponent(handle, vr::VRSkeletalMotionRange_WithoutController, bones, bone_count);
+    vr::VRDriverInput()->UpdateSkeletonComponent(handle, vr::VRSkeletalMotionRange_WithController, bones, bone_count);
+    pthis->m_session_recorder.Skeleton(pose_history_now_ns(), component_index, bones);
+    g_frame_telemetry.skeletons.Add();
+}
+
+void SoftKnucklesDevice::NotePendingCommand(std::atomic<uint64_t> *pending, uint64_t arrival_ns)
+{
+    // keep the oldest: only fill an empty slot
+    uint64_t expected = 0;
+    pending->compare_exchange_strong(expected, arrival_ns, std::memory_order_relaxed);
+}
+
+uint64_t SoftKnucklesDevice::TakePendingCommand(std::atomic<uint64_t> *pending)
+{
+    // plain load first so idle ticks don't pay for a read-modify-write
+    if (pending->load(std::memory_order_relaxed) == 0)
+        return 0;
+    return pending->exchange(0, std::memory_order_relaxed);
+}
+
+void SoftKnucklesDevice::SnapshotPose(DriverPose_t *pose, HmdFollowState *follow)
+{
+    lock_guard<mutex> lock(m_pose_mutex);
+    *pose = m_pose;
+    *follow = m_hmd_follow;
+}
+
+void SoftKnucklesDevice::SetPosition(double x, double y, double z)
+{
+    double position[3] = { x, y, z };
+    m_session_recorder.Position(pose_history_now_ns(), position);
+    lock_guard<mutex> lock(m_pose_mutex);
+    if (m_pose_filter.Enabled())
+    {
+        m_pose_filter.FilterPosition(pose_history_now_ns() * 1e-9, position, m_pose.vecPosition);
+    }
+    else
+    {
+        m_pose.vecPosition[0] = position[0];
+        m_pose.vecPosition[1] = position[1];
+        m_pose.vecPosition[2] = position[2];
+    }
+}
+
+void SoftKnucklesDevice::SetRotation(const HmdQuaternion_t &rotation)
+{
+    HmdQuaternion_t normalized = quat_normalize(rotation);
+    m_session_recorder.Rotation(pose_history_now_ns(), normalized);
+    lock_guard<mutex> lock(m_pose_mutex);
+    if (m_pose_filter.Enabled())
+    {
+        m_pose.qRotation = m_pose_filter.FilterRotation(pose_history_now_ns() * 1e-9, normalized);
+    }
+    else
+    {
+        m_pose.qRotation = normalized;
+    }
+}
+
+void SoftKnucklesDevice::SetWorldFromDriver(const RigidTransform &world_from_driver)
+{
+    RigidTransform normalized = world_from_driver;
+    normalized.rotation = quat_normalize(world_from_driver.rotation);
+
+    lock_guard<mutex> lock(m_pose_mutex);
+    m_pose.qWorldFromDriverRotation = normalized.rotation;
+    m_pose.vecWorldFromDriverTranslation[0] = normalized.translation[0];
+    m_pose.vecWorldFromDriverTranslation[1] = normalized.translation[1];
+    m_pose.vecWorldFromDriverTranslation[2] = normalized.translation[2];
+    m_hmd_follow.driver_from_world = rigid_inverse(normalized);
+}
+
+void SoftKnucklesDevice::SetDriverFromHead(const RigidTransform &driver_from_head)
+{
+    lock_guard<mutex> lock(m_pose_mutex);
+    m_pose.qDriverFromHeadRotation = quat_normalize(driver_from_head.rotation);
+    m_pose.vecDriverFromHeadTranslation[0] = driver_from_head.translation[0];
+    m_pose.vecDriverFromHeadTranslation[1] = driver_from_head.translation[1];
+    m_pose.vecDriverFromHeadTranslation[2] = driver_from_head.translation[2];
+}
+
+void SoftKnucklesDevice::SetHmdFollow(bool enabled, const RigidTransform &offset)
+{
+    lock_guard<mutex> lock(m_pose_mutex);
+    m_hmd_follow.enabled = enabled;
+    m_hmd_follow.offset = offset;
+    m_hmd_follow.offset.rotation = quat_normalize(offset.rotation);
+}
+
+// replace the pose's position and rotation with hmd * offset, expressed in
+// the driver space of the pose.  leaves the pose untouched if the hmd isn't tracking.
+void SoftKnucklesDevice::ApplyHmdFollow(const HmdFollowState &follow, DriverPose_t *pose)
+{
+    TrackedDevicePose_t hmd_pose;
+    vr::VRServerDriverHost()->GetRawTrackedDevicePoses(0, &hmd_pose, 1);
+    if (!hmd_pose.bPoseIsValid)
+        return;
+
+    RigidTransform world_from_hmd = rigid_from_matrix34(hmd_pose.mDeviceToAbsoluteTracking);
+    RigidTransform driver_from_controller =
+        rigid_compose(follow.driver_from_world, rigid_compose(world_from_hmd, follow.offset));
+
+    pose->qRotation = driver_from_controller.rotation;
+    pose->vecPosition[0] = driver_from_controller.translation[0];
+    pose->vecPosition[1] = driver_from_controller.translation[1];
+    pose->vecPosition[2] = driver_from_controller.translation[2];
+}
+
 string SoftKnucklesDevice::get_serial() const
 {
     return m_serial_number;
@@ -6,12 +6,51 @@
 // function.
 //
 // It uses it's own thread to continually send pose updates to the vrsystem.
-// It uses soft_knuckles_config to define the input configuration.
+// Its input components come from a ComponentTable (see component_table.h).
 //
+// Every pose it submits is also recorded, with a timestamp, in a
+// PoseHistory so that debug requests can ask where it was at time T.
+//
+// Positions and rotations pushed in through the debug handler can be run
+// through a PoseFilter, configured per hand in the settings.
+//
+// Boolean and scalar components can be driven by ramp and pulse generators
+// (see input_generator.h) and by timed events, e.g. from macros
+// (see input_event_queue.h), both of which the pose thread evaluates every tick.
+//
+// Each debug request is stamped with the pose_history_now_ns() clock when it
+// arrives.  When the change it made reaches the vrsystem (the next submitted
+// pose, the direct Update*Component call, or the next skeleton submit) the
+// elapsed time goes into the device's command latency histograms.  Commands
+// arriving between two submits are coalesced; the oldest one is measured.
+//
+// The pose can optionally follow the HMD at a fixed offset.  In that mode
+// the pose thread fetches the HMD pose on every tick and composes it with
+// the offset, so the controller follows at the pose thread's rate.
+//
+// The pose thread can be pinned to CPUs and given a real-time scheduling
+// class (see thread_tuning.h).  How late it wakes for each tick goes into
+// its jitter histogram.
+//
+#pragma once
 #include <openvr_driver.h>
 #include <thread>
 #include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 #include "soft_knuckles_config.h"
+#include "component_table.h"
+#include "pose_history.h"
+#include "pose_math.h"
+#include "pose_filter.h"
+#include "input_generator.h"
+#include "input_event_queue.h"
+#include "latency_histogram.h"
+#include "session_log.h"
+#include "haptic_ring.h"
+#include "thread_tuning.h"
 
 using namespace vr;
 using namespace std;
@@ -20,32 +59,89 @@ namespace soft_knuckles {
 
     class SoftKnucklesDebugHandler;
 
+    // how each component type is created and updated, specialized per
+    // ComponentType in soft_knuckles_device.cpp
+    template <ComponentType type> struct ComponentOps;
+
+    static const uint32_t kDefaultPoseUpdateIntervalUs = 1000;
+
+    struct HmdFollowState
+    {
+        bool enabled;
+        RigidTransform offset;              // controller relative to the hmd
+        RigidTransform driver_from_world;   // inverse of the pose's world from driver transform
+    };
+
+    struct CommandLatency
+    {
+        LatencyHistogram pose;      // pose commands to TrackedDevicePoseUpdated
+        LatencyHistogram input;     // input commands to Update*Component / UpdateSkeletonComponent
+    };
+
     class SoftKnucklesDevice : public ITrackedDeviceServerDriver
     {
         friend class SoftKnucklesDebugHandler;
+        friend struct BenchmarkAccess;     // soft_knuckles_benchmarks
+        template <ComponentType type> friend struct ComponentOps;
 
+        // cold: set up by Init and Activate, read-only while the pose thread runs
         uint32_t m_id;
         bool m_activated;
         vr::IVRDriverContext *m_driver_context;
         PropertyContainerHandle_t m_tracked_device_container;
         ETrackedControllerRole m_role;
-        const KnuckleComponentDefinition *m_component_definitions;
+        std::shared_ptr<const ComponentTable> m_components;
+        const KnuckleComponentDefinition *m_component_definitions;     // m_components' definitions and count
         uint32_t m_num_component_definitions;
         SoftKnucklesDebugHandler *m_debug_handler;
-
-        vr::DriverPose_t m_pose;
+        uint32_t m_pose_update_interval_us;
         string m_serial_number;
         string m_model_number;
         string m_render_model_name;
         vector<VRInputComponentHandle_t> m_component_handles;
-        std::atomic<bool> m_running;
+        unique_ptr<atomic<float>[]> m_component_values;    // last value pushed to each boolean/scalar component
+        VRInputComponentHandle_t m_haptic_component;
         thread m_pose_thread;
+        ThreadTuning m_pose_thread_tuning;
+
+        // the state shared with the pose thread, grouped by who writes it.
+        // not padded to cache lines: no run of BM_ManyDevicesPos has shown a
+        // gain from it.  devices are far larger than a line (PoseHistory is
+        // inline), so neighbours in an array only meet at their edges.
+
+        // read by the pose thread every tick, rarely written
+        std::atomic<bool> m_running;
+        std::atomic<bool> m_skeleton_demo;      // alternate fist and open hand until a skeleton value is set
+
+        // written by debug requests, taken by the pose thread
+        std::atomic<bool> m_skeleton_dirty;     // skeleton values changed since the pose thread last submitted them
+        std::atomic<uint64_t> m_pending_pose_command_ns;      // arrival of the oldest pose command not yet submitted, 0 if none
+        std::atomic<uint64_t> m_pending_skeleton_command_ns;  // same for skeleton commands
+
+        // written by debug requests under the lock
+        std::mutex m_pose_mutex;            // guards m_pose, m_hmd_follow, m_pose_filter and m_pose_thread_applied between debug requests and the pose thread
+        vr::DriverPose_t m_pose;
+        HmdFollowState m_hmd_follow;
+        PoseFilter m_pose_filter;
+        string m_pose_thread_applied;       // what tune_current_thread reported, empty until the thread starts
+
+        // counters, bumped by the pose thread and debug requests
+        CommandLatency m_command_latency;
+        LatencyHistogram m_pose_jitter;     // how late the pose thread woke for each tick
+
+        // queues and logs with their own synchronization
+        InputGeneratorSet m_generators;
+        InputEventQueue m_event_queue;
+        PoseHistory m_pose_history;
+        SessionRecorder m_session_recorder;
+        SessionReplay m_session_replay;
+        HapticRing m_haptics;
 
     public:
         SoftKnucklesDevice();
+        // components is shared with the other devices of the same kind (see component_table.h)
         void Init(ETrackedControllerRole role,
-            const KnuckleComponentDefinition *component_definitions,
-            uint32_t num_component_definitions,
+            std::shared_ptr<const ComponentTable> components,
             SoftKnucklesDebugHandler *debug_handler);
 
         // implement required ITrackedDeviceServerDriver interfaces
@@ -59,6 +155,9 @@ namespace soft_knuckles {
 
         string get_serial() const;
 
+        // called from RunFrame.  false if the vibration is for another device's haptic component.
+        bool HapticVibration(const VREvent_HapticVibration_t &vibration, float age_seconds, uint64_t now_ns);
+
     private:
         VRInputComponentHandle_t CreateBooleanComponent(const char *full_path);
         VRInputComponentHandle_t CreateScalarComponent(const char *full_path, EVRScalarType scalar_type, EVRScalarUnits scalar_units);
@@ -69,6 +168,31 @@ namespace soft_knuckles {
         void SetProperty(ETrackedDeviceProperty prop_key, const char *prop_value);
         void SetInt32Property(ETrackedDeviceProperty prop_key, int32_t value);
         void SetBoolProperty(ETrackedDeviceProperty prop_key, int32_t value);
+        void LoadFilterSettings(const char *hand);
+
+        // pushes a value to a boolean (>= 0.5 is pressed), scalar or skeleton (>= 0.5 is a fist)
+        // component and remembers it
+        EVRInputError UpdateComponentValue(uint32_t component_index, float value);
+        float GetComponentValue(uint32_t component_index) const;
+        void RememberComponentValue(uint32_t component_index, float value);
+        static void push_component_value(void *context, uint32_t component_index, float value);
+        static void push_position(void *context, const double position[3]);
+        static void push_rotation(void *context, const HmdQuaternion_t &rotation);
+        static void push_skeleton(void *context, uint32_t component_index, const VRBoneTransform_t *bones, uint32_t bone_count);
+
+        // pose state setters used by the debug handler
+        void SetPosition(double x, double y, double z);
+        void SetRotation(const HmdQuaternion_t &rotation);
+        void SetWorldFromDriver(const RigidTransform &world_from_driver);
+        void SetDriverFromHead(const RigidTransform &driver_from_head);
+        void SetHmdFollow(bool enabled, const RigidTransform &offset);
+        void SnapshotPose(DriverPose_t *pose, HmdFollowState *follow);
+        static void ApplyHmdFollow(const HmdFollowState &follow, DriverPose_t *pose);
+
+        // command latency.  arrival_ns is on the pose_history_now_ns() clock; take returns 0 if nothing is pending.
+        static void NotePendingCommand(std::atomic<uint64_t> *pending, uint64_t arrival_ns);
+        static uint64_t TakePendingCommand(std::atomic<uint64_t> *pending);
         static void update_pose_thread(SoftKnucklesDevice *pthis);
+        static void update_skeleton(SoftKnucklesDevice *pthis);
     };
 }
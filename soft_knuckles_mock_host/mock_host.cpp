@@ -0,0 +1,939 @@
+//////////////////////////////////////////////////////////////////////////////
+// mock_host.cpp
+//
+// See header for description
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "mock_host.h"
+
+using namespace std;
+using namespace vr;
+
+namespace soft_knuckles
+{
+
+static const DriverHandle_t kMockDriverHandle = 1;
+
+//////////////////////////////////////////////////////////////////////////////
+// vrsettings parsing.
+// default.vrsettings is a two level object of sections and scalar values,
+// which is all that is handled here: no arrays and no nested sections.
+//
+class VrSettingsParser
+{
+public:
+    VrSettingsParser(const string &text) : m_text(text), m_pos(0) {}
+
+    bool Parse(map<string, string> *settings)
+    {
+        if (!Expect('{'))
+            return false;
+        if (Peek() == '}')
+            return true;
+        for (;;)
+        {
+            string section;
+            if (!ParseString(&section) || !Expect(':') || !Expect('{'))
+                return false;
+            if (Peek() != '}')
+            {
+                for (;;)
+                {
+                    string key, value;
+                    if (!ParseString(&key) || !Expect(':') || !ParseValue(&value))
+                        return false;
+                    (*settings)[section + "." + key] = value;
+                    if (Peek() != ',')
+                        break;
+                    m_pos++;
+                }
+            }
+            if (!Expect('}'))
+                return false;
+            if (Peek() != ',')
+                break;
+            m_pos++;
+        }
+        return Expect('}');
+    }
+
+    size_t Position() const { return m_pos; }
+
+private:
+    char Peek()
+    {
+        while (m_pos < m_text.size() && isspace((unsigned char)m_text[m_pos]))
+            m_pos++;
+        return m_pos < m_text.size() ? m_text[m_pos] : 0;
+    }
+
+    bool Expect(char c)
+    {
+        if (Peek() != c)
+            return false;
+        m_pos++;
+        return true;
+    }
+
+    bool ParseString(string *out)
+    {
+        if (!Expect('"'))
+            return false;
+        while (m_pos < m_text.size() && m_text[m_pos] != '"')
+        {
+            char c = m_text[m_pos++];
+            if (c == '\\' && m_pos < m_text.size())
+            {
+                c = m_text[m_pos++];
+                if (c == 'n')
+                    c = '\n';
+                else if (c == 't')
+                    c = '\t';
+            }
+            out->push_back(c);
+        }
+        return Expect('"');
+    }
+
+    // strings, numbers and true/false are all kept as text
+    bool ParseValue(string *out)
+    {
+        if (Peek() == '"')
+            return ParseString(out);
+        while (m_pos < m_text.size() && !strchr(",} \t\r\n", m_text[m_pos]))
+            out->push_back(m_text[m_pos++]);
+        return !out->empty();
+    }
+
+    const string &m_text;
+    size_t m_pos;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// MockHost
+//
+MockHost::MockHost()
+    : m_library(nullptr),
+      m_provider(nullptr),
+      m_watchdog(nullptr),
+      m_clock_now(nullptr),
+      m_clock_advance(nullptr),
+      m_recording(true),
+      m_exiting(false),
+      m_echo_log(false),
+      m_log_lines(0),
+      m_watchdog_wakeups(0)
+{
+    // index 0 is the hmd: standing height, facing -z.
+    DeviceEntry hmd;
+    hmd.serial = "mock_hmd";
+    hmd.device_class = TrackedDeviceClass_HMD;
+    hmd.driver = nullptr;
+    hmd.activated = true;
+    memset(&hmd.stats, 0, sizeof(hmd.stats));
+    m_devices.push_back(hmd);
+
+    memset(&m_hmd_pose, 0, sizeof(m_hmd_pose));
+    m_hmd_pose.m[0][0] = m_hmd_pose.m[1][1] = m_hmd_pose.m[2][2] = 1.0f;
+    m_hmd_pose.m[1][3] = 1.7f;
+}
+
+MockHost::~MockHost()
+{
+    CleanupProvider();
+    if (m_library)
+    {
+        dlclose(m_library);
+    }
+}
+
+uint64_t MockHost::NowNs()
+{
+    if (m_clock_now)
+        return m_clock_now();
+    return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool MockHost::LoadSettings(const char *vrsettings_path)
+{
+    FILE *f = fopen(vrsettings_path, "rb");
+    if (!f)
+    {
+        fprintf(stderr, "mock_host: could not open %s\n", vrsettings_path);
+        return false;
+    }
+    string text;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    {
+        text.append(buf, n);
+    }
+    fclose(f);
+
+    map<string, string> settings;
+    VrSettingsParser parser(text);
+    if (!parser.Parse(&settings))
+    {
+        fprintf(stderr, "mock_host: %s: parse error near offset %u\n", vrsettings_path, (unsigned)parser.Position());
+        return false;
+    }
+    lock_guard<mutex> lock(m_settings_mutex);
+    for (auto &entry : settings)
+    {
+        m_settings[entry.first] = entry.second;
+    }
+    return true;
+}
+
+bool MockHost::SetSetting(const char *section_dot_key_equals_value)
+{
+    const char *equals = strchr(section_dot_key_equals_value, '=');
+    const char *dot = strchr(section_dot_key_equals_value, '.');
+    if (!equals || !dot || dot > equals)
+    {
+        fprintf(stderr, "mock_host: expected section.key=value, got %s\n", section_dot_key_equals_value);
+        return false;
+    }
+    lock_guard<mutex> lock(m_settings_mutex);
+    m_settings[string(section_dot_key_equals_value, equals)] = equals + 1;
+    return true;
+}
+
+bool MockHost::LoadDriver(const char *shared_object_path)
+{
+    m_library = dlopen(shared_object_path, RTLD_NOW | RTLD_LOCAL);
+    if (!m_library)
+    {
+        fprintf(stderr, "mock_host: dlopen failed: %s\n", dlerror());
+        return false;
+    }
+    typedef void *(*HmdDriverFactoryFn)(const char *pInterfaceName, int *pReturnCode);
+    HmdDriverFactoryFn factory = (HmdDriverFactoryFn)dlsym(m_library, "HmdDriverFactory");
+    if (!factory)
+    {
+        fprintf(stderr, "mock_host: %s has no HmdDriverFactory\n", shared_object_path);
+        return false;
+    }
+    int return_code = 0;
+    m_provider = (IServerTrackedDeviceProvider *)factory(IServerTrackedDeviceProvider_Version, &return_code);
+    if (!m_provider)
+    {
+        fprintf(stderr, "mock_host: factory returned no %s (%d)\n", IServerTrackedDeviceProvider_Version, return_code);
+        return false;
+    }
+    m_watchdog = (IVRWatchdogProvider *)factory(IVRWatchdogProvider_Version, &return_code);
+    return true;
+}
+
+bool MockHost::UseDriverClock()
+{
+    if (!m_library)
+        return false;
+    m_clock_now = (ClockNowFn)dlsym(m_library, "SoftKnucklesClockNowNs");
+    m_clock_advance = (ClockAdvanceFn)dlsym(m_library, "SoftKnucklesClockAdvance");
+    if (!m_clock_now || !m_clock_advance)
+    {
+        fprintf(stderr, "mock_host: the driver has no clock hooks\n");
+        m_clock_now = nullptr;
+        m_clock_advance = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool MockHost::AdvanceClock(uint64_t ns)
+{
+    return m_clock_advance && m_clock_advance(ns);
+}
+
+EVRInitError MockHost::InitProvider()
+{
+    if (!m_provider)
+        return VRInitError_Init_InterfaceNotFound;
+    m_exiting = false;
+    return m_provider->Init(this);
+}
+
+void MockHost::CleanupProvider()
+{
+    if (!m_provider)
+        return;
+    m_exiting = true;
+    m_provider->Cleanup();
+    m_provider = nullptr;
+}
+
+EVRInitError MockHost::InitWatchdog()
+{
+    if (!m_watchdog)
+        return VRInitError_Init_InterfaceNotFound;
+    return m_watchdog->Init(this);
+}
+
+void MockHost::CleanupWatchdog()
+{
+    if (!m_watchdog)
+        return;
+    m_watchdog->Cleanup();
+    m_watchdog = nullptr;
+}
+
+// the provider waits for a connection on its notifier socket before it adds devices.
+// its listen thread may not be up yet, so retry for a second.
+bool MockHost::ConnectNotifier(const char *address, unsigned short port)
+{
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr(address);
+    addr.sin_port = htons(port);
+
+    for (int attempt = 0; attempt < 100; attempt++)
+    {
+        int s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (s < 0)
+            return false;
+        int ret = connect(s, (sockaddr *)&addr, sizeof(addr));
+        close(s);
+        if (ret == 0)
+            return true;
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    fprintf(stderr, "mock_host: could not connect to %s:%d\n", address, port);
+    return false;
+}
+
+void MockHost::RunFrame()
+{
+    // activate outside the lock: Activate calls straight back into the host.
+    vector<pair<uint32_t, ITrackedDeviceServerDriver *>> pending;
+    {
+        lock_guard<mutex> lock(m_devices_mutex);
+        for (uint32_t i = 0; i < m_devices.size(); i++)
+        {
+            if (!m_devices[i].activated)
+            {
+                m_devices[i].activated = true;
+                pending.push_back(make_pair(i, m_devices[i].driver));
+            }
+        }
+    }
+    for (auto &device : pending)
+    {
+        device.second->Activate(device.first);
+    }
+
+    if (m_provider)
+    {
+        m_provider->RunFrame();
+    }
+}
+
+uint32_t MockHost::NumDevices()
+{
+    lock_guard<mutex> lock(m_devices_mutex);
+    return (uint32_t)m_devices.size();
+}
+
+ITrackedDeviceServerDriver *MockHost::Device(uint32_t device_index)
+{
+    lock_guard<mutex> lock(m_devices_mutex);
+    if (device_index >= m_devices.size())
+        return nullptr;
+    return m_devices[device_index].driver;
+}
+
+string MockHost::DebugRequest(uint32_t device_index, const char *request)
+{
+    ITrackedDeviceServerDriver *device = Device(device_index);
+    if (!device)
+        return "no such device";
+    char response[4096];
+    response[0] = 0;
+    device->DebugRequest(request, response, sizeof(response));
+    return response;
+}
+
+void MockHost::SetHmdPose(const HmdMatrix34_t &pose)
+{
+    lock_guard<mutex> lock(m_devices_mutex);
+    m_hmd_pose = pose;
+}
+
+void MockHost::QueueEvent(const VREvent_t &event)
+{
+    uint64_t now = NowNs();
+    lock_guard<mutex> lock(m_devices_mutex);
+    m_events.push_back(event);
+    m_event_queued_ns.push_back(now);
+}
+
+bool MockHost::QueueHaptic(uint32_t device_index, float duration_seconds, float frequency, float amplitude)
+{
+    VREvent_t event;
+    memset(&event, 0, sizeof(event));
+    {
+        lock_guard<mutex> lock(m_devices_mutex);
+        for (size_t i = 0; i < m_components.size(); i++)
+        {
+            if (m_components[i].kind == MOCK_HAPTIC && m_components[i].container == device_index + 1)
+            {
+                event.data.hapticVibration.containerHandle = m_components[i].container;
+                event.data.hapticVibration.componentHandle = i + 1;
+                break;
+            }
+        }
+    }
+    if (event.data.hapticVibration.componentHandle == 0)
+        return false;
+    event.eventType = VREvent_Input_HapticVibration;
+    event.trackedDeviceIndex = device_index;
+    event.data.hapticVibration.fDurationSeconds = duration_seconds;
+    event.data.hapticVibration.fFrequency = frequency;
+    event.data.hapticVibration.fAmplitude = amplitude;
+    QueueEvent(event);
+    return true;
+}
+
+void MockHost::TakeRecords(vector<MockCallRecord> *records)
+{
+    lock_guard<mutex> lock(m_devices_mutex);
+    records->swap(m_records);
+    m_records.clear();
+}
+
+MockDeviceStats MockHost::Stats(uint32_t device_index)
+{
+    lock_guard<mutex> lock(m_devices_mutex);
+    MockDeviceStats stats;
+    memset(&stats, 0, sizeof(stats));
+    if (device_index < m_devices.size())
+        stats = m_devices[device_index].stats;
+    return stats;
+}
+
+const MockComponent *MockHost::Component(VRInputComponentHandle_t handle)
+{
+    lock_guard<mutex> lock(m_devices_mutex);
+    if (handle == k_ulInvalidInputComponentHandle || handle > m_components.size())
+        return nullptr;
+    return &m_components[handle - 1];
+}
+
+void MockHost::Record(MockCallKind kind, uint32_t device_index, VRInputComponentHandle_t component,
+    const double *values, int num_values)
+{
+    uint64_t now = NowNs();
+    lock_guard<mutex> lock(m_devices_mutex);
+    if (device_index < m_devices.size())
+    {
+        MockDeviceStats &stats = m_devices[device_index].stats;
+        stats.counts[kind]++;
+        if (kind == MOCK_POSE)
+        {
+            if (stats.first_pose_ns == 0)
+                stats.first_pose_ns = now;
+            else if (now - stats.last_pose_ns > stats.max_pose_interval_ns)
+                stats.max_pose_interval_ns = now - stats.last_pose_ns;
+            stats.last_pose_ns = now;
+        }
+    }
+    if (!m_recording)
+        return;
+
+    MockCallRecord record;
+    memset(&record, 0, sizeof(record));
+    record.t_ns = now;
+    record.kind = kind;
+    record.device_index = device_index;
+    record.component = component;
+    memcpy(record.values, values, num_values * sizeof(double));
+    m_records.push_back(record);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// IVRDriverContext
+//
+void *MockHost::GetGenericInterface(const char *pchInterfaceVersion, EVRInitError *peError)
+{
+    void *ret = nullptr;
+    if (0 == strcmp(pchInterfaceVersion, IVRServerDriverHost_Version))
+        ret = static_cast<IVRServerDriverHost *>(this);
+    else if (0 == strcmp(pchInterfaceVersion, IVRDriverInput_Version))
+        ret = static_cast<IVRDriverInput *>(this);
+    else if (0 == strcmp(pchInterfaceVersion, IVRProperties_Version))
+        ret = static_cast<IVRProperties *>(this);
+    else if (0 == strcmp(pchInterfaceVersion, IVRSettings_Version))
+        ret = static_cast<IVRSettings *>(this);
+    else if (0 == strcmp(pchInterfaceVersion, IVRDriverLog_Version))
+        ret = static_cast<IVRDriverLog *>(this);
+    else if (0 == strcmp(pchInterfaceVersion, IVRWatchdogHost_Version))
+        ret = static_cast<IVRWatchdogHost *>(this);
+    else if (0 == strcmp(pchInterfaceVersion, IVRResources_Version))
+        ret = static_cast<IVRResources *>(this);
+
+    if (peError)
+        *peError = ret ? VRInitError_None : VRInitError_Init_InterfaceNotFound;
+    return ret;
+}
+
+DriverHandle_t MockHost::GetDriverHandle()
+{
+    return kMockDriverHandle;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// IVRServerDriverHost
+//
+bool MockHost::TrackedDeviceAdded(const char *pchDeviceSerialNumber, ETrackedDeviceClass eDeviceClass,
+    ITrackedDeviceServerDriver *pDriver)
+{
+    lock_guard<mutex> lock(m_devices_mutex);
+    if (m_devices.size() >= k_unMaxTrackedDeviceCount)
+        return false;
+    for (auto &device : m_devices)
+    {
+        if (device.serial == pchDeviceSerialNumber)
+            return false;
+    }
+    // activated from the next RunFrame, the way vrserver does it from its own thread
+    DeviceEntry device;
+    device.serial = pchDeviceSerialNumber;
+    device.device_class = eDeviceClass;
+    device.driver = pDriver;
+    device.activated = false;
+    memset(&device.stats, 0, sizeof(device.stats));
+    m_devices.push_back(device);
+    return true;
+}
+
+void MockHost::TrackedDevicePoseUpdated(uint32_t unWhichDevice, const DriverPose_t &newPose, uint32_t unPoseStructSize)
+{
+    double values[7] = {
+        newPose.vecPosition[0], newPose.vecPosition[1], newPose.vecPosition[2],
+        newPose.qRotation.w, newPose.qRotation.x, newPose.qRotation.y, newPose.qRotation.z };
+    Record(MOCK_POSE, unWhichDevice, k_ulInvalidInputComponentHandle, values, 7);
+}
+
+void MockHost::VsyncEvent(double vsyncTimeOffsetSeconds)
+{
+}
+
+void MockHost::VendorSpecificEvent(uint32_t unWhichDevice, EVREventType eventType, const VREvent_Data_t &eventData,
+    double eventTimeOffset)
+{
+}
+
+bool MockHost::IsExiting()
+{
+    return m_exiting;
+}
+
+bool MockHost::PollNextEvent(VREvent_t *pEvent, uint32_t uncbVREvent)
+{
+    uint64_t now = NowNs();
+    lock_guard<mutex> lock(m_devices_mutex);
+    if (m_events.empty() || uncbVREvent < sizeof(VREvent_t))
+        return false;
+    *pEvent = m_events.front();
+    pEvent->eventAgeSeconds = (float)((now - m_event_queued_ns.front()) * 1e-9);
+    m_events.pop_front();
+    m_event_queued_ns.pop_front();
+    return true;
+}
+
+void MockHost::GetRawTrackedDevicePoses(float fPredictedSecondsFromNow, TrackedDevicePose_t *pTrackedDevicePoseArray,
+    uint32_t unTrackedDevicePoseArrayCount)
+{
+    memset(pTrackedDevicePoseArray, 0, unTrackedDevicePoseArrayCount * sizeof(TrackedDevicePose_t));
+    if (unTrackedDevicePoseArrayCount == 0)
+        return;
+    lock_guard<mutex> lock(m_devices_mutex);
+    TrackedDevicePose_t &hmd = pTrackedDevicePoseArray[k_unTrackedDeviceIndex_Hmd];
+    hmd.mDeviceToAbsoluteTracking = m_hmd_pose;
+    hmd.eTrackingResult = TrackingResult_Running_OK;
+    hmd.bPoseIsValid = true;
+    hmd.bDeviceIsConnected = true;
+}
+
+void MockHost::TrackedDeviceDisplayTransformUpdated(uint32_t unWhichDevice, HmdMatrix34_t eyeToHeadLeft,
+    HmdMatrix34_t eyeToHeadRight)
+{
+}
+
+void MockHost::RequestRestart(const char *pchLocalizedReason, const char *pchExecutableToStart, const char *pchArguments,
+    const char *pchWorkingDirectory)
+{
+    fprintf(stderr, "mock_host: driver requested a restart: %s\n", pchLocalizedReason);
+}
+
+uint32_t MockHost::GetFrameTimings(Compositor_FrameTiming *pTiming, uint32_t nFrames)
+{
+    return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// IVRDriverInput
+//
+EVRInputError MockHost::AddComponent(PropertyContainerHandle_t container, const char *name, MockCallKind kind,
+    VRInputComponentHandle_t *handle)
+{
+    if (!handle)
+        return VRInputError_InvalidHandle;
+    lock_guard<mutex> lock(m_devices_mutex);
+    if (container == k_ulInvalidPropertyContainer || container > m_devices.size())
+    {
+        *handle = k_ulInvalidInputComponentHandle;
+        return VRInputError_InvalidHandle;
+    }
+    MockComponent component;
+    component.container = container;
+    component.name = name;
+    component.kind = kind;
+    m_components.push_back(component);
+    *handle = m_components.size();
+    return VRInputError_None;
+}
+
+EVRInputError MockHost::CreateBooleanComponent(PropertyContainerHandle_t ulContainer, const char *pchName,
+    VRInputComponentHandle_t *pHandle)
+{
+    return AddComponent(ulContainer, pchName, MOCK_BOOLEAN, pHandle);
+}
+
+EVRInputError MockHost::UpdateBooleanComponent(VRInputComponentHandle_t ulComponent, bool bNewValue, double fTimeOffset)
+{
+    const MockComponent *component = Component(ulComponent);
+    if (!component || component->kind != MOCK_BOOLEAN)
+        return VRInputError_InvalidHandle;
+    double values[2] = { bNewValue ? 1.0 : 0.0, fTimeOffset };
+    Record(MOCK_BOOLEAN, (uint32_t)(component->container - 1), ulComponent, values, 2);
+    return VRInputError_None;
+}
+
+EVRInputError MockHost::CreateScalarComponent(PropertyContainerHandle_t ulContainer, const char *pchName,
+    VRInputComponentHandle_t *pHandle, EVRScalarType eType, EVRScalarUnits eUnits)
+{
+    return AddComponent(ulContainer, pchName, MOCK_SCALAR, pHandle);
+}
+
+EVRInputError MockHost::UpdateScalarComponent(VRInputComponentHandle_t ulComponent, float fNewValue, double fTimeOffset)
+{
+    const MockComponent *component = Component(ulComponent);
+    if (!component || component->kind != MOCK_SCALAR)
+        return VRInputError_InvalidHandle;
+    double values[2] = { fNewValue, fTimeOffset };
+    Record(MOCK_SCALAR, (uint32_t)(component->container - 1), ulComponent, values, 2);
+    return VRInputError_None;
+}
+
+EVRInputError MockHost::CreateHapticComponent(PropertyContainerHandle_t ulContainer, const char *pchName,
+    VRInputComponentHandle_t *pHandle)
+{
+    return AddComponent(ulContainer, pchName, MOCK_HAPTIC, pHandle);
+}
+
+EVRInputError MockHost::CreateSkeletonComponent(PropertyContainerHandle_t ulContainer, const char *pchName,
+    const char *pchSkeletonPath, const char *pchBasePosePath, EVRSkeletalTrackingLevel eSkeletalTrackingLevel,
+    const VRBoneTransform_t *pGripLimitTransforms, uint32_t unGripLimitTransformCount, VRInputComponentHandle_t *pHandle)
+{
+    return AddComponent(ulContainer, pchName, MOCK_SKELETON, pHandle);
+}
+
+EVRInputError MockHost::UpdateSkeletonComponent(VRInputComponentHandle_t ulComponent, EVRSkeletalMotionRange eMotionRange,
+    const VRBoneTransform_t *pTransforms, uint32_t unTransformCount)
+{
+    const MockComponent *component = Component(ulComponent);
+    if (!component || component->kind != MOCK_SKELETON)
+        return VRInputError_InvalidHandle;
+    // bone 1 is the wrist; enough to tell an open hand from a fist in a recording
+    double values[6] = { (double)eMotionRange, (double)unTransformCount, 0, 0, 0, 0 };
+    if (pTransforms && unTransformCount > 1)
+    {
+        values[2] = pTransforms[1].orientation.w;
+        values[3] = pTransforms[1].orientation.x;
+        values[4] = pTransforms[1].orientation.y;
+        values[5] = pTransforms[1].orientation.z;
+    }
+    Record(MOCK_SKELETON, (uint32_t)(component->container - 1), ulComponent, values, 6);
+    return VRInputError_None;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// IVRProperties
+//
+ETrackedPropertyError MockHost::ReadPropertyBatch(PropertyContainerHandle_t ulContainerHandle, PropertyRead_t *pBatch,
+    uint32_t unBatchEntryCount)
+{
+    lock_guard<mutex> lock(m_properties_mutex);
+    for (uint32_t i = 0; i < unBatchEntryCount; i++)
+    {
+        PropertyRead_t &read = pBatch[i];
+        auto iter = m_properties.find(make_pair(ulContainerHandle, (int)read.prop));
+        if (iter == m_properties.end())
+        {
+            read.unTag = k_unInvalidPropertyTag;
+            read.unRequiredBufferSize = 0;
+            read.eError = TrackedProp_UnknownProperty;
+            continue;
+        }
+        const Property &property = (*iter).second;
+        read.unTag = property.tag;
+        read.unRequiredBufferSize = (uint32_t)property.data.size();
+        if (read.unBufferSize < property.data.size())
+        {
+            read.eError = TrackedProp_BufferTooSmall;
+            continue;
+        }
+        if (!property.data.empty())
+            memcpy(read.pvBuffer, property.data.data(), property.data.size());
+        read.eError = TrackedProp_Success;
+    }
+    return TrackedProp_Success;
+}
+
+ETrackedPropertyError MockHost::WritePropertyBatch(PropertyContainerHandle_t ulContainerHandle, PropertyWrite_t *pBatch,
+    uint32_t unBatchEntryCount)
+{
+    lock_guard<mutex> lock(m_properties_mutex);
+    for (uint32_t i = 0; i < unBatchEntryCount; i++)
+    {
+        PropertyWrite_t &write = pBatch[i];
+        auto key = make_pair(ulContainerHandle, (int)write.prop);
+        if (write.writeType == PropertyWrite_Erase || write.writeType == PropertyWrite_SetError)
+        {
+            m_properties.erase(key);
+        }
+        else
+        {
+            Property &property = m_properties[key];
+            property.tag = write.unTag;
+            property.data.assign((const uint8_t *)write.pvBuffer, (const uint8_t *)write.pvBuffer + write.unBufferSize);
+        }
+        write.eError = TrackedProp_Success;
+    }
+    return TrackedProp_Success;
+}
+
+const char *MockHost::GetPropErrorNameFromEnum(ETrackedPropertyError error)
+{
+    switch (error)
+    {
+    case TrackedProp_Success: return "TrackedProp_Success";
+    case TrackedProp_BufferTooSmall: return "TrackedProp_BufferTooSmall";
+    case TrackedProp_UnknownProperty: return "TrackedProp_UnknownProperty";
+    default: return "TrackedProp_Error";
+    }
+}
+
+PropertyContainerHandle_t MockHost::TrackedDeviceToPropertyContainer(TrackedDeviceIndex_t nDevice)
+{
+    return (PropertyContainerHandle_t)nDevice + 1;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// IVRSettings
+//
+bool MockHost::LookupSetting(const char *section, const char *key, string *value, EVRSettingsError *error)
+{
+    lock_guard<mutex> lock(m_settings_mutex);
+    auto iter = m_settings.find(string(section) + "." + key);
+    bool found = iter != m_settings.end();
+    if (found)
+        *value = (*iter).second;
+    if (error)
+        *error = found ? VRSettingsError_None : VRSettingsError_UnsetSettingHasNoDefault;
+    return found;
+}
+
+void MockHost::StoreSetting(const char *section, const char *key, const string &value, EVRSettingsError *error)
+{
+    lock_guard<mutex> lock(m_settings_mutex);
+    m_settings[string(section) + "." + key] = value;
+    if (error)
+        *error = VRSettingsError_None;
+}
+
+const char *MockHost::GetSettingsErrorNameFromEnum(EVRSettingsError eError)
+{
+    return eError == VRSettingsError_None ? "VRSettingsError_None" : "VRSettingsError_UnsetSettingHasNoDefault";
+}
+
+bool MockHost::Sync(bool bForce, EVRSettingsError *peError)
+{
+    if (peError)
+        *peError = VRSettingsError_None;
+    return true;
+}
+
+void MockHost::SetBool(const char *pchSection, const char *pchSettingsKey, bool bValue, EVRSettingsError *peError)
+{
+    StoreSetting(pchSection, pchSettingsKey, bValue ? "true" : "false", peError);
+}
+
+void MockHost::SetInt32(const char *pchSection, const char *pchSettingsKey, int32_t nValue, EVRSettingsError *peError)
+{
+    StoreSetting(pchSection, pchSettingsKey, to_string(nValue), peError);
+}
+
+void MockHost::SetFloat(const char *pchSection, const char *pchSettingsKey, float flValue, EVRSettingsError *peError)
+{
+    char text[64];
+    snprintf(text, sizeof(text), "%.9g", flValue);
+    StoreSetting(pchSection, pchSettingsKey, text, peError);
+}
+
+void MockHost::SetString(const char *pchSection, const char *pchSettingsKey, const char *pchValue, EVRSettingsError *peError)
+{
+    StoreSetting(pchSection, pchSettingsKey, pchValue, peError);
+}
+
+bool MockHost::GetBool(const char *pchSection, const char *pchSettingsKey, EVRSettingsError *peError)
+{
+    string value;
+    if (!LookupSetting(pchSection, pchSettingsKey, &value, peError))
+        return false;
+    return value == "true" || atoi(value.c_str()) != 0;
+}
+
+int32_t MockHost::GetInt32(const char *pchSection, const char *pchSettingsKey, EVRSettingsError *peError)
+{
+    string value;
+    if (!LookupSetting(pchSection, pchSettingsKey, &value, peError))
+        return 0;
+    if (value == "true")
+        return 1;
+    return (int32_t)atof(value.c_str());
+}
+
+float MockHost::GetFloat(const char *pchSection, const char *pchSettingsKey, EVRSettingsError *peError)
+{
+    string value;
+    if (!LookupSetting(pchSection, pchSettingsKey, &value, peError))
+        return 0.0f;
+    if (value == "true")
+        return 1.0f;
+    return (float)atof(value.c_str());
+}
+
+void MockHost::GetString(const char *pchSection, const char *pchSettingsKey, char *pchValue, uint32_t unValueLen,
+    EVRSettingsError *peError)
+{
+    string value;
+    LookupSetting(pchSection, pchSettingsKey, &value, peError);
+    if (unValueLen == 0)
+        return;
+    size_t len = value.size() < unValueLen - 1 ? value.size() : unValueLen - 1;
+    memcpy(pchValue, value.c_str(), len);
+    pchValue[len] = 0;
+}
+
+void MockHost::RemoveSection(const char *pchSection, EVRSettingsError *peError)
+{
+    lock_guard<mutex> lock(m_settings_mutex);
+    string prefix = string(pchSection) + ".";
+    auto iter = m_settings.lower_bound(prefix);
+    while (iter != m_settings.end() && (*iter).first.compare(0, prefix.size(), prefix) == 0)
+    {
+        iter = m_settings.erase(iter);
+    }
+    if (peError)
+        *peError = VRSettingsError_None;
+}
+
+void MockHost::RemoveKeyInSection(const char *pchSection, const char *pchSettingsKey, EVRSettingsError *peError)
+{
+    lock_guard<mutex> lock(m_settings_mutex);
+    m_settings.erase(string(pchSection) + "." + pchSettingsKey);
+    if (peError)
+        *peError = VRSettingsError_None;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// IVRDriverLog, IVRWatchdogHost
+//
+void MockHost::Log(const char *pchLogMessage)
+{
+    for (const char *p = pchLogMessage; *p; p++)
+    {
+        if (*p == '\n')
+            m_log_lines++;
+    }
+    if (m_echo_log)
+    {
+        fputs(pchLogMessage, stdout);
+    }
+}
+
+void MockHost::WatchdogWakeUp()
+{
+    m_watchdog_wakeups++;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// IVRResources
+//
+// like vrserver, returns the size needed including the terminator, or 0 if
+// the resource doesn't exist
+uint32_t MockHost::GetResourceFullPath(const char *pchResourceName, const char *pchResourceTypeDirectory,
+    char *pchPathBuffer, uint32_t unBufferLen)
+{
+    string name = pchResourceName;
+    string path;
+    size_t close = name.find('}');
+    if (name[0] == '{' && close != string::npos)
+    {
+        // {driver}/rest -> driver/resources/rest
+        path = name.substr(1, close - 1) + "/resources" + name.substr(close + 1);
+    }
+    else
+    {
+        path = "soft_knuckles/resources/";
+        if (pchResourceTypeDirectory[0])
+            path += string(pchResourceTypeDirectory) + "/";
+        path += name;
+    }
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f)
+        return 0;
+    fclose(f);
+    if (pchPathBuffer && unBufferLen > path.size())
+    {
+        memcpy(pchPathBuffer, path.c_str(), path.size() + 1);
+    }
+    return (uint32_t)path.size() + 1;
+}
+
+uint32_t MockHost::LoadSharedResource(const char *pchResourceName, char *pchBuffer, uint32_t unBufferLen)
+{
+    char path[1024];
+    uint32_t needed = GetResourceFullPath(pchResourceName, "", path, sizeof(path));
+    if (needed == 0 || needed > sizeof(path))
+        return 0;
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return 0;
+    fseek(f, 0, SEEK_END);
+    uint32_t size = (uint32_t)ftell(f);
+    if (pchBuffer && unBufferLen >= size)
+    {
+        fseek(f, 0, SEEK_SET);
+        size = (uint32_t)fread(pchBuffer, 1, size, f);
+    }
+    fclose(f);
+    return size;
+}
+
+};
@@ -0,0 +1,241 @@
+//////////////////////////////////////////////////////////////////////////////
+// mock_host.h
+//
+// A headless stand-in for vrserver.  MockHost implements the driver side
+// interfaces soft_knuckles uses (IVRServerDriverHost, IVRDriverInput,
+// IVRProperties, IVRSettings, IVRDriverLog, IVRWatchdogHost and
+// IVRResources) and hands
+// them out through IVRDriverContext, so the real driver_soft_knuckles
+// shared object can be loaded and run with no SteamVR and no GPU.
+//
+// Every pose, input and skeleton update the driver makes is recorded with a
+// steady clock timestamp, or the driver's clock once UseDriverClock() is
+// called (for a driver running with the virtualClock setting).  The records can be inspected in process (tests,
+// benchmarks) or written out as csv by the soft_knuckles_mock_host runner.
+//
+// Linux only: the driver is loaded with dlopen.
+//
+// Resource names like {soft_knuckles}/input/x.json resolve to
+// soft_knuckles/resources/input/x.json under the current directory, so run
+// from the repository root as for the default settings.
+//
+// Typical use:
+//   MockHost host;
+//   host.LoadSettings("soft_knuckles/resources/settings/default.vrsettings");
+//   host.LoadDriver("./driver_soft_knuckles.so");
+//   host.InitProvider();
+//   host.ConnectNotifier("127.0.0.1", 27015);   // the driver adds devices on connect
+//   while (...) host.RunFrame();
+//   host.CleanupProvider();
+//
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <openvr_driver.h>
+
+namespace soft_knuckles
+{
+    enum MockCallKind
+    {
+        MOCK_POSE,          // values: position xyz, rotation wxyz
+        MOCK_BOOLEAN,       // values: new value, time offset
+        MOCK_SCALAR,        // values: new value, time offset
+        MOCK_SKELETON,      // values: motion range, bone count, bone 1 rotation wxyz
+        MOCK_HAPTIC,        // components only; haptics arrive as events
+        NUM_MOCK_CALL_KINDS
+    };
+
+    struct MockCallRecord
+    {
+        uint64_t t_ns;
+        MockCallKind kind;
+        uint32_t device_index;
+        vr::VRInputComponentHandle_t component;
+        double values[7];
+    };
+
+    struct MockComponent
+    {
+        vr::PropertyContainerHandle_t container;
+        std::string name;
+        MockCallKind kind;
+    };
+
+    struct MockDeviceStats
+    {
+        uint64_t counts[NUM_MOCK_CALL_KINDS];
+        uint64_t first_pose_ns;
+        uint64_t last_pose_ns;
+        uint64_t max_pose_interval_ns;
+    };
+
+    class MockHost : public vr::IVRDriverContext,
+                     public vr::IVRServerDriverHost,
+                     public vr::IVRDriverInput,
+                     public vr::IVRProperties,
+                     public vr::IVRSettings,
+                     public vr::IVRDriverLog,
+                     public vr::IVRWatchdogHost,
+                     public vr::IVRResources
+    {
+    public:
+        MockHost();
+        ~MockHost();
+
+        // settings: a vrsettings json file and/or individual section.key=value overrides
+        bool LoadSettings(const char *vrsettings_path);
+        bool SetSetting(const char *section_dot_key_equals_value);
+
+        // driver lifetime
+        bool LoadDriver(const char *shared_object_path);
+        vr::EVRInitError InitProvider();
+        void CleanupProvider();
+        // the watchdog provider, which vrserver runs in its own process, so not alongside
+        // the provider.  wake ups are counted in NumWatchdogWakeUps().
+        vr::EVRInitError InitWatchdog();
+        void CleanupWatchdog();
+        bool ConnectNotifier(const char *address, unsigned short port);
+
+        // activates devices added since the last call, then calls the provider's RunFrame
+        void RunFrame();
+
+        // virtual clock.  after LoadDriver: stamps records with the driver's clock.
+        // AdvanceClock returns once the driver has run everything up to the new time.
+        bool UseDriverClock();
+        bool AdvanceClock(uint64_t ns);
+
+        // device access.  indices start at 1; 0 is the simulated hmd.
+        uint32_t NumDevices();
+        vr::ITrackedDeviceServerDriver *Device(uint32_t device_index);
+        std::string DebugRequest(uint32_t device_index, const char *request);
+        void SetHmdPose(const vr::HmdMatrix34_t &pose);
+        // PollNextEvent hands out queued events oldest first, with eventAgeSeconds
+        // set to how long each has been queued
+        void QueueEvent(const vr::VREvent_t &event);
+        // queues a VREvent_Input_HapticVibration for the device's haptic component
+        bool QueueHaptic(uint32_t device_index, float duration_seconds, float frequency, float amplitude);
+
+        // recording
+        void SetRecording(bool enabled) { m_recording = enabled; }
+        void TakeRecords(std::vector<MockCallRecord> *records);
+        MockDeviceStats Stats(uint32_t device_index);
+        const MockComponent *Component(vr::VRInputComponentHandle_t handle);
+        void SetEchoLog(bool echo) { m_echo_log = echo; }
+        uint64_t NumLogLines() { return m_log_lines; }
+        uint64_t NumWatchdogWakeUps() { return m_watchdog_wakeups; }
+
+        uint64_t NowNs();
+
+        // IVRDriverContext
+        virtual void *GetGenericInterface(const char *pchInterfaceVersion, vr::EVRInitError *peError = nullptr) override;
+        virtual vr::DriverHandle_t GetDriverHandle() override;
+
+        // IVRServerDriverHost
+        virtual bool TrackedDeviceAdded(const char *pchDeviceSerialNumber, vr::ETrackedDeviceClass eDeviceClass, vr::ITrackedDeviceServerDriver *pDriver) override;
+        virtual void TrackedDevicePoseUpdated(uint32_t unWhichDevice, const vr::DriverPose_t &newPose, uint32_t unPoseStructSize) override;
+        virtual void VsyncEvent(double vsyncTimeOffsetSeconds) override;
+        virtual void VendorSpecificEvent(uint32_t unWhichDevice, vr::EVREventType eventType, const vr::VREvent_Data_t &eventData, double eventTimeOffset) override;
+        virtual bool IsExiting() override;
+        virtual bool PollNextEvent(vr::VREvent_t *pEvent, uint32_t uncbVREvent) override;
+        virtual void GetRawTrackedDevicePoses(float fPredictedSecondsFromNow, vr::TrackedDevicePose_t *pTrackedDevicePoseArray, uint32_t unTrackedDevicePoseArrayCount) override;
+        virtual void TrackedDeviceDisplayTransformUpdated(uint32_t unWhichDevice, vr::HmdMatrix34_t eyeToHeadLeft, vr::HmdMatrix34_t eyeToHeadRight) override;
+        virtual void RequestRestart(const char *pchLocalizedReason, const char *pchExecutableToStart, const char *pchArguments, const char *pchWorkingDirectory) override;
+        virtual uint32_t GetFrameTimings(vr::Compositor_FrameTiming *pTiming, uint32_t nFrames) override;
+
+        // IVRDriverInput
+        virtual vr::EVRInputError CreateBooleanComponent(vr::PropertyContainerHandle_t ulContainer, const char *pchName, vr::VRInputComponentHandle_t *pHandle) override;
+        virtual vr::EVRInputError UpdateBooleanComponent(vr::VRInputComponentHandle_t ulComponent, bool bNewValue, double fTimeOffset) override;
+        virtual vr::EVRInputError CreateScalarComponent(vr::PropertyContainerHandle_t ulContainer, const char *pchName, vr::VRInputComponentHandle_t *pHandle, vr::EVRScalarType eType, vr::EVRScalarUnits eUnits) override;
+        virtual vr::EVRInputError UpdateScalarComponent(vr::VRInputComponentHandle_t ulComponent, float fNewValue, double fTimeOffset) override;
+        virtual vr::EVRInputError CreateHapticComponent(vr::PropertyContainerHandle_t ulContainer, const char *pchName, vr::VRInputComponentHandle_t *pHandle) override;
+        virtual vr::EVRInputError CreateSkeletonComponent(vr::PropertyContainerHandle_t ulContainer, const char *pchName, const char *pchSkeletonPath, const char *pchBasePosePath, vr::EVRSkeletalTrackingLevel eSkeletalTrackingLevel, const vr::VRBoneTransform_t *pGripLimitTransforms, uint32_t unGripLimitTransformCount, vr::VRInputComponentHandle_t *pHandle) override;
+        virtual vr::EVRInputError UpdateSkeletonComponent(vr::VRInputComponentHandle_t ulComponent, vr::EVRSkeletalMotionRange eMotionRange, const vr::VRBoneTransform_t *pTransforms, uint32_t unTransformCount) override;
+
+        // IVRProperties
+        virtual vr::ETrackedPropertyError ReadPropertyBatch(vr::PropertyContainerHandle_t ulContainerHandle, vr::PropertyRead_t *pBatch, uint32_t unBatchEntryCount) override;
+        virtual vr::ETrackedPropertyError WritePropertyBatch(vr::PropertyContainerHandle_t ulContainerHandle, vr::PropertyWrite_t *pBatch, uint32_t unBatchEntryCount) override;
+        virtual const char *GetPropErrorNameFromEnum(vr::ETrackedPropertyError error) override;
+        virtual vr::PropertyContainerHandle_t TrackedDeviceToPropertyContainer(vr::TrackedDeviceIndex_t nDevice) override;
+
+        // IVRSettings
+        virtual const char *GetSettingsErrorNameFromEnum(vr::EVRSettingsError eError) override;
+        virtual bool Sync(bool bForce = false, vr::EVRSettingsError *peError = nullptr) override;
+        virtual void SetBool(const char *pchSection, const char *pchSettingsKey, bool bValue, vr::EVRSettingsError *peError = nullptr) override;
+        virtual void SetInt32(const char *pchSection, const char *pchSettingsKey, int32_t nValue, vr::EVRSettingsError *peError = nullptr) override;
+        virtual void SetFloat(const char *pchSection, const char *pchSettingsKey, float flValue, vr::EVRSettingsError *peError = nullptr) override;
+        virtual void SetString(const char *pchSection, const char *pchSettingsKey, const char *pchValue, vr::EVRSettingsError *peError = nullptr) override;
+        virtual bool GetBool(const char *pchSection, const char *pchSettingsKey, vr::EVRSettingsError *peError = nullptr) override;
+        virtual int32_t GetInt32(const char *pchSection, const char *pchSettingsKey, vr::EVRSettingsError *peError = nullptr) override;
+        virtual float GetFloat(const char *pchSection, const char *pchSettingsKey, vr::EVRSettingsError *peError = nullptr) override;
+        virtual void GetString(const char *pchSection, const char *pchSettingsKey, char *pchValue, uint32_t unValueLen, vr::EVRSettingsError *peError = nullptr) override;
+        virtual void RemoveSection(const char *pchSection, vr::EVRSettingsError *peError = nullptr) override;
+        virtual void RemoveKeyInSection(const char *pchSection, const char *pchSettingsKey, vr::EVRSettingsError *peError = nullptr) override;
+
+        // IVRDriverLog
+        virtual void Log(const char *pchLogMessage) override;
+
+        // IVRWatchdogHost
+        virtual void WatchdogWakeUp() override;
+
+        // IVRResources
+        virtual uint32_t LoadSharedResource(const char *pchResourceName, char *pchBuffer, uint32_t unBufferLen) override;
+        virtual uint32_t GetResourceFullPath(const char *pchResourceName, const char *pchResourceTypeDirectory, char *pchPathBuffer, uint32_t unBufferLen) override;
+
+    private:
+        struct Property
+        {
+            vr::PropertyTypeTag_t tag;
+            std::vector<uint8_t> data;
+        };
+
+        struct DeviceEntry
+        {
+            std::string serial;
+            vr::ETrackedDeviceClass device_class;
+            vr::ITrackedDeviceServerDriver *driver;
+            bool activated;
+            MockDeviceStats stats;
+        };
+
+        void Record(MockCallKind kind, uint32_t device_index, vr::VRInputComponentHandle_t component,
+            const double *values, int num_values);
+        vr::EVRInputError AddComponent(vr::PropertyContainerHandle_t container, const char *name,
+            MockCallKind kind, vr::VRInputComponentHandle_t *handle);
+        bool LookupSetting(const char *section, const char *key, std::string *value, vr::EVRSettingsError *error);
+        void StoreSetting(const char *section, const char *key, const std::string &value, vr::EVRSettingsError *error);
+
+        typedef uint64_t (*ClockNowFn)();
+        typedef bool (*ClockAdvanceFn)(uint64_t ns);
+
+        void *m_library;
+        vr::IServerTrackedDeviceProvider *m_provider;
+        vr::IVRWatchdogProvider *m_watchdog;
+        ClockNowFn m_clock_now;                 // null: steady clock
+        ClockAdvanceFn m_clock_advance;
+
+        std::mutex m_settings_mutex;
+        std::map<std::string, std::string> m_settings;          // "section.key" -> value text
+
+        std::mutex m_properties_mutex;
+        std::map<std::pair<vr::PropertyContainerHandle_t, int>, Property> m_properties;
+
+        std::mutex m_devices_mutex;                             // devices, components, records, events
+        std::vector<DeviceEntry> m_devices;                     // m_devices[0] is the hmd
+        std::deque<MockComponent> m_components;                 // handle - 1.  deque: pointers stay valid
+        std::vector<MockCallRecord> m_records;
+        std::deque<vr::VREvent_t> m_events;
+        std::deque<uint64_t> m_event_queued_ns;
+        vr::HmdMatrix34_t m_hmd_pose;
+
+        std::atomic<bool> m_recording;
+        std::atomic<bool> m_exiting;
+        std::atomic<bool> m_echo_log;
+        std::atomic<uint64_t> m_log_lines;
+        std::atomic<uint64_t> m_watchdog_wakeups;
+    };
+};
@@ -0,0 +1,347 @@
+//////////////////////////////////////////////////////////////////////////////
+// mock_host_main.cpp
+//
+// soft_knuckles_mock_host: runs driver_soft_knuckles end to end inside
+// MockHost, with no SteamVR.  It loads the driver, connects to the
+// provider's notifier socket so the devices get added, calls RunFrame at a
+// fixed rate, optionally sends debug requests, and prints what the driver
+// submitted.
+//
+//   soft_knuckles_mock_host [options]
+//     --driver <path>           driver shared object (./driver_soft_knuckles.so)
+//     --settings <path>         vrsettings file (soft_knuckles/resources/settings/default.vrsettings)
+//     --set <section.key=value> override a setting; may be repeated
+//     --seconds <n>             how long to run (2)
+//     --frame-hz <n>            RunFrame rate (90)
+//     --request <device> <text> debug request sent once devices are active; may be repeated
+//     --record <path>           write every recorded call as csv
+//     --haptic <device> <hz>    send the device haptic vibrations at this rate, as an
+//                               application would, and print its "haptics" summary at the end
+//     --log                     echo the driver log to stdout
+//     --virtual                 run the driver on its virtual clock: each frame advances it
+//                               by one frame interval instead of sleeping, so --seconds is
+//                               simulated time and the run is as fast as the driver allows.
+//                               the records come out the same on every run.
+//     --watchdog <n>            instead of the provider, run the watchdog: send it n "wake"
+//                               datagrams on watchdogPort, one at a time, and report how long
+//                               each took to reach WatchdogWakeUp and how long Cleanup took
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "mock_host.h"
+
+using namespace std;
+using namespace soft_knuckles;
+
+struct PendingRequest
+{
+    uint32_t device_index;
+    string text;
+};
+
+static const char *kind_name(MockCallKind kind)
+{
+    switch (kind)
+    {
+    case MOCK_POSE: return "pose";
+    case MOCK_BOOLEAN: return "boolean";
+    case MOCK_SCALAR: return "scalar";
+    case MOCK_SKELETON: return "skeleton";
+    default: return "?";
+    }
+}
+
+static bool write_records(MockHost &host, const char *path, const vector<MockCallRecord> &records)
+{
+    FILE *f = fopen(path, "wt");
+    if (!f)
+    {
+        fprintf(stderr, "could not open %s\n", path);
+        return false;
+    }
+    fprintf(f, "t_ns,kind,device,component,v0,v1,v2,v3,v4,v5,v6\n");
+    uint64_t t0 = records.empty() ? 0 : records[0].t_ns;
+    for (const MockCallRecord &r : records)
+    {
+        const MockComponent *component = host.Component(r.component);
+        fprintf(f, "%llu,%s,%u,%s,%g,%g,%g,%g,%g,%g,%g\n",
+            (unsigned long long)(r.t_ns - t0), kind_name(r.kind), r.device_index,
+            component ? component->name.c_str() : "",
+            r.values[0], r.values[1], r.values[2], r.values[3], r.values[4], r.values[5], r.values[6]);
+    }
+    fclose(f);
+    return true;
+}
+
+static void usage()
+{
+    printf("usage: soft_knuckles_mock_host [--driver path] [--settings path] [--set section.key=value]\n"
+           "                               [--seconds n] [--frame-hz n] [--request device text]\n"
+           "                               [--record path] [--log] [--virtual] [--haptic device hz]\n"
+           "                               [--watchdog n]\n");
+}
+
+static int run_watchdog(MockHost &host, int wakes)
+{
+    vr::EVRInitError err = host.InitWatchdog();
+    if (err != vr::VRInitError_None)
+    {
+        fprintf(stderr, "watchdog Init failed: %d\n", err);
+        return 1;
+    }
+    int port = host.GetInt32("driver_soft_knuckles", "watchdogPort");
+    int s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr.sin_port = htons((unsigned short)port);
+
+    // give the watchdog thread a moment to bind
+    this_thread::sleep_for(chrono::milliseconds(50));
+    vector<double> latency_us;
+    for (int i = 0; i < wakes; i++)
+    {
+        uint64_t before = host.NumWatchdogWakeUps();
+        auto sent = chrono::steady_clock::now();
+        sendto(s, "wake", 4, 0, (sockaddr *)&addr, sizeof(addr));
+        while (host.NumWatchdogWakeUps() == before &&
+               chrono::steady_clock::now() - sent < chrono::seconds(1))
+        {
+        }
+        if (host.NumWatchdogWakeUps() == before)
+        {
+            fprintf(stderr, "wake %d was not delivered\n", i);
+            break;
+        }
+        latency_us.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - sent).count());
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    close(s);
+
+    // idle: no wake ups without datagrams
+    uint64_t idle_before = host.NumWatchdogWakeUps();
+    this_thread::sleep_for(chrono::milliseconds(200));
+    uint64_t idle_wakes = host.NumWatchdogWakeUps() - idle_before;
+
+    auto cleanup_start = chrono::steady_clock::now();
+    host.CleanupWatchdog();
+    double cleanup_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - cleanup_start).count();
+
+    sort(latency_us.begin(), latency_us.end());
+    if (latency_us.empty())
+        return 1;
+    printf("watchdog: %u wakes, latency us p50 %.1f p99 %.1f max %.1f; %llu wakes while idle; cleanup %.3fms\n",
+        (unsigned)latency_us.size(), latency_us[latency_us.size() / 2],
+        latency_us[(latency_us.size() - 1) * 99 / 100], latency_us.back(),
+        (unsigned long long)idle_wakes, cleanup_ms);
+    return (int)latency_us.size() == wakes ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    const char *driver_path = "./driver_soft_knuckles.so";
+    const char *settings_path = "soft_knuckles/resources/settings/default.vrsettings";
+    const char *record_path = nullptr;
+    double seconds = 2.0;
+    double frame_hz = 90.0;
+    bool echo_log = false;
+    bool virtual_clock = false;
+    vector<const char *> overrides;
+    vector<PendingRequest> requests;
+    uint32_t haptic_device = 0;
+    double haptic_hz = 0;
+    int watchdog_wakes = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--driver") && has_value)
+            driver_path = argv[++i];
+        else if (!strcmp(argv[i], "--settings") && has_value)
+            settings_path = argv[++i];
+        else if (!strcmp(argv[i], "--set") && has_value)
+            overrides.push_back(argv[++i]);
+        else if (!strcmp(argv[i], "--seconds") && has_value)
+            seconds = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--frame-hz") && has_value)
+            frame_hz = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--record") && has_value)
+            record_path = argv[++i];
+        else if (!strcmp(argv[i], "--request") && i + 2 < argc)
+        {
+            PendingRequest request;
+            request.device_index = (uint32_t)atoi(argv[++i]);
+            request.text = argv[++i];
+            requests.push_back(request);
+        }
+        else if (!strcmp(argv[i], "--haptic") && i + 2 < argc)
+        {
+            haptic_device = (uint32_t)atoi(argv[++i]);
+            haptic_hz = atof(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--watchdog") && has_value)
+            watchdog_wakes = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--log"))
+            echo_log = true;
+        else if (!strcmp(argv[i], "--virtual"))
+            virtual_clock = true;
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (frame_hz <= 0)
+        frame_hz = 90.0;
+
+    MockHost host;
+    host.SetEchoLog(echo_log);
+    if (settings_path[0] && !host.LoadSettings(settings_path))
+        return 1;
+    for (const char *setting : overrides)
+    {
+        if (!host.SetSetting(setting))
+            return 1;
+    }
+    if (virtual_clock)
+        host.SetSetting("driver_soft_knuckles.virtualClock=true");
+    if (!host.LoadDriver(driver_path))
+        return 1;
+    if (watchdog_wakes > 0)
+        return run_watchdog(host, watchdog_wakes);
+    if (virtual_clock && !host.UseDriverClock())
+        return 1;
+    vr::EVRInitError err = host.InitProvider();
+    if (err != vr::VRInitError_None)
+    {
+        fprintf(stderr, "provider Init failed: %d\n", err);
+        return 1;
+    }
+    if (!host.ConnectNotifier("127.0.0.1", 27015))
+    {
+        host.CleanupProvider();
+        return 1;
+    }
+    if (virtual_clock)
+    {
+        // the devices are added on the notifier thread.  wait for them so that they
+        // activate on the first frame, not whichever frame the thread happens to reach.
+        for (int attempt = 0; attempt < 100 && host.NumDevices() < 2; attempt++)
+        {
+            this_thread::sleep_for(chrono::milliseconds(10));
+        }
+    }
+
+    uint64_t frame_interval_ns = (uint64_t)(1e9 / frame_hz);
+    auto wall_start = chrono::steady_clock::now();
+    auto next_frame = wall_start;
+    uint64_t start_ns = host.NowNs();
+    uint64_t end_ns = start_ns + (uint64_t)(seconds * 1e9);
+    uint64_t frames = 0;
+    bool requests_sent = requests.empty();
+    double haptics_due = 0;
+    uint64_t haptics_sent = 0;
+    while (host.NowNs() < end_ns)
+    {
+        host.RunFrame();
+        frames++;
+
+        // send requests once every device they name has been activated
+        if (!requests_sent)
+        {
+            bool ready = true;
+            for (const PendingRequest &request : requests)
+            {
+                if (request.device_index == 0 || request.device_index >= host.NumDevices())
+                    ready = false;
+            }
+            if (ready && frames > 1)
+            {
+                for (const PendingRequest &request : requests)
+                {
+                    string reply = host.DebugRequest(request.device_index, request.text.c_str());
+                    printf("%u %s -> %s\n", request.device_index, request.text.c_str(), reply.c_str());
+                }
+                requests_sent = true;
+            }
+        }
+
+        // vibrations sent between frames are picked up by the next RunFrame
+        if (haptic_hz > 0 && haptic_device > 0 && haptic_device < host.NumDevices() && frames > 1)
+        {
+            for (haptics_due += haptic_hz / frame_hz; haptics_due >= 1.0; haptics_due -= 1.0)
+            {
+                if (host.QueueHaptic(haptic_device, 0.01f, 160.0f, 0.5f))
+                    haptics_sent++;
+            }
+        }
+
+        if (virtual_clock)
+        {
+            host.AdvanceClock(frame_interval_ns);
+        }
+        else
+        {
+            next_frame += chrono::nanoseconds(frame_interval_ns);
+            this_thread::sleep_until(next_frame);
+        }
+    }
+    double elapsed = (host.NowNs() - start_ns) * 1e-9;
+    string haptics;
+    if (haptic_hz > 0)
+    {
+        host.RunFrame();        // picks up the last frame's vibrations
+        haptics = host.DebugRequest(haptic_device, "haptics");
+    }
+    host.CleanupProvider();
+    double wall_elapsed = chrono::duration<double>(chrono::steady_clock::now() - wall_start).count();
+
+    printf("ran %.2fs, %llu frames, %llu log lines\n", elapsed, (unsigned long long)frames,
+        (unsigned long long)host.NumLogLines());
+    if (virtual_clock)
+    {
+        printf("virtual clock: %.2fs simulated in %.2fs\n", elapsed, wall_elapsed);
+    }
+    for (uint32_t i = 1; i < host.NumDevices(); i++)
+    {
+        MockDeviceStats stats = host.Stats(i);
+        double pose_span = (stats.last_pose_ns - stats.first_pose_ns) * 1e-9;
+        printf("device %u: poses %llu (%.1f/s, max gap %.3fms) booleans %llu scalars %llu skeletons %llu\n", i,
+            (unsigned long long)stats.counts[MOCK_POSE],
+            pose_span > 0 ? (stats.counts[MOCK_POSE] - 1) / pose_span : 0.0,
+            stats.max_pose_interval_ns * 1e-6,
+            (unsigned long long)stats.counts[MOCK_BOOLEAN],
+            (unsigned long long)stats.counts[MOCK_SCALAR],
+            (unsigned long long)stats.counts[MOCK_SKELETON]);
+    }
+    if (haptic_hz > 0)
+    {
+        printf("haptics: sent %llu, device %u replied %s\n", (unsigned long long)haptics_sent, haptic_device,
+            haptics.c_str());
+    }
+    if (!requests_sent)
+    {
+        fprintf(stderr, "requests were not sent: devices never became active\n");
+    }
+
+    if (record_path)
+    {
+        vector<MockCallRecord> records;
+        host.TakeRecords(&records);
+        if (!write_records(host, record_path, records))
+            return 1;
+        printf("wrote %u records to %s\n", (unsigned)records.size(), record_path);
+    }
+    return requests_sent ? 0 : 1;
+}
@@ -19,6 +19,7 @@
 #include <windows.h>
 #endif
 
+#include <atomic>
 #include <thread>
 #include <string.h>
 #include <string>
@@ -27,6 +28,10 @@
 #include "soft_knuckles_debug_handler.h"
 #include "socket_notifier.h"
 #include "dprintf.h"
+#include "trace.h"
+#include "frame_telemetry.h"
+#include "driver_clock.h"
+#include "watchdog_waker.h"
 
 using namespace vr;
 
@@ -51,40 +56,87 @@ class SoftKnucklesProvider : public IServerTrackedDeviceProvider
     SoftKnucklesDevice m_knuckles[NUM_DEVICES];
     SoftKnucklesDebugHandler m_debug_handler[NUM_DEVICES];
 	SoftKnucklesSocketNotifier m_notifier;
+	std::atomic<bool> m_devices_added;	// the notifier fires on every connection; add the devices once
 
 public:
     SoftKnucklesProvider()
-		: m_notifier(this)
+		: m_notifier(this),
+		  m_devices_added(false)
     {
-        dprintf("SoftKnucklesProvider: constructor called\n");
+        DLOG_INFO("SoftKnucklesProvider: constructor called\n");
     }
     
     virtual EVRInitError Init(vr::IVRDriverContext *pDriverContext) override
     {
         // NOTE 1: use the driver context.  Sets up a big set of globals
         VR_INIT_SERVER_DRIVER_CONTEXT(pDriverContext);
-        dprintf("SoftKnucklesProvider: Init called\n");
+        // virtualClock in default.vrsettings.  before anything reads the clock.
+        clock_set_virtual(vr::VRSettings()->GetBool(kSettingsSection, "virtualClock"));
+        StartLogging();
+        StartTracing();
+        DLOG_INFO("SoftKnucklesProvider: Init called\n");
 
+		// the input profile is parsed once per hand; devices of the same hand share the table
 		if (NUM_DEVICES > 0)
 		{
-
-			m_knuckles[0].Init(TrackedControllerRole_LeftHand, component_definitions_left, NUM_INPUT_COMPONENT_DEFINITIONS,
+			m_knuckles[0].Init(TrackedControllerRole_LeftHand, load_component_table(TrackedControllerRole_LeftHand),
 				&m_debug_handler[0]);
 		}
 		if (NUM_DEVICES > 1)
 		{
-			m_knuckles[1].Init(TrackedControllerRole_RightHand, component_definitions_right, NUM_INPUT_COMPONENT_DEFINITIONS,
+			m_knuckles[1].Init(TrackedControllerRole_RightHand, load_component_table(TrackedControllerRole_RightHand),
 				&m_debug_handler[1]);
 		}
 
+		m_devices_added = false;
 		m_notifier.StartListening(listen_address, listen_port);
 
         return VRInitError_None;
     }
 
 	// not virtual: 
+	void StartLogging()
+	{
+		// logFile in default.vrsettings.  debug builds fall back to a temp file.
+		char log_file[1024];
+		log_file[0] = 0;
+		vr::VRSettings()->GetString(kSettingsSection, "logFile", log_file, sizeof(log_file));
+#if !defined(NDEBUG)
+		if (log_file[0] == 0)
+		{
+#if defined(_WIN32)
+			strcpy(log_file, "c:\\temp\\soft_knuckles_log.txt");
+#else
+			strcpy(log_file, "/tmp/soft_knuckles_log.txt");
+#endif
+		}
+#endif
+		dprintf_start(log_file);
+	}
+
+	// not virtual: traceFile in default.vrsettings.  empty leaves tracing off.
+	void StartTracing()
+	{
+		char trace_file[1024];
+		trace_file[0] = 0;
+		vr::VRSettings()->GetString(kSettingsSection, "traceFile", trace_file, sizeof(trace_file));
+		if (trace_file[0])
+		{
+			trace_set_thread_name("vrserver main");
+			if (!trace_start(trace_file))
+			{
+				DLOG_ERROR("could not open trace file %s\n", trace_file);
+			}
+		}
+	}
+
 	void AddDevices()
 	{
+		if (m_devices_added.exchange(true))
+		{
+			DLOG_INFO("devices already added\n");
+			return;
+		}
 		for (int i = 0; i < NUM_DEVICES; i++)
 		{
 			vr::VRServerDriverHost()->TrackedDeviceAdded(
@@ -97,13 +149,14 @@ public:
 
     virtual void Cleanup() override
     {
-        dprintf("SoftKnucklesProvider: Cleanup\n");
+        DLOG_INFO("SoftKnucklesProvider: Cleanup\n");
 		m_notifier.StopListening();
 		for (int i = 0; i < NUM_DEVICES; i++)
 		{
 			m_knuckles[i].Deactivate();
 		}
-		
+		trace_stop();
+		dprintf_stop();
     }
     virtual const char * const *GetInterfaceVersions() override
     {
@@ -111,20 +164,35 @@ public:
     }
     virtual void RunFrame() override
     {
-        static int i;
-        if (i++ % 10000 == 0)
+        SK_TRACE_SCOPE("RunFrame");
+        uint64_t now_ns = pose_history_now_ns();
+        uint64_t frame = g_frame_telemetry.FrameStarted(now_ns);
+        if (frame % 10000 == 1)
+        {
+            DLOG_DEBUG("SoftKnucklesProvider: Run Frame %llu\n", (unsigned long long)frame);
+        }
+
+        // haptic vibrations from applications, for the "haptics" debug request
+        vr::VREvent_t event;
+        while (vr::VRServerDriverHost()->PollNextEvent(&event, sizeof(event)))
         {
-            dprintf("SoftKnucklesProvider: Run Frame %d\n", i);
+            if (event.eventType != vr::VREvent_Input_HapticVibration)
+                continue;
+            for (int i = 0; i < NUM_DEVICES; i++)
+            {
+                if (m_knuckles[i].HapticVibration(event.data.hapticVibration, event.eventAgeSeconds, now_ns))
+                    break;
+            }
         }
     }
     virtual bool ShouldBlockStandbyMode() override
     {
-        dprintf("SoftKnucklesProvider: ShouldBlockStandbyMode\n");
+        DLOG_DEBUG("SoftKnucklesProvider: ShouldBlockStandbyMode\n");
         return false;
     }
     virtual void EnterStandby() override
     {
-        dprintf("SoftKnucklesProvider: EnterStandby\n");
+        DLOG_INFO("SoftKnucklesProvider: EnterStandby\n");
 		for (int i = 0; i < NUM_DEVICES; i++)
 		{
 			m_knuckles[i].Deactivate();
@@ -132,7 +200,7 @@ public:
     }
     virtual void LeaveStandby() override
     {
-        dprintf("SoftKnucklesProvider: LeaveStandby\n");
+        DLOG_INFO("SoftKnucklesProvider: LeaveStandby\n");
         //m_knuckles[0].Reactivate(); 
         //m_knuckles[1].Reactivate();
     }
@@ -150,55 +218,36 @@ void SoftKnucklesSocketNotifier::Notify()
 }
 } // end of namespace 
 
-bool g_bExiting = false;
 class CWatchdogDriver_Sample : public IVRWatchdogProvider
 {
 public:
-    CWatchdogDriver_Sample()
-    {
-        m_pWatchdogThread = nullptr;
-    }
-
     virtual EVRInitError Init(vr::IVRDriverContext *pDriverContext);
     virtual void Cleanup();
 
 private:
-    thread * m_pWatchdogThread;
+    soft_knuckles::WatchdogWaker m_waker;
 };
 
-void WatchdogThreadFunction()
+static void watchdog_wake_up()
 {
-    while (!g_bExiting)
-    {
-#if defined( _WINDOWS )
-        // on windows send the event when the Y key is pressed.
-        //if ((0x01 & GetAsyncKeyState('Y')) != 0)
-        {
-            // Y key was pressed. 
-            vr::VRWatchdogHost()->WatchdogWakeUp();
-        }
-        this_thread::sleep_for(chrono::microseconds(500));
-#else
-        // for the other platforms, just send one every five seconds
-        this_thread::sleep_for(chrono::seconds(5));
-        vr::VRWatchdogHost()->WatchdogWakeUp();
-#endif
-    }
+    vr::VRWatchdogHost()->WatchdogWakeUp();
 }
 
 EVRInitError CWatchdogDriver_Sample::Init(vr::IVRDriverContext *pDriverContext)
 {
     VR_INIT_WATCHDOG_DRIVER_CONTEXT(pDriverContext);
-    dprintf("SoftKnuckles starting watchdog\n");
-
-    // Watchdog mode on Windows starts a thread that listens for the 'Y' key on the keyboard to 
-    // be pressed. A real driver should wait for a system button event or something else from the 
-    // the hardware that signals that the VR system should start up.
-    g_bExiting = false;
-    m_pWatchdogThread = new thread(WatchdogThreadFunction);
-    if (!m_pWatchdogThread)
+    dprintf_start(nullptr);
+    DLOG_INFO("SoftKnuckles starting watchdog\n");
+
+    // A real driver would wait for a system button event or something else from the hardware
+    // that signals that the VR system should start up.  This one waits for a "wake" datagram on
+    // watchdogPort in default.vrsettings (see watchdog_waker.h).
+    int32_t port = vr::VRSettings()->GetInt32(soft_knuckles::kSettingsSection, "watchdogPort");
+    if (port < 0 || port > 65535)
+        port = 0;
+    if (!m_waker.Start(soft_knuckles::listen_address, (unsigned short)port, watchdog_wake_up))
     {
-        dprintf("Unable to create watchdog thread\n");
+        DLOG_ERROR("Unable to create watchdog thread\n");
         return VRInitError_Driver_Failed;
     }
 
@@ -207,13 +256,9 @@ EVRInitError CWatchdogDriver_Sample::Init(vr::IVRDriverContext *pDriverContext)
 
 void CWatchdogDriver_Sample::Cleanup()
 {
-    g_bExiting = true;
-    if (m_pWatchdogThread)
-    {
-        m_pWatchdogThread->join();
-        delete m_pWatchdogThread;
-        m_pWatchdogThread = nullptr;
-    }
+    m_waker.Stop();
+    DLOG_INFO("SoftKnuckles watchdog stopped after %llu wake ups\n", (unsigned long long)m_waker.WakeUps());
+    dprintf_stop();
 }
 
 #if defined(_WIN32)
@@ -228,7 +273,7 @@ void CWatchdogDriver_Sample::Cleanup()
 
 HMD_DLL_EXPORT void *HmdDriverFactory(const char *pInterfaceName, int *pReturnCode)
 {
-    dprintf("HmdDriverFactory %s\n", pInterfaceName);
+    DLOG_INFO("HmdDriverFactory %s\n", pInterfaceName);
 
     static soft_knuckles::SoftKnucklesProvider s_knuckles_provider; // single instance of the provider
     static CWatchdogDriver_Sample s_watchdogDriverNull; // this is from sample code.
@@ -245,3 +290,14 @@ HMD_DLL_EXPORT void *HmdDriverFactory(const char *pInterfaceName, int *pReturnCo
     return nullptr;
 }
 
+// for hosts that drive the virtual clock themselves, like soft_knuckles_mock_host --virtual
+HMD_DLL_EXPORT uint64_t SoftKnucklesClockNowNs()
+{
+    return soft_knuckles::clock_now_ns();
+}
+
+HMD_DLL_EXPORT bool SoftKnucklesClockAdvance(uint64_t ns)
+{
+    return soft_knuckles::clock_advance(ns);
+}
+
@@ -0,0 +1,256 @@
+//////////////////////////////////////////////////////////////////////////////
+// thread_tuning.cpp
+//
+// See header for description
+//
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dprintf.h"
+#include "thread_tuning.h"
+
+namespace soft_knuckles
+{
+
+static const uint32_t kMaxCpus = 1024;
+
+// "2,3,6-7" into cpus[].  false on anything malformed or out of range.
+static bool parse_cpu_list(const std::string &list, bool *cpus, uint32_t max_cpus)
+{
+    const char *p = list.c_str();
+    bool any = false;
+    while (*p)
+    {
+        char *end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0)
+            return false;
+        long last = first;
+        p = end;
+        if (*p == '-')
+        {
+            p++;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first)
+                return false;
+            p = end;
+        }
+        if (last >= (long)max_cpus)
+            return false;
+        for (long cpu = first; cpu <= last; cpu++)
+        {
+            cpus[cpu] = true;
+        }
+        any = true;
+        while (*p == ' ')
+            p++;
+        if (*p == ',')
+            p++;
+        else if (*p)
+            return false;
+        while (*p == ' ')
+            p++;
+    }
+    return any;
+}
+
+// cpus[] back into "2,3,6-7"
+static std::string format_cpu_list(const bool *cpus, uint32_t max_cpus)
+{
+    std::string list;
+    for (uint32_t cpu = 0; cpu < max_cpus; cpu++)
+    {
+        if (!cpus[cpu])
+            continue;
+        uint32_t last = cpu;
+        while (last + 1 < max_cpus && cpus[last + 1])
+            last++;
+        char buf[32];
+        if (last == cpu)
+            snprintf(buf, sizeof(buf), "%u", cpu);
+        else
+            snprintf(buf, sizeof(buf), "%u-%u", cpu, last);
+        if (!list.empty())
+            list += ",";
+        list += buf;
+        cpu = last;
+    }
+    return list.empty() ? "none" : list;
+}
+
+#if defined(_WIN32)
+
+std::string tune_current_thread(const char *name, const ThreadTuning &tuning)
+{
+    HANDLE thread = GetCurrentThread();
+    wchar_t wide_name[64];
+    size_t i = 0;
+    for (; name[i] && i < 63; i++)
+    {
+        wide_name[i] = (wchar_t)(unsigned char)name[i];
+    }
+    wide_name[i] = 0;
+    SetThreadDescription(thread, wide_name);
+
+    if (!tuning.affinity.empty())
+    {
+        bool cpus[64] = {};
+        if (!parse_cpu_list(tuning.affinity, cpus, 64))
+        {
+            DLOG_ERROR("%s: bad cpu list \"%s\"\n", name, tuning.affinity.c_str());
+        }
+        else
+        {
+            DWORD_PTR mask = 0;
+            for (uint32_t cpu = 0; cpu < 64 && cpu < sizeof(mask) * 8; cpu++)
+            {
+                if (cpus[cpu])
+                    mask |= (DWORD_PTR)1 << cpu;
+            }
+            if (!SetThreadAffinityMask(thread, mask))
+            {
+                DLOG_WARN("%s: SetThreadAffinityMask failed: %lu\n", name, GetLastError());
+            }
+        }
+    }
+    if (!tuning.scheduler.empty())
+    {
+        if (!SetThreadPriority(thread, THREAD_PRIORITY_TIME_CRITICAL))
+        {
+            DLOG_WARN("%s: SetThreadPriority failed: %lu\n", name, GetLastError());
+        }
+    }
+
+    // read the affinity back by setting it to itself
+    bool cpus[64] = {};
+    DWORD_PTR process_mask, system_mask;
+    GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask);
+    DWORD_PTR mask = SetThreadAffinityMask(thread, process_mask);
+    if (mask)
+    {
+        SetThreadAffinityMask(thread, mask);
+    }
+    for (uint32_t cpu = 0; cpu < 64 && cpu < sizeof(mask) * 8; cpu++)
+    {
+        cpus[cpu] = (mask >> cpu) & 1;
+    }
+    int priority = GetThreadPriority(thread);
+    char buf[64];
+    snprintf(buf, sizeof(buf), " policy=%s priority=%d",
+        priority == THREAD_PRIORITY_TIME_CRITICAL ? "time_critical" : "normal", priority);
+    return "cpus=" + format_cpu_list(cpus, 64) + buf;
+}
+
+#else
+
+static const char *policy_name(int policy)
+{
+    switch (policy)
+    {
+        case SCHED_OTHER: return "other";
+        case SCHED_FIFO: return "fifo";
+        case SCHED_RR: return "rr";
+#if defined(SCHED_BATCH)
+        case SCHED_BATCH: return "batch";
+#endif
+#if defined(SCHED_IDLE)
+        case SCHED_IDLE: return "idle";
+#endif
+        default: return "unknown";
+    }
+}
+
+std::string tune_current_thread(const char *name, const ThreadTuning &tuning)
+{
+    pthread_t thread = pthread_self();
+#if defined(__linux__)
+    char short_name[16];
+    snprintf(short_name, sizeof(short_name), "%s", name);
+    pthread_setname_np(thread, short_name);
+
+    if (!tuning.affinity.empty())
+    {
+        bool cpus[kMaxCpus] = {};
+        if (!parse_cpu_list(tuning.affinity, cpus, CPU_SETSIZE < kMaxCpus ? CPU_SETSIZE : kMaxCpus))
+        {
+            DLOG_ERROR("%s: bad cpu list \"%s\"\n", name, tuning.affinity.c_str());
+        }
+        else
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (uint32_t cpu = 0; cpu < kMaxCpus && cpu < CPU_SETSIZE; cpu++)
+            {
+                if (cpus[cpu])
+                    CPU_SET(cpu, &set);
+            }
+            int error = pthread_setaffinity_np(thread, sizeof(set), &set);
+            if (error)
+            {
+                DLOG_WARN("%s: could not set cpus %s: %s\n", name, tuning.affinity.c_str(), strerror(error));
+            }
+        }
+    }
+#endif
+
+    if (!tuning.scheduler.empty())
+    {
+        int policy = -1;
+        if (tuning.scheduler == "fifo")
+            policy = SCHED_FIFO;
+        else if (tuning.scheduler == "rr")
+            policy = SCHED_RR;
+        if (policy < 0)
+        {
+            DLOG_ERROR("%s: unknown scheduler \"%s\"; use fifo or rr\n", name, tuning.scheduler.c_str());
+        }
+        else
+        {
+            int min = sched_get_priority_min(policy);
+            int max = sched_get_priority_max(policy);
+            sched_param param;
+            memset(&param, 0, sizeof(param));
+            param.sched_priority = tuning.priority < min ? min : tuning.priority > max ? max : tuning.priority;
+            int error = pthread_setschedparam(thread, policy, &param);
+            if (error)
+            {
+                // EPERM without CAP_SYS_NICE or an rtprio limit: carry on as we are
+                DLOG_WARN("%s: could not switch to SCHED_%s priority %d: %s; staying on the default scheduler\n",
+                    name, tuning.scheduler == "fifo" ? "FIFO" : "RR", param.sched_priority, strerror(error));
+            }
+        }
+    }
+
+    std::string cpu_list = "all";
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (pthread_getaffinity_np(thread, sizeof(set), &set) == 0)
+    {
+        bool cpus[kMaxCpus] = {};
+        for (uint32_t cpu = 0; cpu < kMaxCpus && cpu < CPU_SETSIZE; cpu++)
+        {
+            cpus[cpu] = CPU_ISSET(cpu, &set) != 0;
+        }
+        cpu_list = format_cpu_list(cpus, kMaxCpus);
+    }
+#endif
+    int policy = SCHED_OTHER;
+    sched_param param;
+    memset(&param, 0, sizeof(param));
+    pthread_getschedparam(thread, &policy, &param);
+    char buf[64];
+    snprintf(buf, sizeof(buf), " policy=%s priority=%d", policy_name(policy), param.sched_priority);
+    return "cpus=" + cpu_list + buf;
+}
+
+#endif
+
+};
@@ -0,0 +1,43 @@
+//////////////////////////////////////////////////////////////////////////////
+// thread_tuning.h
+//
+// Names the calling thread and optionally pins it to CPUs and raises its
+// scheduling class.  Used by the pose thread, whose tick jitter suffers on
+// a loaded machine.
+//
+// Settings, read per device in SoftKnucklesDevice::Init:
+//
+//   "poseThreadAffinity"  : "2,3" or "2-3"; empty leaves the affinity alone
+//   "poseThreadScheduler" : "fifo" or "rr" for SCHED_FIFO / SCHED_RR; empty
+//                           leaves the thread on the default scheduler
+//   "poseThreadPriority"  : the real-time priority, clamped to the range
+//                           the scheduler allows.  0 picks its minimum.
+//
+// Anything that can't be applied, typically a real-time class without
+// CAP_SYS_NICE or an rtprio limit, is logged and skipped; the thread runs
+// on regardless.  The result is read back from the OS so that it reports
+// what is actually in effect.
+//
+// On Windows a scheduler setting raises the thread to
+// THREAD_PRIORITY_TIME_CRITICAL and the affinity covers CPUs 0-63.
+//
+#pragma once
+#include <stdint.h>
+#include <string>
+
+namespace soft_knuckles
+{
+    struct ThreadTuning
+    {
+        std::string affinity;
+        std::string scheduler;
+        int32_t priority;
+
+        ThreadTuning() : priority(0) {}
+    };
+
+    // applies tuning to the calling thread and names it (Linux truncates
+    // names to 15 characters).  returns what is in effect afterwards:
+    //   "cpus=<list> policy=<other|fifo|rr|...> priority=<n>"
+    std::string tune_current_thread(const char *name, const ThreadTuning &tuning);
+};
@@ -0,0 +1,194 @@
+//////////////////////////////////////////////////////////////////////////////
+// trace.cpp
+//
+// See header for description
+//
+// Each TraceBuffer is written only by its own thread and read only by
+// trace_flush, which holds g_trace_mutex.  The owner publishes an event by
+// advancing m_write with release; the flusher frees slots by advancing
+// m_read with release.  Buffers are never freed, so a thread that exits
+// leaves its events behind to be flushed.
+//
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include "trace.h"
+
+#if defined(_WIN32)
+#pragma warning(disable : 4996)
+#endif
+
+std::atomic<bool> g_trace_enabled(false);
+
+namespace
+{
+    struct TraceEvent
+    {
+        const char *name;
+        uint64_t start_ns;
+        uint64_t duration_ns;
+        char phase;             // 'X' complete, 'i' instant
+    };
+
+    struct TraceBuffer
+    {
+        static const uint32_t kCapacity = 65536;   // must be a power of two
+
+        TraceEvent events[kCapacity];
+        std::atomic<uint64_t> write;
+        std::atomic<uint64_t> read;
+        std::atomic<uint64_t> dropped;
+        uint32_t tid;
+        char name[64];
+        bool name_written;
+
+        TraceBuffer(uint32_t id, const char *thread_name)
+            : write(0), read(0), dropped(0), tid(id), name_written(false)
+        {
+            snprintf(name, sizeof(name), "%s", thread_name);
+        }
+
+        void Add(const char *event_name, char phase, uint64_t start_ns, uint64_t duration_ns)
+        {
+            uint64_t w = write.load(std::memory_order_relaxed);
+            if (w - read.load(std::memory_order_acquire) >= kCapacity)
+            {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            TraceEvent &e = events[w & (kCapacity - 1)];
+            e.name = event_name;
+            e.phase = phase;
+            e.start_ns = start_ns;
+            e.duration_ns = duration_ns;
+            write.store(w + 1, std::memory_order_release);
+        }
+    };
+
+    std::mutex g_trace_mutex;                  // buffer list, file
+    std::vector<TraceBuffer *> g_buffers;
+    FILE *g_trace_file = nullptr;
+    uint32_t g_next_tid = 1;
+
+    thread_local TraceBuffer *t_buffer = nullptr;
+    thread_local char t_thread_name[64] = "";
+
+    TraceBuffer *thread_buffer()
+    {
+        if (!t_buffer)
+        {
+            std::lock_guard<std::mutex> lock(g_trace_mutex);
+            t_buffer = new TraceBuffer(g_next_tid++, t_thread_name[0] ? t_thread_name : "thread");
+            g_buffers.push_back(t_buffer);
+        }
+        return t_buffer;
+    }
+
+    // with g_trace_mutex held
+    uint32_t flush_locked()
+    {
+        if (!g_trace_file)
+            return 0;
+        uint32_t written = 0;
+        for (TraceBuffer *buffer : g_buffers)
+        {
+            if (!buffer->name_written)
+            {
+                fprintf(g_trace_file,
+                    "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}},\n",
+                    buffer->tid, buffer->name);
+                buffer->name_written = true;
+            }
+            uint64_t r = buffer->read.load(std::memory_order_relaxed);
+            uint64_t w = buffer->write.load(std::memory_order_acquire);
+            for (; r != w; r++)
+            {
+                const TraceEvent &e = buffer->events[r & (TraceBuffer::kCapacity - 1)];
+                if (e.phase == 'X')
+                {
+                    fprintf(g_trace_file,
+                        "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u},\n",
+                        e.name, e.start_ns / 1000.0, e.duration_ns / 1000.0, buffer->tid);
+                }
+                else
+                {
+                    fprintf(g_trace_file,
+                        "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%u},\n",
+                        e.name, e.start_ns / 1000.0, buffer->tid);
+                }
+                written++;
+            }
+            buffer->read.store(w, std::memory_order_release);
+
+            uint64_t dropped = buffer->dropped.exchange(0, std::memory_order_relaxed);
+            if (dropped)
+            {
+                fprintf(g_trace_file,
+                    "{\"name\":\"dropped %llu events\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%u},\n",
+                    (unsigned long long)dropped, trace_now_ns() / 1000.0, buffer->tid);
+            }
+        }
+        fflush(g_trace_file);
+        return written;
+    }
+}
+
+uint64_t trace_now_ns()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool trace_start(const char *path)
+{
+    std::lock_guard<std::mutex> lock(g_trace_mutex);
+    if (g_trace_file)
+        return true;
+    g_trace_file = fopen(path, "wt");
+    if (!g_trace_file)
+        return false;
+    fprintf(g_trace_file, "[\n");
+    g_trace_enabled = true;
+    return true;
+}
+
+uint32_t trace_flush()
+{
+    std::lock_guard<std::mutex> lock(g_trace_mutex);
+    return flush_locked();
+}
+
+void trace_stop()
+{
+    std::lock_guard<std::mutex> lock(g_trace_mutex);
+    g_trace_enabled = false;
+    flush_locked();
+    if (g_trace_file)
+    {
+        fclose(g_trace_file);
+        g_trace_file = nullptr;
+    }
+}
+
+void trace_set_thread_name(const char *name)
+{
+    snprintf(t_thread_name, sizeof(t_thread_name), "%s", name);
+    if (t_buffer)
+    {
+        std::lock_guard<std::mutex> lock(g_trace_mutex);
+        strcpy(t_buffer->name, t_thread_name);
+        t_buffer->name_written = false;
+    }
+}
+
+void trace_complete(const char *name, uint64_t start_ns, uint64_t end_ns)
+{
+    thread_buffer()->Add(name, 'X', start_ns, end_ns - start_ns);
+}
+
+void trace_instant(const char *name)
+{
+    thread_buffer()->Add(name, 'i', trace_now_ns(), 0);
+}
@@ -0,0 +1,75 @@
+//////////////////////////////////////////////////////////////////////////////
+// trace.h
+//
+// Opt-in Chrome trace-event recording (chrome://tracing, ui.perfetto.dev).
+//
+// Tracing is off unless the "traceFile" setting names a file.  When it is
+// on, every thread that records an event gets its own fixed size buffer,
+// a single producer / single consumer ring, so recording never takes a lock
+// and threads never contend with each other.  trace_flush() appends
+// everything recorded since the last flush to the file; it runs on the
+// "trace flush" debug request and at provider Cleanup.  When a thread's
+// buffer is full its new events are dropped until the next flush.
+//
+// The file uses the JSON array format and is left unterminated so that it
+// can be appended to by later flushes; both viewers accept that.
+//
+// Event names must be string literals: only the pointer is recorded.
+//
+//   SK_TRACE_SCOPE("pose_tick");     // a complete event for the enclosing scope
+//   SK_TRACE_INSTANT("accept");      // a point in time
+//
+// With tracing off each of these costs one relaxed atomic load.
+//
+#pragma once
+#include <stdint.h>
+#include <atomic>
+
+extern std::atomic<bool> g_trace_enabled;
+
+inline bool trace_enabled()
+{
+    return g_trace_enabled.load(std::memory_order_relaxed);
+}
+
+// opens (truncates) path and turns recording on.  false if the file can't be opened.
+bool trace_start(const char *path);
+
+// writes out pending events.  returns the number written.
+uint32_t trace_flush();
+
+// flushes, turns recording off and closes the file.
+void trace_stop();
+
+// names the calling thread in the trace.  may be called before tracing starts.
+void trace_set_thread_name(const char *name);
+
+uint64_t trace_now_ns();
+void trace_complete(const char *name, uint64_t start_ns, uint64_t end_ns);
+void trace_instant(const char *name);
+
+class TraceScope
+{
+public:
+    TraceScope(const char *name)
+        : m_name(trace_enabled() ? name : nullptr),
+          m_start_ns(m_name ? trace_now_ns() : 0)
+    {}
+
+    ~TraceScope()
+    {
+        if (m_name)
+        {
+            trace_complete(m_name, m_start_ns, trace_now_ns());
+        }
+    }
+
+private:
+    const char *m_name;
+    uint64_t m_start_ns;
+};
+
+#define SK_TRACE_CONCAT_INNER(a, b) a##b
+#define SK_TRACE_CONCAT(a, b) SK_TRACE_CONCAT_INNER(a, b)
+#define SK_TRACE_SCOPE(name) TraceScope SK_TRACE_CONCAT(sk_trace_scope_, __LINE__)(name)
+#define SK_TRACE_INSTANT(name) do { if (trace_enabled()) trace_instant(name); } while (0)
@@ -0,0 +1,174 @@
+//////////////////////////////////////////////////////////////////////////////
+// watchdog_waker.cpp
+//
+// See header for description
+//
+#if !defined(_WIN32)
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#include <string.h>
+#include <chrono>
+#include "dprintf.h"
+#include "trace.h"
+#include "watchdog_waker.h"
+
+namespace soft_knuckles
+{
+
+WatchdogWaker::WatchdogWaker()
+    : m_wake(nullptr),
+      m_socket(-1),
+      m_stop_fd(-1),
+      m_stopping(false),
+      m_wakeups(0)
+{
+}
+
+WatchdogWaker::~WatchdogWaker()
+{
+    Stop();
+}
+
+void WatchdogWaker::Wake()
+{
+    SK_TRACE_INSTANT("watchdog_wakeup");
+    m_wakeups.fetch_add(1, std::memory_order_relaxed);
+    m_wake();
+}
+
+#if defined(_WIN32)
+
+bool WatchdogWaker::Start(const char *address, unsigned short port, WakeFn wake)
+{
+    m_wake = wake;
+    m_stopping = false;
+    m_thread = std::thread(thread_function, this);
+    return true;
+}
+
+void WatchdogWaker::thread_function(WatchdogWaker *pthis)
+{
+    trace_set_thread_name("watchdog thread");
+    while (!pthis->m_stopping)
+    {
+        pthis->Wake();
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+}
+
+void WatchdogWaker::Stop()
+{
+    m_stopping = true;
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+#else
+
+bool WatchdogWaker::Start(const char *address, unsigned short port, WakeFn wake)
+{
+    m_wake = wake;
+    m_stopping = false;
+    m_stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (m_stop_fd < 0)
+    {
+        DLOG_ERROR("watchdog eventfd failed: %d\n", errno);
+        return false;
+    }
+
+    if (port != 0)
+    {
+        m_socket = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, IPPROTO_UDP);
+        sockaddr_in service;
+        memset(&service, 0, sizeof(service));
+        service.sin_family = AF_INET;
+        service.sin_addr.s_addr = inet_addr(address);
+        service.sin_port = htons(port);
+        if (m_socket < 0 || ::bind(m_socket, (sockaddr *)&service, sizeof(service)) < 0)
+        {
+            // without the socket the thread still waits for Stop(), it just never wakes the host
+            DLOG_ERROR("watchdog control socket on %s:%d failed: %d\n", address, port, errno);
+            if (m_socket >= 0)
+                close(m_socket);
+            m_socket = -1;
+        }
+        else
+        {
+            DLOG_INFO("watchdog listening for wake on %s:%d\n", address, port);
+        }
+    }
+
+    m_thread = std::thread(thread_function, this);
+    return true;
+}
+
+void WatchdogWaker::thread_function(WatchdogWaker *pthis)
+{
+    trace_set_thread_name("watchdog thread");
+    pollfd fds[2];
+    fds[0].fd = pthis->m_stop_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = pthis->m_socket;        // ignored by poll when -1
+    fds[1].events = POLLIN;
+    while (!pthis->m_stopping.load(std::memory_order_acquire))
+    {
+        fds[0].revents = 0;
+        fds[1].revents = 0;
+        int ready = poll(fds, 2, -1);
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            DLOG_ERROR("watchdog poll failed: %d\n", errno);
+            return;
+        }
+        if (fds[0].revents)
+            break;
+        if (fds[1].revents & POLLIN)
+        {
+            char datagram[64];
+            ssize_t size;
+            while ((size = recv(pthis->m_socket, datagram, sizeof(datagram) - 1, MSG_DONTWAIT)) >= 0)
+            {
+                datagram[size] = '\0';
+                if (strncmp(datagram, "wake", 4) == 0)
+                    pthis->Wake();
+                else
+                    DLOG_WARN_LIMITED(10, 10, "watchdog ignored \"%s\"\n", datagram);
+            }
+        }
+    }
+}
+
+void WatchdogWaker::Stop()
+{
+    m_stopping.store(true, std::memory_order_release);
+    if (m_stop_fd >= 0)
+    {
+        uint64_t one = 1;
+        if (write(m_stop_fd, &one, sizeof(one)) != sizeof(one))
+            DLOG_ERROR("watchdog stop signal failed: %d\n", errno);
+    }
+    if (m_thread.joinable())
+        m_thread.join();
+    if (m_socket >= 0)
+    {
+        close(m_socket);
+        m_socket = -1;
+    }
+    if (m_stop_fd >= 0)
+    {
+        close(m_stop_fd);
+        m_stop_fd = -1;
+    }
+}
+
+#endif
+
+};
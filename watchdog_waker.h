@@ -0,0 +1,51 @@
+//////////////////////////////////////////////////////////////////////////////
+// watchdog_waker.h
+//
+// The thread behind the watchdog provider.  It calls a wake function, in
+// practice vr::VRWatchdogHost()->WatchdogWakeUp(), whenever a "wake"
+// datagram arrives on a loopback UDP control socket:
+//
+//   echo -n wake | nc -u -w0 127.0.0.1 27016
+//
+// On Linux the thread blocks in poll() on the control socket and an
+// eventfd that Stop() signals.  It uses no CPU while idle, wakes the host
+// within microseconds of the datagram, and Stop() joins it right away.
+//
+// Other platforms keep the sample driver's behaviour: wake every 500us and
+// check for Stop() in between.
+//
+// The port comes from the "watchdogPort" setting; 0 turns the socket off.
+//
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <thread>
+
+namespace soft_knuckles
+{
+    class WatchdogWaker
+    {
+    public:
+        typedef void (*WakeFn)();
+
+        WatchdogWaker();
+        ~WatchdogWaker();
+
+        bool Start(const char *address, unsigned short port, WakeFn wake);
+        void Stop();
+
+        uint64_t WakeUps() const { return m_wakeups.load(std::memory_order_relaxed); }
+
+    private:
+        static void thread_function(WatchdogWaker *pthis);
+        void Wake();
+
+        WakeFn m_wake;
+        int m_socket;
+        int m_stop_fd;          // eventfd, Linux only
+        std::atomic<bool> m_stopping;
+        std::atomic<uint64_t> m_wakeups;
+        std::thread m_thread;
+    };
+};